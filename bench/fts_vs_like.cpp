@@ -0,0 +1,135 @@
+// Сравнение поиска LIKE '%...%' и FTS5 (bm25) на синтетическом каталоге.
+// Запуск: bench_fts_vs_like [rows=1000000] [db=:memory:]
+
+#include <sqlite3.h>
+#include <fmt/format.h>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "../include/FullTextSearch.h"
+
+namespace {
+
+const std::vector<std::string> titleWords = {
+        "Гарри", "Поттер", "тайная", "комната", "война", "мир", "преступление", "наказание", "мастер",
+        "Маргарита", "идиот", "братья", "отцы", "дети", "тихий", "Дон", "мёртвые", "души", "горе", "ума",
+        "physics", "history", "algorithms", "introduction", "modern", "classic", "letters", "journey"};
+const std::vector<std::string> authorWords = {
+        "Роулинг", "Толстой", "Достоевский", "Булгаков", "Тургенев", "Шолохов", "Гоголь", "Грибоедов",
+        "Пушкин", "Чехов", "Knuth", "Cormen", "Перельман", "Лермонтов", "Бунин", "Куприн"};
+const std::vector<std::string> topicWords = {
+        "Фэнтези", "Роман", "Классика", "Драма", "Физика", "История", "Информатика", "Поэзия", "Детектив"};
+
+using Clock = std::chrono::steady_clock;
+
+double msSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+void exec(sqlite3* db, const char* sql) {
+    char* err = nullptr;
+    if (sqlite3_exec(db, sql, nullptr, nullptr, &err) != SQLITE_OK) {
+        std::cerr << fmt::format("SQL error: {}\n", err ? err : "?");
+        sqlite3_free(err);
+    }
+}
+
+void fillCatalog(sqlite3* db, int rows) {
+    exec(db, "CREATE TABLE IF NOT EXISTS books(id INTEGER PRIMARY KEY AUTOINCREMENT,"
+             " title TEXT NOT NULL, author TEXT NOT NULL, topic TEXT NOT NULL,"
+             " file_path TEXT UNIQUE, request_count INTEGER DEFAULT 0);");
+
+    std::mt19937 rng(42);
+    auto pick = [&rng](const std::vector<std::string>& words) {
+        return words[rng() % words.size()];
+    };
+
+    sqlite3_stmt* stmt;
+    sqlite3_prepare_v2(db, "INSERT INTO books (title, author, topic, file_path, request_count) VALUES (?, ?, ?, ?, ?);",
+                       -1, &stmt, nullptr);
+    exec(db, "BEGIN;");
+    for (int i = 0; i < rows; ++i) {
+        std::string title = pick(titleWords) + " " + pick(titleWords) + " " + pick(titleWords) + " " + std::to_string(i % 97);
+        std::string author = pick(authorWords) + " " + std::string(1, char('A' + rng() % 26)) + ".";
+        std::string topic = pick(topicWords);
+        std::string path = "/files/book_" + std::to_string(i) + ".pdf";
+        sqlite3_bind_text(stmt, 1, title.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(stmt, 2, author.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(stmt, 3, topic.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(stmt, 4, path.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int(stmt, 5, static_cast<int>(rng() % 1000));
+        sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+    }
+    exec(db, "COMMIT;");
+    sqlite3_finalize(stmt);
+}
+
+// Как BookListPaginator: COUNT(*) + первая страница из 10 книг
+double runQuery(sqlite3* db, const std::string& countSql, const std::string& pageSql, const std::string& param, int& count) {
+    auto start = Clock::now();
+    sqlite3_stmt* stmt;
+    sqlite3_prepare_v2(db, countSql.c_str(), -1, &stmt, nullptr);
+    sqlite3_bind_text(stmt, 1, param.c_str(), -1, SQLITE_TRANSIENT);
+    count = sqlite3_step(stmt) == SQLITE_ROW ? sqlite3_column_int(stmt, 0) : 0;
+    sqlite3_finalize(stmt);
+
+    sqlite3_prepare_v2(db, pageSql.c_str(), -1, &stmt, nullptr);
+    sqlite3_bind_text(stmt, 1, param.c_str(), -1, SQLITE_TRANSIENT);
+    while (sqlite3_step(stmt) == SQLITE_ROW) {}
+    sqlite3_finalize(stmt);
+    return msSince(start);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int rows = argc > 1 ? std::stoi(argv[1]) : 1000000;
+    std::string path = argc > 2 ? argv[2] : ":memory:";
+
+    sqlite3* db;
+    if (sqlite3_open(path.c_str(), &db) != SQLITE_OK) {
+        std::cerr << fmt::format("Can't open database: {}\n", sqlite3_errmsg(db));
+        return 1;
+    }
+
+    auto start = Clock::now();
+    fillCatalog(db, rows);
+    std::cout << fmt::format("Catalog: {} rows in {:.0f} ms\n", rows, msSince(start));
+
+    start = Clock::now();
+    if (!FullTextSearch::ensureIndex(db))
+        return 1;
+    std::cout << fmt::format("FTS5 index built in {:.0f} ms\n\n", msSince(start));
+
+    const std::vector<std::pair<std::string, std::string>> queries = {
+            {"author", "Роулинг"}, {"author", "Достоевский"}, {"title", "тайная комната"},
+            {"title", "Маргарита"}, {"topic", "Физика"}, {"title", "algorithms"},
+            {"author", "Гоголь Q."}, {"title", "Дон души 42"}};
+
+    double likeTotal = 0, ftsTotal = 0;
+    std::cout << fmt::format("{:<8} {:<16} {:>10} {:>10} {:>10} {:>10}\n", "field", "query", "like hits", "like ms", "fts hits", "fts ms");
+    for (const auto& [field, input] : queries) {
+        int likeCount = 0, ftsCount = 0;
+        double likeMs = runQuery(db,
+                                 "SELECT COUNT(*) FROM books WHERE " + field + " LIKE ?;",
+                                 "SELECT rowid, title, author, topic, file_path FROM books WHERE " + field +
+                                 " LIKE ? ORDER BY rowid LIMIT 10;",
+                                 "%" + input + "%", likeCount);
+        double ftsMs = runQuery(db,
+                                "SELECT COUNT(*) FROM books_fts WHERE books_fts MATCH ?;",
+                                "SELECT books.rowid, books.title, books.author, books.topic, books.file_path "
+                                "FROM books_fts JOIN books ON books.rowid = books_fts.rowid WHERE books_fts MATCH ? "
+                                "ORDER BY books_fts.rank, books.request_count DESC LIMIT 10;",
+                                FullTextSearch::columnQuery(field, input), ftsCount);
+        likeTotal += likeMs;
+        ftsTotal += ftsMs;
+        std::cout << fmt::format("{:<8} {:<16} {:>10} {:>10.2f} {:>10} {:>10.2f}\n", field, input, likeCount, likeMs, ftsCount, ftsMs);
+    }
+    std::cout << fmt::format("\nTotal: LIKE {:.1f} ms, FTS5 {:.1f} ms\n", likeTotal, ftsTotal);
+
+    sqlite3_close(db);
+    return 0;
+}
@@ -0,0 +1,302 @@
+// Сравнение приёма апдейтов long poll и вебхуком: задержка от появления апдейта
+// до обработчика и предельный поток апдейтов в секунду.
+// Telegram изображает встроенный фейковый Bot API (getUpdates) и клиенты вебхука
+// на keep-alive соединениях; rtt_ms добавляет сетевую задержку к каждому запросу.
+// Запуск: bench_webhook_vs_longpoll [updates=5000] [rate=500] [connections=4] [rtt_ms=0]
+
+#include <curl/curl.h>
+#include <tgbot/tgbot.h>
+#include <fmt/format.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../include/HttpServer.h"
+#include "../include/WebhookServer.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const std::string token = "123:bench";
+const std::string secret = "bench-secret";
+
+std::string updateJson(int id) {
+    return fmt::format(R"({{"update_id":{0},"message":{{"message_id":{0},"date":0,"text":"{0}",)"
+                       R"("from":{{"id":{1},"is_bot":false,"first_name":"bench"}},"chat":{{"id":{1},"type":"private"}}}}}})",
+                       id, 1000 + id % 64);
+}
+
+// Время отправки и обработки каждого апдейта
+class Recorder {
+public:
+    explicit Recorder(int total_) : total(total_), sent(total_), handled(total_) {}
+
+    void markSent(int id) {
+        sent[id] = Clock::now();
+    }
+
+    void markHandled(int id) {
+        if (id < 0 || id >= total)
+            return;
+        handled[id] = Clock::now();
+        std::lock_guard<std::mutex> lock(mutex);
+        if (++done == total)
+            finished.notify_all();
+    }
+
+    bool wait(std::chrono::seconds timeout) {
+        std::unique_lock<std::mutex> lock(mutex);
+        return finished.wait_for(lock, timeout, [this] { return done == total; });
+    }
+
+    void report(const std::string& mode, Clock::time_point start) const {
+        std::vector<double> latencies;
+        Clock::time_point last = start;
+        for (int i = 0; i < total; ++i) {
+            latencies.push_back(std::chrono::duration<double, std::milli>(handled[i] - sent[i]).count());
+            last = std::max(last, handled[i]);
+        }
+        std::sort(latencies.begin(), latencies.end());
+        double seconds = std::chrono::duration<double>(last - start).count();
+        auto at = [&](double q) { return latencies[static_cast<size_t>(q * (latencies.size() - 1))]; };
+        std::cout << fmt::format("{:<22} {:>10.2f} {:>10.2f} {:>10.2f} {:>12.0f}\n",
+                                 mode, at(0.5), at(0.99), latencies.back(), total / seconds);
+    }
+
+private:
+    const int total;
+    std::vector<Clock::time_point> sent;
+    std::vector<Clock::time_point> handled;
+    std::mutex mutex;
+    std::condition_variable finished;
+    int done = 0;
+};
+
+// Отправители: threads потоков, суммарно rate апдейтов в секунду (0 — без ограничения)
+template<typename Send>
+void drive(int total, int threads, int rate, Send send) {
+    std::vector<std::thread> workers;
+    auto start = Clock::now();
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            for (int id = t; id < total; id += threads) {
+                if (rate > 0)
+                    std::this_thread::sleep_until(start + std::chrono::microseconds(1000000LL * id / rate));
+                send(t, id);
+            }
+        });
+    }
+    for (auto& worker : workers)
+        worker.join();
+}
+
+void sleepMs(double ms) {
+    if (ms > 0)
+        std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(ms));
+}
+
+size_t collect(char* data, size_t size, size_t count, void* out) {
+    static_cast<std::string*>(out)->append(data, size * count);
+    return size * count;
+}
+
+// HTTP-клиент tgbot-cpp поверх libcurl: фейковый Bot API слушает без TLS
+class PlainHttpClient : public TgBot::HttpClient {
+public:
+    std::string makeRequest(const TgBot::Url& url, const std::vector<TgBot::HttpReqArg>& args) const override {
+        thread_local CURL* curl = curl_easy_init();
+        std::string address = url.protocol + "://" + url.host + url.path + (url.query.empty() ? "" : "?" + url.query);
+        std::string form = parser.generateWwwFormUrlencoded(args);
+        std::string body;
+        curl_easy_setopt(curl, CURLOPT_URL, address.c_str());
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, form.c_str());
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, &collect);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &body);
+        curl_easy_setopt(curl, CURLOPT_TIMEOUT, 30L);
+        if (curl_easy_perform(curl) != CURLE_OK)
+            throw std::runtime_error("bench http request failed");
+        return body;
+    }
+
+private:
+    TgBot::HttpParser parser;
+};
+
+// Фейковый Bot API: getUpdates отдаёт накопленные апдейты или ждёт их до timeout
+class FakeBotApi {
+public:
+    explicit FakeBotApi(double rttMs_)
+            : rttMs(rttMs_), http([this](const HttpRequest& request) { return handle(request); }) {
+        http.listen("127.0.0.1", 0);
+        http.start();
+    }
+
+    ~FakeBotApi() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        arrived.notify_all();
+        http.stop();
+    }
+
+    std::string url() const {
+        return "http://127.0.0.1:" + std::to_string(http.port());
+    }
+
+    void push(int id) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending.emplace_back(id, updateJson(id));
+        }
+        arrived.notify_all();
+    }
+
+private:
+    HttpResponse handle(const HttpRequest& request) {
+        sleepMs(rttMs / 2);
+        HttpResponse response;
+        response.contentType = "application/json";
+        if (request.path.find("/getUpdates") == std::string::npos) {
+            response.body = request.path.find("/getMe") != std::string::npos
+                    ? R"({"ok":true,"result":{"id":1,"is_bot":true,"first_name":"bench","username":"bench_bot"}})"
+                    : R"({"ok":true,"result":true})";
+            return response;
+        }
+
+        int offset = formInt(request.body, "offset", 0);
+        size_t limit = static_cast<size_t>(formInt(request.body, "limit", 100));
+        int timeout = formInt(request.body, "timeout", 0);
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!pending.empty() && pending.front().first < offset)
+            pending.pop_front();
+        arrived.wait_for(lock, std::chrono::seconds(timeout), [this] { return stopping || !pending.empty(); });
+
+        response.body = R"({"ok":true,"result":[)";
+        for (size_t i = 0; i < pending.size() && i < limit; ++i)
+            response.body += (i ? "," : "") + pending[i].second;
+        response.body += "]}";
+        lock.unlock();
+        sleepMs(rttMs / 2);
+        return response;
+    }
+
+    static int formInt(const std::string& form, const std::string& name, int fallback) {
+        size_t pos = ("&" + form).find("&" + name + "=");
+        if (pos == std::string::npos)
+            return fallback;
+        try { return std::stoi(form.substr(pos + name.size() + 1)); } catch (...) { return fallback; }
+    }
+
+    const double rttMs;
+    std::mutex mutex;
+    std::condition_variable arrived;
+    std::deque<std::pair<int, std::string>> pending;
+    bool stopping = false;
+    HttpServer http;
+};
+
+void runLongPoll(const std::string& mode, int total, int rate, double rttMs) {
+    Recorder recorder(total);
+    FakeBotApi api(rttMs);
+    PlainHttpClient client;
+    TgBot::Bot bot(token, client, api.url());
+    bot.getEvents().onAnyMessage([&recorder](TgBot::Message::Ptr message) {
+        recorder.markHandled(std::stoi(message->text));
+    });
+
+    std::atomic<bool> polling{true};
+    std::thread poller([&] {
+        TgBot::TgLongPoll longPoll(bot, 100, 1);
+        while (polling)
+            longPoll.start();
+    });
+
+    auto start = Clock::now();
+    drive(total, 1, rate, [&](int, int id) {
+        recorder.markSent(id);
+        api.push(id);
+    });
+    if (!recorder.wait(std::chrono::seconds(120)))
+        std::cerr << mode << ": not all updates arrived\n";
+    recorder.report(mode, start);
+    polling = false;
+    poller.join();
+}
+
+void runWebhook(const std::string& mode, int total, int rate, int connections, double rttMs) {
+    Recorder recorder(total);
+    TgBot::Bot bot(token);
+    bot.getEvents().onAnyMessage([&recorder](TgBot::Message::Ptr message) {
+        recorder.markHandled(std::stoi(message->text));
+    });
+    WebhookServer webhook(bot, "/hook", secret, static_cast<size_t>(connections));
+    webhook.listen("127.0.0.1", 0);
+    webhook.start();
+    std::string url = "http://127.0.0.1:" + std::to_string(webhook.port()) + "/hook";
+
+    // Как Telegram: каждое соединение шлёт следующий апдейт после ответа на предыдущий
+    std::vector<CURL*> handles;
+    curl_slist* headers = curl_slist_append(nullptr, ("X-Telegram-Bot-Api-Secret-Token: " + secret).c_str());
+    headers = curl_slist_append(headers, "Content-Type: application/json");
+    for (int i = 0; i < connections; ++i) {
+        CURL* curl = curl_easy_init();
+        curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, &collect);
+        handles.push_back(curl);
+    }
+
+    auto start = Clock::now();
+    drive(total, connections, rate, [&](int connection, int id) {
+        std::string body = updateJson(id);
+        std::string response;
+        recorder.markSent(id);
+        sleepMs(rttMs / 2);
+        curl_easy_setopt(handles[connection], CURLOPT_POSTFIELDS, body.c_str());
+        curl_easy_setopt(handles[connection], CURLOPT_WRITEDATA, &response);
+        long status = 0;
+        if (curl_easy_perform(handles[connection]) == CURLE_OK)
+            curl_easy_getinfo(handles[connection], CURLINFO_RESPONSE_CODE, &status);
+        if (status != 200)
+            std::cerr << mode << ": update " << id << " not acknowledged (" << status << ")\n";
+        sleepMs(rttMs / 2);
+    });
+    if (!recorder.wait(std::chrono::seconds(120)))
+        std::cerr << mode << ": not all updates handled\n";
+    recorder.report(mode, start);
+
+    for (CURL* curl : handles)
+        curl_easy_cleanup(curl);
+    curl_slist_free_all(headers);
+    auto stats = webhook.connectionStats();
+    std::cout << fmt::format("{:<22} {} connections for {} requests\n", "", stats.connections, stats.requests);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int updates = argc > 1 ? std::stoi(argv[1]) : 5000;
+    int rate = argc > 2 ? std::stoi(argv[2]) : 500;
+    int connections = argc > 3 ? std::stoi(argv[3]) : 4;
+    double rttMs = argc > 4 ? std::stod(argv[4]) : 0;
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+
+    std::cout << fmt::format("{} updates, {}/s for latency, {} webhook connections, rtt {} ms\n\n",
+                             updates, rate, connections, rttMs);
+    std::cout << fmt::format("{:<22} {:>10} {:>10} {:>10} {:>12}\n", "mode", "p50 ms", "p99 ms", "max ms", "updates/s");
+    runLongPoll(fmt::format("long poll @{}/s", rate), updates, rate, rttMs);
+    runWebhook(fmt::format("webhook @{}/s", rate), updates, rate, connections, rttMs);
+    runLongPoll("long poll, max", updates, 0, rttMs);
+    runWebhook("webhook, max", updates, 0, connections, rttMs);
+
+    curl_global_cleanup();
+    return 0;
+}
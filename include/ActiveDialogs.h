@@ -0,0 +1,68 @@
+#ifndef TG_BOT_ACTIVEDIALOGS_H
+#define TG_BOT_ACTIVEDIALOGS_H
+
+#pragma once
+
+#include <cstdint>
+#include "ICommand.h"
+#include "SessionStore.h"
+
+/**
+ * Единый индекс открытых диалогов: user_id -> команда, которая ждёт от
+ * пользователя ввода. Обычное сообщение уходит владельцу за один поиск,
+ * без обхода всех команд. У пользователя не больше одного диалога:
+ * любая новая команда отменяет предыдущий (cancel перед execute), так что
+ * исход не зависит от порядка команд в реестре.
+ *
+ * Записи живут по тем же правилам, что и сессии команд (SessionOptions).
+ */
+
+class ActiveDialogs {
+public:
+    explicit ActiveDialogs(const SessionOptions& options_)
+            : limits(options_), owners("dialogs", options_) {}
+
+    ActiveDialogs(const ActiveDialogs&) = delete;
+    ActiveDialogs& operator=(const ActiveDialogs&) = delete;
+
+    const SessionOptions& options() const {
+        return limits;
+    }
+
+    // Команда с открытым диалогом пользователя или nullptr
+    ICommand* owner(int64_t userId) {
+        auto owner = owners.find(userId);
+        return owner ? *owner : nullptr;
+    }
+
+    // Команда открыла диалог; чужой диалог пользователя при этом отменяется
+    void begin(int64_t userId, ICommand* command) {
+        ICommand* previous = owner(userId);
+        if (previous && previous != command)
+            previous->cancelDialog(userId);
+        owners.put(userId, command);
+    }
+
+    // Диалог завершён самой командой
+    void end(int64_t userId, const ICommand* command) {
+        if (owner(userId) == command)
+            owners.erase(userId);
+    }
+
+    void cancel(int64_t userId) {
+        if (ICommand* previous = owner(userId)) {
+            owners.erase(userId);
+            previous->cancelDialog(userId);
+        }
+    }
+
+    size_t size() {
+        return owners.stats().entries;
+    }
+
+private:
+    const SessionOptions limits;
+    SessionStore<ICommand*> owners;
+};
+
+#endif // TG_BOT_ACTIVEDIALOGS_H
@@ -0,0 +1,441 @@
+#ifndef TG_BOT_BOOKDELIVERY_H
+#define TG_BOT_BOOKDELIVERY_H
+
+#pragma once
+
+#include <sqlite3.h>
+#include <tgbot/tgbot.h>
+#include <fmt/format.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "BookMetadata.h"
+#include "Database.h"
+#include "DiskApi.h"
+#include "DocumentUploader.h"
+#include "DownloadCache.h"
+#include "PipelineStage.h"
+#include "PublicLinks.h"
+#include "TelegramOutbox.h"
+#include "Metrics.h"
+#include "Tracing.h"
+
+/**
+ * Отправка книг по кнопке "Скачать" конвейером из трёх ступеней:
+ * resolve (база, file_id, метаданные файла) -> fetch (скачивание в
+ * DownloadCache) -> upload (загрузка в Telegram). У каждой ступени своя
+ * ограниченная очередь и свой пул потоков, поэтому обработчик колбэка
+ * только ставит задание и сразу возвращается.
+ *
+ * Задание одно на книгу: нажатия на ту же книгу, пока она в работе,
+ * присоединяются к нему. Документ загружается в чат первого нажавшего,
+ * остальным уходит по полученному file_id. Пока задание ждёт или
+ * выполняется, всем его чатам раз в несколько секунд шлётся upload_document.
+ * Все запросы к Telegram идут через TelegramOutbox с приоритетом Delivery.
+ */
+
+class BookDelivery {
+public:
+    // Больше этого Bot API документ не примет — отдаём публичную ссылку
+    static constexpr int64_t maxUploadBytes = 50LL * 1024 * 1024;
+
+    BookDelivery(Database& db_, TelegramOutbox& outbox_, DiskApi& api_, DownloadCache& cache_, BookMetadata& metadata_,
+                 PublicLinks& links_,
+                 size_t resolveThreads = 2, size_t fetchThreads = 4, size_t uploadThreads = 2, size_t queueCapacity = 256)
+            : db(db_), outbox(outbox_), api(api_), cache(cache_), metadata(metadata_), links(links_), uploader(outbox_.transport(), outbox_.token()),
+              resolveStage("resolve", resolveThreads, queueCapacity, [this](Job& job) { guarded(job, &BookDelivery::resolve, "resolve"); }),
+              fetchStage("fetch", fetchThreads, queueCapacity, [this](Job& job) { guarded(job, &BookDelivery::fetch, "fetch"); }),
+              uploadStage("upload", uploadThreads, queueCapacity, [this](Job& job) { guarded(job, &BookDelivery::upload, "upload"); }),
+              ticker(&BookDelivery::tick, this) {}
+
+    ~BookDelivery() {
+        stop();
+    }
+
+    BookDelivery(const BookDelivery&) = delete;
+    BookDelivery& operator=(const BookDelivery&) = delete;
+
+    // Не блокирует; false — очередь заполнена, книгу стоит запросить позже
+    bool request(int64_t chatId, int bookId) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = waiting.find(bookId);
+            if (it != waiting.end()) {
+                if (std::find(it->second.begin(), it->second.end(), chatId) == it->second.end())
+                    it->second.push_back(chatId);
+                ++coalescedCount;
+                actionDue = true;
+            } else {
+                waiting[bookId] = {chatId};
+                Job job;
+                job.bookId = bookId;
+                job.trace = Tracer::current();      // ступени пишут спаны в трассу нажатия
+                if (!resolveStage.tryPush(std::move(job))) {
+                    waiting.erase(bookId);
+                    return false;
+                }
+                actionDue = true;
+            }
+        }
+        wake.notify_one();
+        return true;
+    }
+
+    // Дорабатывает принятые задания ступень за ступенью
+    void stop() {
+        resolveStage.stop();
+        fetchStage.stop();
+        uploadStage.stop();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        if (ticker.joinable())
+            ticker.join();
+    }
+
+    // Сколько нажатий присоединились к уже идущему заданию
+    uint64_t coalesced() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return coalescedCount;
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+    static constexpr auto actionInterval = std::chrono::seconds(4);
+
+    struct ChatAction {
+        Clock::time_point sent;     // последний отправленный статус
+        bool queued = false;        // статус ждёт в очереди outbox
+    };
+
+    struct Job {
+        int bookId = 0;
+        std::string title;
+        std::string author;
+        std::string path;
+        BookMetadata::Info info;
+        DownloadCache::Pinned localFile;    // закреплён в кэше, пока задание живо
+        TraceContext trace;
+    };
+
+    // Итог задания для всех присоединившихся чатов
+    struct Outcome {
+        std::string fileId;     // документ уже в Telegram
+        std::string link;       // файл больше 50 МБ — публичная ссылка
+        std::string error;      // текст для пользователя
+    };
+
+    // Любая ошибка ступени завершает задание, иначе его чаты ждали бы вечно
+    void guarded(Job& job, void (BookDelivery::*step)(Job&), const char* stage) {
+        Tracer::Adopt adopt(job.trace);
+        Tracer::Scope span("delivery", stage);
+        try {
+            (this->*step)(job);
+        } catch (const std::exception& e) {
+            fail(job, e);
+        }
+    }
+
+    void resolve(Job& job) {
+        std::string fileId;
+        {
+            auto reader = db.read();
+            auto stmt = reader.statements().acquire("SELECT b.title, b.author, b.file_path, f.tg_file_id, "
+                                                    "b.size, b.md5, b.mime_type, b.meta_checked FROM books b "
+                                                    "LEFT JOIN book_files f ON f.book_id = b.rowid WHERE b.rowid = ?;");
+            if (!stmt) {
+                complete(job.bookId, {"", "", "Произошла ошибка при доступе к базе."});
+                return;
+            }
+            sqlite3_bind_int(stmt, 1, job.bookId);
+            if (sqlite3_step(stmt) == SQLITE_ROW) {
+                job.title = text(stmt, 0);
+                job.author = text(stmt, 1);
+                job.path = text(stmt, 2);
+                fileId = text(stmt, 3);
+                job.info = BookMetadata::fromRow(stmt, 4);
+            }
+        }
+
+        if (job.path.empty()) {
+            complete(job.bookId, {"", "", "Книга не найдена."});
+            return;
+        }
+
+        // Telegram уже хранит этот документ — отправляем по file_id без Яндекс Диска;
+        // устаревший md5 сверяется в фоне, и при смене файла file_id будет сброшен
+        if (!fileId.empty()) {
+            metadata.check(job.bookId, job.path, job.info);
+            if (sendCached(job, fileId))
+                return;
+            forgetFileId(job.bookId);
+        }
+
+        // Размер неизвестен, только если диск не ответил — тогда его проверит fetch по скачанному файлу
+        job.info = metadata.ensure(job.bookId, job.path, job.info);
+        if (job.info.known && job.info.size > maxUploadBytes) {
+            sendLink(job);
+            return;
+        }
+
+        if (!fetchStage.push(job))
+            complete(job.bookId, {"", "", "Бот перезапускается, попробуйте позже"});
+    }
+
+    void fetch(Job& job) {
+        auto localPath = cache.fetch(job.path, [this, &job](const std::string& dir) {
+            static LatencyHistogram& timing = Metrics::instance().histogram(Metrics::Family::Disk, "downloadFile");
+            Metrics::Timer timer(timing);
+            bool ok = api.download(job.path, dir);
+            if (!ok)
+                timer.fail();
+            return ok;
+        });
+        if (!localPath) {
+            std::cerr << "Ошибка загрузки книги \"" << job.title << "\" автора \"" << job.author << "\"" << std::endl;
+            complete(job.bookId, {"", "", "Ошибка загрузки книги"});
+            return;
+        }
+        job.localFile = localPath;
+        std::error_code ec;
+        if (!job.info.known && static_cast<int64_t>(std::filesystem::file_size(*job.localFile, ec)) > maxUploadBytes) {
+            sendLink(job);
+            return;
+        }
+        if (!uploadStage.push(job))
+            complete(job.bookId, {"", "", "Бот перезапускается, попробуйте позже"});
+    }
+
+    void upload(Job& job) {
+        int64_t chatId = firstChat(job.bookId);
+        std::filesystem::path originalName = std::filesystem::path(job.path).filename();
+        std::string mimeType = job.info.mimeType.empty() ? BookMetadata::mimeForExtension(job.path) : job.info.mimeType;
+
+        // Файл идёт в запрос прямо из отображения; в кэше он лежит под хэшем, поэтому имя — исходное
+        Outcome outcome;
+        outcome.fileId = outbox.call(chatId, TelegramOutbox::Priority::Delivery, [&] {
+            return uploader.sendDocument(chatId, *job.localFile, originalName.string(), mimeType);
+        });
+        if (!outcome.fileId.empty())
+            rememberFileId(job.bookId, outcome.fileId, job.info.md5);
+        complete(job.bookId, outcome, chatId);
+    }
+
+    // Обычно ссылка уже в базе — опубликована раньше или заранее
+    void sendLink(const Job& job) {
+        std::string link = links.get(job.bookId, job.path);
+        complete(job.bookId, {"", link, link.empty() ? "Ошибка загрузки книги" : ""});
+    }
+
+    // Первый чат задания получает документ по file_id; если Telegram его не принял — false
+    bool sendCached(const Job& job, const std::string& fileId) {
+        int64_t chatId = firstChat(job.bookId);
+        try {
+            outbox.call(chatId, TelegramOutbox::Priority::Delivery, [&] {
+                return outbox.api().sendDocument(chatId, fileId);
+            });
+        } catch (const TgBot::TgException& e) {
+            if (e.errorCode == TgBot::TgException::ErrorCode::BadRequest) {
+                std::cerr << "Cached file_id rejected for book " << job.bookId << ": " << e.what() << std::endl;
+                return false;
+            }
+            fail(job, e);
+            return true;
+        }
+        complete(job.bookId, {fileId, "", ""}, chatId);
+        return true;
+    }
+
+    void fail(const Job& job, const std::exception& e) {
+        std::cerr << "Ошибка при загрузке/отправке книги \"" << job.title << "\" автора \"" << job.author << "\": "
+                  << e.what() << std::endl;
+        complete(job.bookId, {"", "", "Произошла ошибка во время отправки книги"});
+    }
+
+    int64_t firstChat(int bookId) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = waiting.find(bookId);
+        return it == waiting.end() || it->second.empty() ? 0 : it->second.front();
+    }
+
+    // Снимает задание и рассылает итог всем его чатам, кроме уже обслуженного served
+    void complete(int bookId, const Outcome& outcome, int64_t served = 0) {
+        std::vector<int64_t> chats;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = waiting.find(bookId);
+            if (it == waiting.end())
+                return;
+            chats = std::move(it->second);
+            waiting.erase(it);
+        }
+
+        for (int64_t chatId : chats) {
+            if (chatId == served)
+                continue;
+            try {
+                if (!outcome.fileId.empty())
+                    outbox.call(chatId, TelegramOutbox::Priority::Delivery, [&] {
+                        return outbox.api().sendDocument(chatId, outcome.fileId);
+                    });
+                else if (!outcome.link.empty())
+                    outbox.sendMessage(chatId, fmt::format(u8"*Файл слиишком большой!* 😢"
+                                                           "\n\n Поэтому держи ссылку для скачивания: \n\n {}",
+                                                           outcome.link),
+                                       "Markdown");
+                else
+                    outbox.sendMessage(chatId, outcome.error.empty() ? "Ошибка загрузки книги" : outcome.error);
+            } catch (const std::exception& e) {
+                std::cerr << "Failed to deliver book " << bookId << " to chat " << chatId << ": " << e.what() << std::endl;
+            }
+        }
+    }
+
+    // Статус upload_document живёт в Telegram ~5 с: каждому чату с заданием он обновляется
+    // раз в actionInterval, и у чата не бывает больше одного статуса в очереди outbox
+    void tick() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!stopping) {
+            actionDue = false;
+            auto now = Clock::now();
+            auto next = now + actionInterval;
+
+            std::unordered_set<int64_t> active;
+            for (const auto& [bookId, bookChats] : waiting)
+                active.insert(bookChats.begin(), bookChats.end());
+            for (auto it = actions.begin(); it != actions.end();)
+                it = active.count(it->first) ? std::next(it) : actions.erase(it);
+
+            std::vector<int64_t> due;
+            for (int64_t chatId : active) {
+                auto& action = actions[chatId];
+                if (action.queued)
+                    continue;
+                if (action.sent + actionInterval <= now) {
+                    action.queued = true;
+                    due.push_back(chatId);
+                } else {
+                    next = std::min(next, action.sent + actionInterval);
+                }
+            }
+            lock.unlock();
+
+            // Статус не важнее ответов и документов — уходит, когда у чата есть свободный токен
+            for (int64_t chatId : due)
+                outbox.post(chatId, TelegramOutbox::Priority::Cleanup, [this, chatId] { sendAction(chatId); });
+
+            lock.lock();
+            wake.wait_until(lock, next, [this] { return stopping || actionDue; });
+        }
+    }
+
+    // Задание чата могло завершиться, пока статус стоял в очереди, — тогда он уже не нужен
+    void sendAction(int64_t chatId) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!actions.count(chatId) || !hasJob(chatId)) {
+                actions.erase(chatId);
+                return;
+            }
+        }
+        try {
+            outbox.api().sendChatAction(chatId, "upload_document");
+        } catch (const std::exception& e) {
+            std::cerr << "Failed to send chat action to " << chatId << ": " << e.what() << std::endl;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = actions.find(chatId);
+            if (it != actions.end()) {
+                it->second.sent = Clock::now();
+                it->second.queued = false;
+            }
+            actionDue = true;   // пересчитать срок следующего обновления
+        }
+        wake.notify_one();
+    }
+
+    // Вызывается под mutex
+    bool hasJob(int64_t chatId) const {
+        for (const auto& [bookId, bookChats] : waiting) {
+            if (std::find(bookChats.begin(), bookChats.end(), chatId) != bookChats.end())
+                return true;
+        }
+        return false;
+    }
+
+    // md5 — версия файла, которую загрузили. Пока шла загрузка старой копии, сверка могла
+    // увидеть новый md5 и сбросить file_id; тогда запись не делается, иначе устаревший
+    // документ остался бы в book_files при уже совпадающем с диском md5
+    void rememberFileId(int bookId, const std::string& fileId, const std::string& md5) {
+        db.write([this, bookId, fileId, md5] {
+            auto stmt = db.statements().acquire("INSERT INTO book_files (book_id, tg_file_id)"
+                                                " SELECT ?1, ?2 FROM books WHERE id = ?1 AND COALESCE(md5, '') = ?3"
+                                                " ON CONFLICT(book_id) DO UPDATE SET tg_file_id = excluded.tg_file_id;");
+            if (!stmt)
+                return false;
+            sqlite3_bind_int(stmt, 1, bookId);
+            sqlite3_bind_text(stmt, 2, fileId.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_text(stmt, 3, md5.c_str(), -1, SQLITE_TRANSIENT);
+            if (sqlite3_step(stmt) != SQLITE_DONE) {
+                std::cerr << "Failed to store file_id: " << db.errmsg() << std::endl;
+                return false;
+            }
+            return true;
+        });
+    }
+
+    void forgetFileId(int bookId) {
+        db.write([this, bookId] {
+            auto stmt = db.statements().acquire("DELETE FROM book_files WHERE book_id = ?;");
+            if (!stmt)
+                return false;
+            sqlite3_bind_int(stmt, 1, bookId);
+            if (sqlite3_step(stmt) != SQLITE_DONE) {
+                std::cerr << "Failed to drop file_id: " << db.errmsg() << std::endl;
+                return false;
+            }
+            return true;
+        });
+    }
+
+    static std::string text(sqlite3_stmt* stmt, int column) {
+        const unsigned char* value = sqlite3_column_text(stmt, column);
+        return value ? reinterpret_cast<const char*>(value) : "";
+    }
+
+    Database& db;
+    TelegramOutbox& outbox;
+    DiskApi& api;
+    DownloadCache& cache;
+    BookMetadata& metadata;
+    PublicLinks& links;
+    DocumentUploader uploader;
+
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::unordered_map<int, std::vector<int64_t>> waiting;   // книга -> чаты, первый получает загрузку
+    uint64_t coalescedCount = 0;
+    std::unordered_map<int64_t, ChatAction> actions;        // чаты с заданиями -> их статус
+    bool actionDue = false;
+    bool stopping = false;
+
+    PipelineStage<Job> resolveStage;
+    PipelineStage<Job> fetchStage;
+    PipelineStage<Job> uploadStage;
+    std::thread ticker;
+};
+
+#endif // TG_BOT_BOOKDELIVERY_H
@@ -9,11 +9,21 @@
 #include <tgbot/tgbot.h>
 #include <fmt/format.h>
 #include <sstream>
-#include <map>
 #include <iostream>
 #include <filesystem>
-#include "YandexDiskClient.h"
+#include "Database.h"
+#include "FullTextSearch.h"
+#include "TrigramIndex.h"
+#include "RequestCounters.h"
+#include "Leaderboard.h"
+#include "ResultRegistry.h"
+#include "BookDelivery.h"
+#include "SessionStore.h"
+#include "TelegramOutbox.h"
+#include "Metrics.h"
 #include <algorithm>
+#include <mutex>
+#include <optional>
 
 struct BookItem {
     int id;
@@ -25,20 +35,23 @@ struct BookItem {
 
 class BookListPaginator {
 public:
-    explicit BookListPaginator(sqlite3* db_, TgBot::Bot& bot_, YandexDiskClient& yandex_)
-            : db(db_), bot(bot_), yandex(yandex_) {}
+    BookListPaginator(Database& db_, TelegramOutbox& outbox_, BookDelivery& delivery_, const SessionOptions& sessions)
+            : db(db_), outbox(outbox_), delivery(delivery_), counters(db_),
+              userPages("pages", sessions,
+                        [](const int& page) { return std::to_string(page); },
+                        [](const std::string& data, int& page) {
+                            try { page = std::stoi(data); } catch (...) { return false; }
+                            return true;
+                        }) {}
 
     std::vector<BookItem> loadPage(const std::string& whereClause, const std::vector<std::string>& params, int page, int pageSize = 10) {
-        std::vector<BookItem> books;
-        std::ostringstream sql;
-        sql << "SELECT rowid, title, author, topic, file_path FROM books ";
-        if (!whereClause.empty()) sql << "WHERE " << whereClause << " ";
-        sql << "ORDER BY rowid LIMIT ? OFFSET ?;";
-
-        sqlite3_stmt* stmt;
-        if (sqlite3_prepare_v2(db, sql.str().c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
-            std::cerr << "Failed to prepare paginator SQL: " << sqlite3_errmsg(db) << std::endl;
-            return books;
+        auto reader = db.read();
+        auto stmt = reader.statements().acquire("page:" + whereClause, [&] {
+            return selectSql(whereClause) + orderSql(whereClause) + " LIMIT ? OFFSET ?;";
+        });
+        if (!stmt) {
+            std::cerr << "Failed to prepare paginator SQL: " << reader.errmsg() << std::endl;
+            return {};
         }
 
         int index = 1;
@@ -48,28 +61,32 @@ public:
         sqlite3_bind_int(stmt, index++, pageSize);
         sqlite3_bind_int(stmt, index++, page * pageSize);
 
-        while (sqlite3_step(stmt) == SQLITE_ROW) {
-            BookItem item;
-            item.id = sqlite3_column_int(stmt, 0);
-            item.title = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-            item.author = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
-            item.topic = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
-            item.file_path = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4));
-            books.push_back(item);
-        }
-        sqlite3_finalize(stmt);
+        return readBooks(stmt);
+    }
+
+    // --- keyset-пагинация: страница после/до известного rowid, без OFFSET ---
+    std::vector<BookItem> loadPageAfter(const std::string& whereClause, const std::vector<std::string>& params,
+                                        int afterRowid, int pageSize = 10) {
+        return loadSeekPage(whereClause, params, afterRowid, pageSize, true);
+    }
+
+    std::vector<BookItem> loadPageBefore(const std::string& whereClause, const std::vector<std::string>& params,
+                                         int beforeRowid, int pageSize = 10) {
+        auto books = loadSeekPage(whereClause, params, beforeRowid, pageSize, false);
+        std::reverse(books.begin(), books.end());
         return books;
     }
 
     int loadTotalCount(const std::string& whereClause, const std::vector<std::string>& params) {
-        std::ostringstream sql;
-        sql << "SELECT COUNT(*) FROM books ";
-        if (!whereClause.empty()) sql << "WHERE " << whereClause;
-
-        sqlite3_stmt* stmt;
+        auto reader = db.read();
+        auto stmt = reader.statements().acquire("count:" + whereClause, [&] {
+            std::string sql = FullTextSearch::isRanked(whereClause) ? "SELECT COUNT(*) FROM books_fts" : "SELECT COUNT(*) FROM books";
+            if (!whereClause.empty()) sql += " WHERE " + whereClause;
+            return sql + ";";
+        });
         int count = 0;
-        if (sqlite3_prepare_v2(db, sql.str().c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
-            std::cerr << "Failed to prepare count SQL: " << sqlite3_errmsg(db) << std::endl;
+        if (!stmt) {
+            std::cerr << "Failed to prepare count SQL: " << reader.errmsg() << std::endl;
             return 0;
         }
 
@@ -80,7 +97,6 @@ public:
         if (sqlite3_step(stmt) == SQLITE_ROW)
             count = sqlite3_column_int(stmt, 0);
 
-        sqlite3_finalize(stmt);
         return count;
     }
 
@@ -99,7 +115,15 @@ public:
 
     // --- encoder: сериализует весь фильтр в callbackData ---
     std::string encodeCallback(const std::string& action, int page, const std::string& whereClause, const std::vector<std::string>& params) {
-        std::string encoded = action + "_" + std::to_string(page) + "|" + whereClause + "|";
+        return encodeCallback(action, page, 0, whereClause, params);
+    }
+
+    // fwd_<page>_<rowid> / back_<page>_<rowid> — курсор keyset-пагинации
+    std::string encodeCallback(const std::string& action, int page, int anchor, const std::string& whereClause, const std::vector<std::string>& params) {
+        std::string encoded = action + "_" + std::to_string(page);
+        if (action != "page")
+            encoded += "_" + std::to_string(anchor);
+        encoded += "|" + whereClause + "|";
         for (size_t i = 0; i < params.size(); ++i) {
             if (i) encoded += "##";
             encoded += params[i];
@@ -109,14 +133,24 @@ public:
 
     // --- decoder: разбирает callbackData на action, page, whereClause, params ---
     bool decodeCallback(const std::string& data, std::string& action, int& page, std::string& whereClause, std::vector<std::string>& params) {
+        int anchor = 0;
+        return decodeCallback(data, action, page, anchor, whereClause, params);
+    }
+
+    bool decodeCallback(const std::string& data, std::string& action, int& page, int& anchor, std::string& whereClause, std::vector<std::string>& params) {
         size_t first_ = data.find('_');
         size_t firstBar = data.find('|');
         size_t secondBar = data.rfind('|');
         if (first_ == std::string::npos || firstBar == std::string::npos || secondBar == std::string::npos || secondBar <= firstBar)
             return false;
         action = data.substr(0, first_);
-        page = std::stoi(data.substr(first_+1, firstBar-first_-1));
+        std::string cursor = data.substr(first_+1, firstBar-first_-1);
+        size_t second_ = cursor.find('_');
+        page = std::stoi(cursor.substr(0, second_));
+        anchor = second_ == std::string::npos ? 0 : std::stoi(cursor.substr(second_+1));
         whereClause = data.substr(firstBar+1, secondBar-firstBar-1);
+        if (!isKnownFilter(whereClause))
+            return false;
         std::string paramsPart = data.substr(secondBar+1);
         params.clear();
         if (!paramsPart.empty())
@@ -133,10 +167,41 @@ public:
         return true;
     }
 
+    // Фильтр из callbackData попадает в SQL, а подделать callbackData может любой клиент, —
+    // принимаем только условия, которые когда-либо строил сам бот
+    static bool isKnownFilter(const std::string& whereClause) {
+        return whereClause.empty() || whereClause == "title LIKE ?" || whereClause == "author LIKE ?" ||
+               whereClause == "topic LIKE ?" || whereClause == FullTextSearch::whereClause;
+    }
+
     TgBot::InlineKeyboardMarkup::Ptr buildKeyboard(const std::vector<BookItem>& books, int currentPage, int totalPages,
                                                    const std::string& whereClause, const std::vector<std::string>& params) {
         if(books.empty()) return nullptr; // Нет клавиатуры для пустого списка
 
+        // Выдача FTS упорядочена по релевантности, а не по rowid — курсор по rowid к ней не применим
+        bool seek = !FullTextSearch::isRanked(whereClause);
+
+        std::string prevData = currentPage <= 0 ? "ignore"
+                : seek ? encodeCallback("back", currentPage - 1, books.front().id, whereClause, params)
+                       : encodeCallback("page", currentPage - 1, whereClause, params);
+        std::string nextData = currentPage + 1 >= totalPages ? "ignore"
+                : seek ? encodeCallback("fwd", currentPage + 1, books.back().id, whereClause, params)
+                       : encodeCallback("page", currentPage + 1, whereClause, params);
+        return buildNavKeyboard(books, currentPage, totalPages, prevData, nextData);
+    }
+
+    // Кнопки результата поиска: r:<handle>:<page>, укладываются в 64 байта при любом запросе
+    TgBot::InlineKeyboardMarkup::Ptr buildResultKeyboard(const std::vector<BookItem>& books, int currentPage, int totalPages,
+                                                         const std::string& handle) {
+        return buildNavKeyboard(books, currentPage, totalPages,
+                                currentPage > 0 ? "r:" + handle + ":" + std::to_string(currentPage - 1) : "ignore",
+                                currentPage + 1 < totalPages ? "r:" + handle + ":" + std::to_string(currentPage + 1) : "ignore");
+    }
+
+    TgBot::InlineKeyboardMarkup::Ptr buildNavKeyboard(const std::vector<BookItem>& books, int currentPage, int totalPages,
+                                                      const std::string& prevData, const std::string& nextData) {
+        if(books.empty()) return nullptr; // Нет клавиатуры для пустого списка
+
         auto keyboard = std::make_shared<TgBot::InlineKeyboardMarkup>();
 
         for(auto &book : books) {
@@ -148,7 +213,7 @@ public:
 
         auto prev = std::make_shared<TgBot::InlineKeyboardButton>();
         prev->text = "⬅️";
-        prev->callbackData = currentPage > 0 ? encodeCallback("page", currentPage - 1, whereClause, params): "ignore";
+        prev->callbackData = prevData;
 
         auto info = std::make_shared<TgBot::InlineKeyboardButton>();
         info->text = std::to_string(currentPage + 1) + "/" + std::to_string(totalPages);
@@ -156,7 +221,7 @@ public:
 
         auto next = std::make_shared<TgBot::InlineKeyboardButton>();
         next->text = "➡️";
-        next->callbackData = currentPage + 1 < totalPages ? encodeCallback("page", currentPage + 1, whereClause, params): "ignore";
+        next->callbackData = nextData;
         keyboard->inlineKeyboard.push_back({prev, info, next});
 
         return keyboard;
@@ -165,174 +230,264 @@ public:
     void handleCallback(const TgBot::CallbackQuery::Ptr &callback,
                         const std::string &whereClause = "",
                         const std::vector<std::string> &params = {}) {
+        Metrics::Timer timer(callbackTiming(callback->data));
         try {
             std::string data = callback->data;
             int64_t chatId = callback->message->chat->id;
             int messageId = callback->message->messageId;
 
-            if (data.find("page_") == 0) {
-                std::string action; int page = 0; std::string wc; std::vector<std::string> ps;
-                if (!decodeCallback(data, action, page, wc, ps)) {
+            if (data.rfind("page_", 0) == 0 || data.rfind("fwd_", 0) == 0 || data.rfind("back_", 0) == 0) {
+                std::string action; int page = 0; int anchor = 0; std::string wc; std::vector<std::string> ps;
+                if (!decodeCallback(data, action, page, anchor, wc, ps)) {
+                    answerCallbackQuery(callback, "Ошибка данных пагинации");
+                    return;
+                }
+                answerCallbackQuery(callback);
+                setUserPage(callback->from->id, page);
+
+                // Старые кнопки с фильтром в callbackData переводим на хэндл результата
+                if (!wc.empty()) {
+                    auto result = materialize(wc, ps);
+                    showPage(chatId, messageId, resultView(result.handle, *result.ids, page));
+                    return;
+                }
+
+                std::vector<BookItem> books;
+                if (action == "fwd")
+                    books = loadPageAfter(wc, ps, anchor, pageSize);
+                else if (action == "back")
+                    books = loadPageBefore(wc, ps, anchor, pageSize);
+                else
+                    books = loadPage(wc, ps, page, pageSize); // старые кнопки page_N
+                showPage(chatId, messageId, catalogView(books, page));
+            } else if (data.rfind("r:", 0) == 0) {
+                size_t colon = data.find(':', 2);
+                if (colon == std::string::npos) {
                     answerCallbackQuery(callback, "Ошибка данных пагинации");
                     return;
                 }
+                std::string handle = data.substr(2, colon - 2);
+                int page = std::stoi(data.substr(colon + 1));
+                auto ids = results.find(handle);
+                if (!ids) {
+                    answerCallbackQuery(callback, "Результаты поиска устарели, повторите поиск");
+                    return;
+                }
                 answerCallbackQuery(callback);
                 setUserPage(callback->from->id, page);
-                editPage(chatId, messageId, page, wc, ps);
+                showPage(chatId, messageId, resultView(handle, *ids, page));
             } else if (data.rfind("download_", 0) == 0) {
                 int bookId = std::stoi(data.substr(9));
-                answerCallbackQuery(callback, "Загрузка книги...");
-
-                try {
-                    bot.getApi().deleteMessage(chatId, messageId);
-                } catch (const std::exception& e) {
-                    std::cerr << "Failed to delete message: " << e.what() << std::endl;
+                if (!delivery.request(chatId, bookId)) {
+                    answerCallbackQuery(callback, "Сейчас слишком много загрузок, попробуйте через минуту");
+                    return;
                 }
+                answerCallbackQuery(callback, "Загрузка книги...");
 
-                sendBook(chatId, bookId);
+                outbox.deleteMessage(chatId, messageId);
             } else if (data == "ignore") {
                 answerCallbackQuery(callback);
             }
         } catch (const TgBot::TgException &e) {
+            timer.fail();
             std::cerr << "Callback query error: " << e.what() << std::endl;
         }
     }
 
+    // Гистограмма по типу кнопки; ссылки ищутся один раз
+    static LatencyHistogram& callbackTiming(const std::string& data) {
+        static auto& metrics = Metrics::instance();
+        static LatencyHistogram& page = metrics.histogram(Metrics::Family::Callback, "page");
+        static LatencyHistogram& result = metrics.histogram(Metrics::Family::Callback, "result");
+        static LatencyHistogram& download = metrics.histogram(Metrics::Family::Callback, "download");
+        static LatencyHistogram& ignore = metrics.histogram(Metrics::Family::Callback, "ignore");
+        static LatencyHistogram& other = metrics.histogram(Metrics::Family::Callback, "other");
+        if (data.rfind("page_", 0) == 0 || data.rfind("fwd_", 0) == 0 || data.rfind("back_", 0) == 0)
+            return page;
+        if (data.rfind("r:", 0) == 0)
+            return result;
+        if (data.rfind("download_", 0) == 0)
+            return download;
+        return data == "ignore" ? ignore : other;
+    }
+
     void answerCallbackQuery(const TgBot::CallbackQuery::Ptr &callback, const std::string &text = "") {
         try {
-            bot.getApi().answerCallbackQuery(callback->id, text);
+            outbox.answerCallbackQuery(callback->id, text);
         } catch(const TgBot::TgException &e) {
             std::cerr << "Failed to answer callback query: " << e.what() << std::endl;
         }
     }
 
     void setUserPage(int64_t userId, int page) {
-        userPages[userId] = page;
+        userPages.put(userId, page);
+    }
+
+    // Давно не листавший пользователь начинает с первой страницы
+    int getUserPage(int64_t userId) {
+        auto page = userPages.find(userId);
+        return page ? *page : 0;
+    }
+
+    bool saveSessions() {
+        return userPages.save(db);
+    }
+
+    size_t restoreSessions() {
+        return userPages.restore(db);
     }
 
     void sendPage(int64_t chatId, int64_t userId,
                   const std::string& whereClause,
                   const std::vector<std::string>& params) {
-        int page = userPages.count(userId) ? userPages[userId] : 0;
-        auto books = loadPage(whereClause, params, page, pageSize);
-        int count = loadTotalCount(whereClause, params);
-        int totalPages = (count + pageSize - 1) / pageSize;
-        auto text = formatMessage(books, page, totalPages);
-
-        if(books.empty())
-            bot.getApi().sendMessage(chatId, text, false, 0, nullptr, "Markdown");
-        else {
-            auto keyboard = buildKeyboard(books, page, totalPages, whereClause, params);
-            bot.getApi().sendMessage(chatId, text, false, 0, keyboard, "Markdown");
+        int page = getUserPage(userId);
+        if (whereClause.empty()) {
+            showPage(chatId, 0, catalogView(loadPage("", {}, page, pageSize), page));
+            return;
         }
+        auto result = materialize(whereClause, params);
+        showPage(chatId, 0, resultView(result.handle, *result.ids, page));
     }
 
-    std::vector<std::string> getTopStrings(const char* sql, int limit) {
-        std::vector<std::string> result;
-        sqlite3_stmt* stmt;
-        if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-            std::cerr << "Failed to prepare top query: " << sqlite3_errmsg(db) << std::endl;
-            return result;
-        }
-        sqlite3_bind_int(stmt, 1, limit);
-        while (sqlite3_step(stmt) == SQLITE_ROW) {
-            const unsigned char* v = sqlite3_column_text(stmt, 0);
-            if (v) result.emplace_back(reinterpret_cast<const char*>(v));
-        }
-        sqlite3_finalize(stmt);
-        return result;
+    // --- результаты поиска: упорядоченный список id под коротким хэндлом ---
+    ResultRegistry::Result materialize(const std::string& whereClause, const std::vector<std::string>& params) {
+        std::string queryKey = whereClause;
+        for (const auto& param : params)
+            queryKey += '\x1F' + param;
+        return results.materialize(queryKey, [&] { return loadIds(whereClause, params); });
     }
 
-    std::vector<std::pair<std::string, std::string>> getTopPairs(const char* sql, int limit) {
-        std::vector<std::pair<std::string, std::string>> result;
-        sqlite3_stmt* stmt;
-        if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-            std::cerr << "Failed to prepare top query: " << sqlite3_errmsg(db) << std::endl;
-            return result;
-        }
-        sqlite3_bind_int(stmt, 1, limit);
-        while (sqlite3_step(stmt) == SQLITE_ROW) {
-            const unsigned char* v1 = sqlite3_column_text(stmt, 0);
-            const unsigned char* v2 = sqlite3_column_text(stmt, 1);
-            if (v1 && v2) result.emplace_back(
-                        std::make_pair(
-                                std::string(reinterpret_cast<const char*>(v1)),
-                                std::string(reinterpret_cast<const char*>(v2))
-                        )
-                );
-        }
-        sqlite3_finalize(stmt);
-        return result;
+    int countResults(const std::string& whereClause, const std::vector<std::string>& params) {
+        return static_cast<int>(materialize(whereClause, params).ids->size());
+    }
+
+    // --- рейтинги популярности: в памяти, обновляются на месте ---
+    // depth совпадает с глубиной Leaderboard по умолчанию
+    void loadLeaderboards(int depth = 100) {
+        authorBoard.load(loadRanked("SELECT author, request_count FROM author_requests "
+                                    "ORDER BY request_count DESC LIMIT ?;", depth));
+        topicBoard.load(loadRanked("SELECT topic, request_count FROM topic_requests "
+                                   "ORDER BY request_count DESC LIMIT ?;", depth));
+        bookBoard.load(loadRanked("SELECT title, MAX(request_count), MIN(author) FROM books "
+                                  "GROUP BY title ORDER BY 2 DESC LIMIT ?;", depth));
     }
 
     std::vector<std::string> getTopAuthors(int limit = 10) {
-        return getTopStrings("SELECT author FROM author_requests ORDER BY request_count DESC LIMIT ?;", limit);
+        std::vector<std::string> result;
+        for (auto& entry : authorBoard.top(limit))
+            result.push_back(std::move(entry.key));
+        return result;
     }
     std::vector<std::string> getTopTopics(int limit = 10) {
-        return getTopStrings("SELECT topic FROM topic_requests ORDER BY request_count DESC LIMIT ?;", limit);
+        std::vector<std::string> result;
+        for (auto& entry : topicBoard.top(limit))
+            result.push_back(std::move(entry.key));
+        return result;
     }
     std::vector<std::pair<std::string, std::string>> getTopBooks(int limit = 10) {
-        return getTopPairs("SELECT title, author FROM books ORDER BY request_count DESC LIMIT ?;", limit);
+        std::vector<std::pair<std::string, std::string>> result;
+        for (auto& entry : bookBoard.top(limit))
+            result.emplace_back(std::move(entry.key), std::move(entry.extra));
+        return result;
     }
 
-    void increaseCount(const char* sql, const std::string& request) {
-        sqlite3_stmt* stmt;
-        if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) == SQLITE_OK) {
-            sqlite3_bind_text(stmt, 1, request.c_str(), -1, SQLITE_TRANSIENT);
-            if (sqlite3_step(stmt) != SQLITE_DONE) {
-                std::cerr << "Failed to update requests: " << sqlite3_errmsg(db) << std::endl;
-            }
-        }
-        sqlite3_finalize(stmt);
-
+    // Готовые тексты топ-10; пустая строка, если рейтинг пуст
+    std::string topAuthorsMessage() {
+        return authorBoard.render([](const std::vector<Leaderboard::Entry>& top) {
+            return formatTop(u8"🔥 *ТОП-10 АВТОРОВ:*\n\n", top);
+        });
+    }
+    std::string topTopicsMessage() {
+        return topicBoard.render([](const std::vector<Leaderboard::Entry>& top) {
+            return formatTop(u8"🔥 *ТОП-10 ТЕМ/ЖАНРОВ:*\n\n", top);
+        });
+    }
+    std::string topBooksMessage() {
+        return bookBoard.render([](const std::vector<Leaderboard::Entry>& top) {
+            return formatTop(u8"📚 *ТОП-10 КНИГ:*\n\n", top);
+        });
     }
 
+    // Рейтинг обновляется сразу, запись в базу — пачкой в фоне (RequestCounters).
+    // Базовое значение нового ключа читается до постановки инкремента в очередь записи:
+    // иначе сброс, успевший между ними, учёл бы этот инкремент дважды
     void increaseAuthorRequestCount(const std::string& author) {
-        increaseCount("INSERT INTO author_requests (author, request_count) VALUES (?, 1) "
-                      "ON CONFLICT(author) DO UPDATE SET request_count=request_count+1;", author);
-            }
+        authorBoard.increment(author, [this](const std::string& key) {
+            return lookupRanked("SELECT author, request_count FROM author_requests WHERE author = ?;", key,
+                                RequestCounters::Kind::Author, true);
+        });
+        counters.increment(RequestCounters::Kind::Author, author);
+    }
 
     void increaseTopicRequestCount(const std::string& topic) {
-        increaseCount("INSERT INTO topic_requests (topic, request_count) VALUES (?, 1) "
-                      "ON CONFLICT(topic) DO UPDATE SET request_count=request_count+1;", topic);
+        topicBoard.increment(topic, [this](const std::string& key) {
+            return lookupRanked("SELECT topic, request_count FROM topic_requests WHERE topic = ?;", key,
+                                RequestCounters::Kind::Topic, true);
+        });
+        counters.increment(RequestCounters::Kind::Topic, topic);
     }
 
     void increaseBookRequestCount(const std::string& title) {
-        increaseCount("UPDATE books SET request_count = request_count + 1 WHERE title = ?;", title);
+        bookBoard.increment(title, [this](const std::string& key) {
+            return lookupRanked("SELECT title, MAX(request_count), MIN(author) FROM books "
+                                "WHERE title = ? GROUP BY title;", key, RequestCounters::Kind::Book, false);
+        });
+        counters.increment(RequestCounters::Kind::Book, title);
     }
 
-    std::vector<std::string> findMatchingStrings(const char* sql, const std::string& userInput) {
+    // Останавливает фоновые задачи; вызывается до закрытия базы
+    void shutdown() {
+        counters.stop();
+    }
+
+    std::vector<std::string> findMatchingStrings(const char* sql, const std::string& param) {
         std::vector<std::string> result;
-        std::string pattern = "%" + userInput + "%";
-        sqlite3_stmt* stmt;
-        if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) == SQLITE_OK) {
-            sqlite3_bind_text(stmt, 1, pattern.c_str(), -1, SQLITE_TRANSIENT);
+        auto reader = db.read();
+        auto stmt = reader.statements().acquire(sql);
+        if (stmt) {
+            sqlite3_bind_text(stmt, 1, param.c_str(), -1, SQLITE_TRANSIENT);
             while (sqlite3_step(stmt) == SQLITE_ROW) {
                 const unsigned char* str = sqlite3_column_text(stmt, 0);
                 if (str) result.emplace_back(reinterpret_cast<const char*>(str));
             }
         }
-        sqlite3_finalize(stmt);
         return result;
     }
 
     std::vector<std::string> findMatchingAuthors(const std::string& userInput) {
-        return findMatchingStrings("SELECT DISTINCT author FROM books WHERE author LIKE ?", userInput);
+        std::string match = FullTextSearch::columnQuery("author", userInput);
+        if (match.empty())
+            return findMatchingStrings("SELECT DISTINCT author FROM books WHERE author LIKE ?", "%" + userInput + "%");
+        return findMatchingStrings("SELECT DISTINCT author FROM books WHERE rowid IN "
+                                   "(SELECT rowid FROM books_fts WHERE books_fts MATCH ?)", match);
     }
 
     std::vector<std::string> findMatchingTopics(const std::string& userInput) {
-        return findMatchingStrings("SELECT DISTINCT topic FROM books WHERE topic LIKE ?", userInput);
+        std::string match = FullTextSearch::columnQuery("topic", userInput);
+        if (match.empty())
+            return findMatchingStrings("SELECT DISTINCT topic FROM books WHERE topic LIKE ?", "%" + userInput + "%");
+        return findMatchingStrings("SELECT DISTINCT topic FROM books WHERE rowid IN "
+                                   "(SELECT rowid FROM books_fts WHERE books_fts MATCH ?)", match);
     }
 
     std::vector<std::pair<std::string, std::string>> findMatchingTitlesAuthors(const std::string& author, const std::string& title) {
         std::vector<std::pair<std::string, std::string>> books;
-        std::string pattern1 = "%" + author + "%";
-        std::string pattern2 = "%" + title + "%";
-        const char* sql = "SELECT DISTINCT title, author FROM books WHERE author LIKE ? AND title LIKE ?";
-        sqlite3_stmt* stmt;
-        if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) == SQLITE_OK) {
-            sqlite3_bind_text(stmt, 1, pattern1.c_str(), -1, SQLITE_TRANSIENT);
-            sqlite3_bind_text(stmt, 2, pattern2.c_str(), -1, SQLITE_TRANSIENT);
+        std::string match = FullTextSearch::matchAll({{"author", author}, {"title", title}});
+        auto reader = db.read();
+        StatementCache::Statement stmt;
+        if (match.empty()) {
+            stmt = reader.statements().acquire("SELECT DISTINCT title, author FROM books WHERE author LIKE ? AND title LIKE ?");
+            if (stmt) {
+                sqlite3_bind_text(stmt, 1, ("%" + author + "%").c_str(), -1, SQLITE_TRANSIENT);
+                sqlite3_bind_text(stmt, 2, ("%" + title + "%").c_str(), -1, SQLITE_TRANSIENT);
+            }
+        } else {
+            stmt = reader.statements().acquire("SELECT DISTINCT title, author FROM books WHERE rowid IN "
+                                               "(SELECT rowid FROM books_fts WHERE books_fts MATCH ?)");
+            if (stmt)
+                sqlite3_bind_text(stmt, 1, match.c_str(), -1, SQLITE_TRANSIENT);
+        }
+        if (stmt) {
             while (sqlite3_step(stmt) == SQLITE_ROW) {
                 const unsigned char* titleStr = sqlite3_column_text(stmt, 0);
                 const unsigned char* authorStr = sqlite3_column_text(stmt, 1);
@@ -340,138 +495,278 @@ public:
                     books.emplace_back(reinterpret_cast<const char*>(titleStr), reinterpret_cast<const char*>(authorStr));
             }
         }
-        sqlite3_finalize(stmt);
         return books;
     }
 
-private:
-    void editPage(int64_t chatId, int messageId, int page,
-                  const std::string &whereClause,
-                  const std::vector<std::string> &params) {
-        auto books = loadPage(whereClause, params, page, pageSize);
-        int count = loadTotalCount(whereClause, params);
-        int totalPages = (count + pageSize - 1) / pageSize;
+    // --- нечёткие подсказки: словари авторов, тем и названий в памяти ---
+    void loadSuggestions() {
+        const std::pair<const char*, TrigramIndex*> sources[] = {
+                {"SELECT DISTINCT author FROM books;", &authorIndex},
+                {"SELECT DISTINCT topic FROM books;", &topicIndex},
+                {"SELECT DISTINCT title FROM books;", &titleIndex}
+        };
+        for (const auto& [sql, index] : sources) {
+            auto reader = db.read();
+            auto stmt = reader.statements().acquire(sql);
+            if (!stmt) {
+                std::cerr << "Failed to load suggestions: " << reader.errmsg() << std::endl;
+                continue;
+            }
+            while (sqlite3_step(stmt) == SQLITE_ROW) {
+                const unsigned char* v = sqlite3_column_text(stmt, 0);
+                if (v) index->add(reinterpret_cast<const char*>(v));
+            }
+        }
+    }
 
-        auto text = formatMessage(books, page, totalPages);
+    void indexBook(const std::string& title, const std::string& author, const std::string& topic) {
+        titleIndex.add(title);
+        authorIndex.add(author);
+        topicIndex.add(topic);
+    }
 
-        if(books.empty())
-            bot.getApi().editMessageText(text, chatId, messageId, "", "Markdown", false, nullptr);
-        else {
-            auto keyboard = buildKeyboard(books, page, totalPages, whereClause, params);
-            bot.getApi().editMessageText(text, chatId, messageId, "", "Markdown", false, keyboard);
-        }
+    std::vector<std::string> suggest(const std::string& fieldName, const std::string& userInput, size_t limit = 3) {
+        const TrigramIndex* index = fieldName == "author" ? &authorIndex
+                                  : fieldName == "topic" ? &topicIndex
+                                  : fieldName == "title" ? &titleIndex : nullptr;
+        std::vector<std::string> result;
+        if (!index)
+            return result;
+        for (auto& match : index->similar(userInput, limit))
+            result.push_back(std::move(match.value));
+        return result;
     }
 
-    void sendBook(int64_t chatId, int bookId) {
-        const char* sql = "SELECT title, author, file_path FROM books WHERE rowid = ?;";
-        sqlite3_stmt* stmt;
+private:
+    static std::vector<Leaderboard::Entry> readRanked(sqlite3_stmt* stmt) {
+        std::vector<Leaderboard::Entry> entries;
+        bool hasExtra = sqlite3_column_count(stmt) > 2;
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            const unsigned char* key = sqlite3_column_text(stmt, 0);
+            const unsigned char* extra = hasExtra ? sqlite3_column_text(stmt, 2) : nullptr;
+            if (!key || (hasExtra && !extra))
+                continue;
+            entries.push_back({reinterpret_cast<const char*>(key),
+                               extra ? reinterpret_cast<const char*>(extra) : "",
+                               sqlite3_column_int64(stmt, 1)});
+        }
+        return entries;
+    }
 
-        if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-            try { bot.getApi().sendMessage(chatId, "Произошла ошибка при доступе к базе."); } catch(...) {}
-            sqlite3_finalize(stmt);
-            return;
+    std::vector<Leaderboard::Entry> loadRanked(const char* sql, int limit) {
+        auto reader = db.read();
+        auto stmt = reader.statements().acquire(sql);
+        if (!stmt) {
+            std::cerr << "Failed to prepare top query: " << reader.errmsg() << std::endl;
+            return {};
         }
+        sqlite3_bind_int(stmt, 1, limit);
+        return readRanked(stmt);
+    }
 
-        sqlite3_bind_int(stmt, 1, bookId);
+    // upsert: авторы и темы появляются в рейтинге с первого запроса, книги — только существующие.
+    // Вытесненный из рейтинга ключ читается заново, а часть его инкрементов ещё ждёт записи:
+    // они прибавляются к значению из базы, чтение и сброс счётчиков не перекрываются
+    std::optional<Leaderboard::Entry> lookupRanked(const char* sql, const std::string& key,
+                                                   RequestCounters::Kind kind, bool upsert) {
+        auto paused = counters.pauseFlush();
+        std::optional<Leaderboard::Entry> entry;
+        {
+            auto reader = db.read();
+            auto stmt = reader.statements().acquire(sql);
+            if (!stmt) {
+                std::cerr << "Failed to prepare top query: " << reader.errmsg() << std::endl;
+                return std::nullopt;
+            }
+            sqlite3_bind_text(stmt, 1, key.c_str(), -1, SQLITE_TRANSIENT);
+            auto stored = readRanked(stmt);
+            if (!stored.empty())
+                entry = stored.front();
+            else if (upsert)
+                entry = Leaderboard::Entry{key, "", 0};
+        }
+        if (entry)
+            entry->count += counters.pending(kind, key);
+        return entry;
+    }
 
-        std::string title;
-        std::string author;
-        std::string path;
+    static std::string formatTop(const char* header, const std::vector<Leaderboard::Entry>& top) {
+        if (top.empty())
+            return "";
+        std::ostringstream oss;
+        oss << header;
+        int num = 1;
+        for (const auto& entry : top) {
+            oss << num++ << ". " << entry.key;
+            if (!entry.extra.empty())
+                oss << " — " << entry.extra;
+            oss << "\n";
+        }
+        return oss.str();
+    }
 
-        if (sqlite3_step(stmt) == SQLITE_ROW) {
-            const unsigned char* textTitle = sqlite3_column_text(stmt, 0);
-            if (textTitle)
-                title = reinterpret_cast<const char*>(textTitle);
+    static std::string selectSql(const std::string& whereClause) {
+        if (FullTextSearch::isRanked(whereClause))
+            return "SELECT books.rowid, books.title, books.author, books.topic, books.file_path "
+                   "FROM books_fts JOIN books ON books.rowid = books_fts.rowid WHERE " + whereClause;
+        std::string sql = "SELECT rowid, title, author, topic, file_path FROM books";
+        if (!whereClause.empty()) sql += " WHERE " + whereClause;
+        return sql;
+    }
 
-            const unsigned char* textAuthor = sqlite3_column_text(stmt, 1);
-            if (textAuthor)
-                author = reinterpret_cast<const char*>(textAuthor);
+    // bm25 (rank) с добивкой по популярности для FTS, иначе порядок каталога
+    static std::string orderSql(const std::string& whereClause) {
+        return FullTextSearch::isRanked(whereClause) ? " ORDER BY books_fts.rank, books.request_count DESC"
+                                                     : " ORDER BY rowid";
+    }
 
-            const unsigned char* textPath = sqlite3_column_text(stmt, 2);
-            if (textPath)
-                path = reinterpret_cast<const char*>(textPath);
+    static std::vector<BookItem> readBooks(sqlite3_stmt* stmt) {
+        std::vector<BookItem> books;
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            BookItem item;
+            item.id = sqlite3_column_int(stmt, 0);
+            item.title = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+            item.author = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
+            item.topic = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
+            item.file_path = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4));
+            books.push_back(item);
         }
-        sqlite3_finalize(stmt);
+        return books;
+    }
 
-        if (path.empty()) {
-            try { bot.getApi().sendMessage(chatId, "Книга не найдена."); } catch(...) {}
-            return;
+    std::vector<BookItem> loadSeekPage(const std::string& whereClause, const std::vector<std::string>& params,
+                                       int anchor, int pageSize, bool forward) {
+        auto reader = db.read();
+        auto stmt = reader.statements().acquire((forward ? "after:" : "before:") + whereClause, [&] {
+            std::string sql = "SELECT rowid, title, author, topic, file_path FROM books WHERE ";
+            if (!whereClause.empty()) sql += "(" + whereClause + ") AND ";
+            sql += forward ? "rowid > ? ORDER BY rowid" : "rowid < ? ORDER BY rowid DESC";
+            return sql + " LIMIT ?;";
+        });
+        if (!stmt) {
+            std::cerr << "Failed to prepare paginator SQL: " << reader.errmsg() << std::endl;
+            return {};
         }
 
-        try {
-            std::filesystem::path dir("C:\\tmp");
-            std::filesystem::create_directories(dir);
-
-            if(isBiggerThan50MB(yandex.getResourceInfo(path)))
-                throw "BigFile";
-
-            std::filesystem::path localPath = dir / std::filesystem::path(path).filename();
+        int index = 1;
+        for (const auto& param : params)
+            sqlite3_bind_text(stmt, index++, param.c_str(), -1, SQLITE_TRANSIENT);
 
-            if (!std::filesystem::exists(localPath)) {
+        sqlite3_bind_int(stmt, index++, anchor);
+        sqlite3_bind_int(stmt, index++, pageSize);
 
-                bool ok = yandex.downloadFile(path, dir.string());
-                if (!ok) {
-                    try { bot.getApi().sendMessage(chatId, "Ошибка загрузки книги"); } catch(...) {}
-                    std::cerr << "Ошибка загрузки книги \"" << title << "\" автора \"" << author << "\"" << std::endl;
-                    return;
-                }
-            } else {
-                std::cout << "Файл уже существует: " << localPath.string() << " (" << title << " — " << author << ")" << std::endl;
-            }
+        return readBooks(stmt);
+    }
 
-            std::string ext = localPath.extension().string();
-            std::string mimeType = "application/octet-stream";
-            if (ext == ".pdf") mimeType = "application/pdf";
-            else if (ext == ".epub") mimeType = "application/epub+zip";
-            else if (ext == ".txt") mimeType = "text/plain";
+    struct PageView {
+        std::vector<BookItem> books;
+        int page = 0;
+        int totalPages = 0;
+        TgBot::InlineKeyboardMarkup::Ptr keyboard;
+    };
+
+    PageView catalogView(std::vector<BookItem> books, int page) {
+        PageView view;
+        view.books = std::move(books);
+        view.page = page;
+        view.totalPages = (loadTotalCount("", {}) + pageSize - 1) / pageSize;
+        view.keyboard = buildKeyboard(view.books, page, view.totalPages, "", {});
+        return view;
+    }
 
-            auto inputFile = TgBot::InputFile::fromFile(localPath.string(), mimeType);
+    // Страница — срез списка id; номер страницы ограничивается размером результата
+    PageView resultView(const std::string& handle, const std::vector<int>& ids, int page) {
+        PageView view;
+        view.totalPages = static_cast<int>((ids.size() + pageSize - 1) / pageSize);
+        view.page = std::max(0, std::min(page, view.totalPages - 1));
+        size_t first = static_cast<size_t>(view.page) * pageSize;
+        size_t last = std::min(ids.size(), first + pageSize);
+        if (first < last)
+            view.books = loadBooksByIds(std::vector<int>(ids.begin() + first, ids.begin() + last));
+        view.keyboard = buildResultKeyboard(view.books, view.page, view.totalPages, handle);
+        return view;
+    }
 
-            bot.getApi().sendDocument(chatId, inputFile);
+    // messageId == 0 — новое сообщение, иначе редактирование существующего
+    void showPage(int64_t chatId, int messageId, const PageView& view) {
+        auto text = formatMessage(view.books, view.page, view.totalPages);
+        auto keyboard = view.books.empty() ? nullptr : view.keyboard;
+        if (messageId == 0)
+            outbox.sendMessage(chatId, text, "Markdown", keyboard);
+        else
+            outbox.editMessageText(chatId, messageId, text, "Markdown", keyboard);
+    }
 
+    std::vector<int> loadIds(const std::string& whereClause, const std::vector<std::string>& params) {
+        std::vector<int> ids;
+        auto reader = db.read();
+        auto stmt = reader.statements().acquire("ids:" + whereClause, [&] {
+            std::string sql = FullTextSearch::isRanked(whereClause)
+                    ? "SELECT books.rowid FROM books_fts JOIN books ON books.rowid = books_fts.rowid WHERE " + whereClause
+                    : "SELECT rowid FROM books" + (whereClause.empty() ? "" : " WHERE " + whereClause);
+            return sql + orderSql(whereClause) + ";";
+        });
+        if (!stmt) {
+            std::cerr << "Failed to prepare result SQL: " << reader.errmsg() << std::endl;
+            return ids;
         }
 
-        catch(const char*) {
+        int index = 1;
+        for (const auto& param : params)
+            sqlite3_bind_text(stmt, index++, param.c_str(), -1, SQLITE_TRANSIENT);
 
-            yandex.publish(path);
-            try { bot.getApi().sendMessage(chatId, fmt::format(u8"*Файл слиишком большой!* 😢"
-                                                               "\n\n Поэтому держи ссылку для скачивания: \n\n {}",
-                                                               yandex.getPublicDownloadLink(path)),
-                                           false,
-                                           0, nullptr, "Markdown");
-            } catch (...) {}
-        }
+        while (sqlite3_step(stmt) == SQLITE_ROW)
+            ids.push_back(sqlite3_column_int(stmt, 0));
+        return ids;
+    }
 
-        catch (const std::exception& e) {
+    // Не больше pageSize id за раз: один и тот же запрос с фиксированным числом параметров
+    std::vector<BookItem> loadBooksByIds(const std::vector<int>& ids) {
+        auto reader = db.read();
+        auto stmt = reader.statements().acquire("byids", [] {
+            std::string sql = "SELECT rowid, title, author, topic, file_path FROM books WHERE rowid IN (?";
+            for (int i = 1; i < pageSize; ++i)
+                sql += ", ?";
+            return sql + ");";
+        });
+        if (!stmt) {
+            std::cerr << "Failed to prepare paginator SQL: " << reader.errmsg() << std::endl;
+            return {};
+        }
 
-            try { bot.getApi().sendMessage(chatId, "Произошла ошибка во время отправки книги"); } catch (...) {}
-            std::cerr << "Ошибка при загрузке/отправке книги \"" << title << "\" автора \"" << author << "\": "
-                      << e.what() << std::endl;
+        for (int i = 0; i < pageSize; ++i) {
+            if (i < static_cast<int>(ids.size()))
+                sqlite3_bind_int(stmt, i + 1, ids[i]);
+            else
+                sqlite3_bind_null(stmt, i + 1);
         }
-    }
+        auto rows = readBooks(stmt);
 
-    bool isBiggerThan50MB(const std::string& infoStr) {
-        std::istringstream ss(infoStr);
-        std::string line;
-        while (std::getline(ss, line)) {
-            auto pos = line.find("Size:");
-            if (pos != std::string::npos) {
-                double value = 0.0;
-                std::string unit;
-                std::istringstream sizeStream(line.substr(pos + 5));
-                sizeStream >> value >> unit;
-                return (value > 50.0)&&(unit == "MB");
-            }
+        // IN не сохраняет порядок — раскладываем строки в порядке результата
+        std::vector<BookItem> books;
+        for (int id : ids) {
+            auto it = std::find_if(rows.begin(), rows.end(), [id](const BookItem& item) { return item.id == id; });
+            if (it != rows.end())
+                books.push_back(*it);
         }
-        return false;
+        return books;
     }
 
-    sqlite3* db;
-    TgBot::Bot& bot;
-    YandexDiskClient& yandex;
+    Database& db;
+    TelegramOutbox& outbox;
+    BookDelivery& delivery;
+    RequestCounters counters;
+    ResultRegistry results;
+    Leaderboard authorBoard;
+    Leaderboard topicBoard;
+    Leaderboard bookBoard;
+
+    TrigramIndex authorIndex;
+    TrigramIndex topicIndex;
+    TrigramIndex titleIndex;
 
     const static int pageSize = 10;
-    std::map<int64_t, int> userPages;
+    SessionStore<int> userPages;
 };
 
 #endif
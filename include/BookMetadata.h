@@ -0,0 +1,233 @@
+#ifndef TG_BOT_BOOKMETADATA_H
+#define TG_BOT_BOOKMETADATA_H
+
+#pragma once
+
+#include <sqlite3.h>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include "Database.h"
+#include "DiskApi.h"
+
+/**
+ * Метаданные файлов книг (размер, md5, MIME) в типизированных колонках books.
+ * Их заполняет DiskSync при обходе папки, а для книг, попавших в базу иначе,
+ * они запрашиваются у Disk API при первой выдаче. Устаревшие (старше ttl)
+ * данные отдаются как есть, а сверка с диском уходит в фоновый поток, —
+ * нажатие "Скачать" не ждёт лишнего запроса к API.
+ *
+ * Если md5 на диске сменился, сохранённый file_id книги удаляется, а
+ * onChanged сообщает об этом, чтобы можно было сбросить локальную копию.
+ */
+
+class BookMetadata {
+public:
+    struct Info {
+        bool known = false;         // размер получен с диска
+        int64_t size = 0;
+        std::string md5;
+        std::string mimeType;
+        int64_t checkedAt = 0;      // unix-время последней сверки
+    };
+
+    using Changed = std::function<void(int bookId, const std::string& path)>;
+
+    BookMetadata(Database& db_, DiskApi& api_, std::chrono::seconds ttl_ = std::chrono::hours(24),
+                 size_t maxPending_ = 1024)
+            : db(db_), api(api_), ttl(ttl_), maxPending(maxPending_), worker(&BookMetadata::run, this) {}
+
+    ~BookMetadata() {
+        stop();
+    }
+
+    BookMetadata(const BookMetadata&) = delete;
+    BookMetadata& operator=(const BookMetadata&) = delete;
+
+    void onChanged(Changed callback) {
+        changed = std::move(callback);
+    }
+
+    // cached — колонки из строки books; неизвестное запрашивается сразу, устаревшее — в фоне
+    Info ensure(int bookId, const std::string& path, Info cached) {
+        if (!cached.known)
+            return refresh(bookId, path, cached);
+        if (now() - cached.checkedAt >= ttl.count())
+            schedule(bookId, path);
+        return cached;
+    }
+
+    // То же без ожидания: для книг, которые уходят по file_id и не ждут размера
+    void check(int bookId, const std::string& path, const Info& cached) {
+        if (!cached.known || now() - cached.checkedAt >= ttl.count())
+            schedule(bookId, path);
+    }
+
+    // Читает колонки size, md5, mime_type, meta_checked, начиная с column
+    static Info fromRow(sqlite3_stmt* stmt, int column) {
+        Info info;
+        info.known = sqlite3_column_type(stmt, column) != SQLITE_NULL;
+        info.size = sqlite3_column_int64(stmt, column);
+        info.md5 = text(stmt, column + 1);
+        info.mimeType = text(stmt, column + 2);
+        info.checkedAt = sqlite3_column_int64(stmt, column + 3);
+        return info;
+    }
+
+    // Запасной вариант, когда диск не сообщил MIME
+    static std::string mimeForExtension(const std::string& path) {
+        std::string ext = std::filesystem::path(path).extension().string();
+        if (ext == ".pdf") return "application/pdf";
+        if (ext == ".epub") return "application/epub+zip";
+        if (ext == ".txt") return "text/plain";
+        return "application/octet-stream";
+    }
+
+    // Сколько раз метаданные запрашивались у диска
+    uint64_t refreshes() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return refreshCount;
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        if (worker.joinable())
+            worker.join();
+    }
+
+private:
+    struct Pending {
+        int bookId;
+        std::string path;
+    };
+
+    void schedule(int bookId, const std::string& path) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopping || queue.size() >= maxPending || !queued.insert(bookId).second)
+                return;
+            queue.push_back({bookId, path});
+        }
+        wake.notify_one();
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            wake.wait(lock, [this] { return stopping || !queue.empty(); });
+            if (stopping)
+                break;
+            Pending next = std::move(queue.front());
+            queue.pop_front();
+            lock.unlock();
+
+            // Старые данные нужны только для сравнения md5
+            Info previous;
+            {
+                auto reader = db.read();
+                auto stmt = reader.statements().acquire(
+                        "SELECT size, md5, mime_type, meta_checked FROM books WHERE rowid = ?;");
+                if (stmt) {
+                    sqlite3_bind_int(stmt, 1, next.bookId);
+                    if (sqlite3_step(stmt) == SQLITE_ROW)
+                        previous = fromRow(stmt, 0);
+                }
+            }
+            refresh(next.bookId, next.path, previous);
+
+            lock.lock();
+            queued.erase(next.bookId);
+        }
+    }
+
+    // Запрос к диску; при ошибке возвращает то, что было
+    Info refresh(int bookId, const std::string& path, const Info& previous) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++refreshCount;
+        }
+        auto resource = api.info(path);
+        if (!resource || resource->type != "file")
+            return previous;
+
+        Info info;
+        info.known = true;
+        info.size = resource->size;
+        info.md5 = resource->md5;
+        info.mimeType = resource->mimeType;
+        info.checkedAt = now();
+        bool contentChanged = !previous.md5.empty() && previous.md5 != info.md5;
+        store(bookId, info, contentChanged);
+
+        if (contentChanged) {
+            std::cout << "Book " << bookId << " changed on disk, dropping cached copies" << std::endl;
+            if (changed)
+                changed(bookId, path);
+        }
+        return info;
+    }
+
+    // dropFileId — содержимое сменилось, сохранённый file_id больше не подходит
+    void store(int bookId, const Info& info, bool dropFileId) {
+        db.write([this, bookId, info, dropFileId] {
+            auto stmt = db.statements().acquire(
+                    "UPDATE books SET size = ?, md5 = ?, mime_type = ?, meta_checked = ? WHERE rowid = ?;");
+            if (!stmt)
+                return false;
+            sqlite3_bind_int64(stmt, 1, info.size);
+            sqlite3_bind_text(stmt, 2, info.md5.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_text(stmt, 3, info.mimeType.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_int64(stmt, 4, info.checkedAt);
+            sqlite3_bind_int(stmt, 5, bookId);
+            if (sqlite3_step(stmt) != SQLITE_DONE) {
+                std::cerr << "Failed to store book metadata: " << db.errmsg() << std::endl;
+                return false;
+            }
+            if (!dropFileId)
+                return true;
+            auto drop = db.statements().acquire("DELETE FROM book_files WHERE book_id = ?;");
+            if (!drop)
+                return false;
+            sqlite3_bind_int(drop, 1, bookId);
+            return sqlite3_step(drop) == SQLITE_DONE;
+        });
+    }
+
+    static int64_t now() {
+        return std::chrono::duration_cast<std::chrono::seconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    static std::string text(sqlite3_stmt* stmt, int column) {
+        const unsigned char* value = sqlite3_column_text(stmt, column);
+        return value ? reinterpret_cast<const char*>(value) : "";
+    }
+
+    Database& db;
+    DiskApi& api;
+    const std::chrono::seconds ttl;
+    const size_t maxPending;
+    Changed changed;
+
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<Pending> queue;
+    std::unordered_set<int> queued;
+    uint64_t refreshCount = 0;
+    bool stopping = false;
+    std::thread worker;
+};
+
+#endif // TG_BOT_BOOKMETADATA_H
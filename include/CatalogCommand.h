@@ -5,14 +5,11 @@
 
 #include "ICommand.h"
 #include "BookListPaginator.h"
-#include "YandexDiskClient.h"
-
-#include <sqlite3.h>
 
 class CatalogCommand : public ICommand {
 public:
-    CatalogCommand(sqlite3* db_, TgBot::Bot& bot_, YandexDiskClient& yandex_)
-            : db(db_), bot(bot_), yandex(yandex_), paginator(db_, bot_, yandex_) {}
+    explicit CatalogCommand(BookListPaginator& paginator_)
+            : paginator(paginator_) {}
 
     void execute(TgBot::Bot& /*bot*/, TgBot::Message::Ptr message) override {
         paginator.setUserPage(message->from->id, 0);
@@ -20,10 +17,7 @@ public:
     }
 
 private:
-    sqlite3* db;
-    TgBot::Bot& bot;
-    YandexDiskClient& yandex;
-    BookListPaginator paginator;
+    BookListPaginator& paginator;
 };
 
 #endif // TG_BOT_ELECTRONIC_LIBRARY_CATALOGCOMMAND_H
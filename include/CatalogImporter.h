@@ -0,0 +1,446 @@
+#ifndef TG_BOT_CATALOGIMPORTER_H
+#define TG_BOT_CATALOGIMPORTER_H
+
+#pragma once
+
+#include <sqlite3.h>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <istream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Database.h"
+#include "FullTextSearch.h"
+
+/**
+ * Потоковый импорт каталога из CSV или JSONL.
+ * Файл читается по одной записи, вставка идёт одним подготовленным
+ * выражением внутри транзакций по batchSize строк. На время загрузки
+ * синхронизация FTS-индекса отключается, после — новые строки
+ * индексируются одним запросом. Повторы по file_path пропускаются (INSERT OR IGNORE),
+ * поэтому прерванный импорт можно просто запустить заново.
+ *
+ * CSV: title,author,topic,file_path; заголовок необязателен, порядок колонок
+ * берётся из него. JSONL: по объекту на строку с теми же ключами.
+ */
+
+class CatalogImporter {
+public:
+    struct Row {
+        std::string title;
+        std::string author;
+        std::string topic;
+        std::string file_path;
+    };
+
+    struct Stats {
+        size_t rows = 0;        // прочитано записей
+        size_t inserted = 0;
+        size_t duplicates = 0;  // уже были в каталоге
+        size_t skipped = 0;     // битые записи и записи без обязательных полей
+        double seconds = 0;
+
+        double rowsPerSecond() const {
+            return seconds > 0 ? rows / seconds : 0;
+        }
+    };
+
+    explicit CatalogImporter(Database& db_, size_t batchSize_ = 50000)
+            : db(db_), batchSize(batchSize_) {}
+
+    ~CatalogImporter() {
+        if (started)
+            finish();
+    }
+
+    CatalogImporter(const CatalogImporter&) = delete;
+    CatalogImporter& operator=(const CatalogImporter&) = delete;
+
+    // deferIndex — отключить построчное обновление FTS (имеет смысл для больших загрузок)
+    bool begin(bool deferIndex = true) {
+        stats = Stats();
+        startedAt = Clock::now();
+        deferredIndex = deferIndex && FullTextSearch::available();
+
+        synchronousBefore = pragmaValue("synchronous", 2);     // FULL — значение SQLite по умолчанию
+        cacheSizeBefore = pragmaValue("cache_size", -2000);
+        // Импорт перезапускаем, поэтому на его время можно не ждать fsync
+        sqlite3_exec(db.handle(), "PRAGMA synchronous = OFF; PRAGMA cache_size = -65536;", nullptr, nullptr, nullptr);
+        if (deferredIndex) {
+            lastIndexed = maxBookId();
+            FullTextSearch::suspendSync(db.handle());
+        }
+
+        if (sqlite3_prepare_v2(db.handle(),
+                               "INSERT OR IGNORE INTO books (title, author, topic, file_path, request_count)"
+                               " VALUES (?, ?, ?, ?, 0);", -1, &insert, nullptr) != SQLITE_OK) {
+            std::cerr << "Request preparation error: " << db.errmsg() << std::endl;
+            restore();
+            return false;
+        }
+        started = true;
+        return beginBatch();
+    }
+
+    bool add(const Row& row) {
+        ++stats.rows;
+        if (row.title.empty() || row.author.empty() || row.topic.empty()) {
+            ++stats.skipped;
+            return true;
+        }
+
+        sqlite3_bind_text(insert, 1, row.title.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(insert, 2, row.author.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(insert, 3, row.topic.c_str(), -1, SQLITE_TRANSIENT);
+        if (row.file_path.empty())
+            sqlite3_bind_null(insert, 4);
+        else
+            sqlite3_bind_text(insert, 4, row.file_path.c_str(), -1, SQLITE_TRANSIENT);
+
+        if (sqlite3_step(insert) != SQLITE_DONE) {
+            std::cerr << "Insertion error: " << db.errmsg() << std::endl;
+            ++stats.skipped;
+        } else if (sqlite3_changes(db.handle()) == 0) {
+            ++stats.duplicates;
+        } else {
+            ++stats.inserted;
+        }
+        sqlite3_reset(insert);
+
+        if (++inBatch >= batchSize) {
+            if (!commitBatch() || !beginBatch())
+                return false;
+            report();
+        }
+        return true;
+    }
+
+    Stats finish() {
+        if (!started)
+            return stats;
+        started = false;
+        commitBatch();
+        sqlite3_finalize(insert);
+        insert = nullptr;
+
+        if (deferredIndex) {
+            auto indexStart = Clock::now();
+            FullTextSearch::resumeSync(db.handle(), lastIndexed);
+            std::cout << "Full-text index updated in " << std::fixed << std::setprecision(1)
+                      << secondsSince(indexStart) << " s" << std::endl;
+        }
+        restore();
+        stats.seconds = secondsSince(startedAt);
+        return stats;
+    }
+
+    // Формат определяется по расширению: .csv, иначе JSONL
+    Stats importFile(const std::string& path) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) {
+            std::cerr << "Can't open catalog file: " << path << std::endl;
+            return stats;
+        }
+        bool csv = path.size() >= 4 && path.compare(path.size() - 4, 4, ".csv") == 0;
+        return csv ? importCsv(in) : importJsonl(in);
+    }
+
+    Stats importCsv(std::istream& in) {
+        if (!begin())
+            return stats;
+
+        std::vector<std::string> fields;
+        std::vector<int> columns = {0, 1, 2, 3}; // title, author, topic, file_path
+        bool first = true;
+        while (readCsvRecord(in, fields)) {
+            if (first) {
+                first = false;
+                if (!fields.empty() && fields[0].rfind("\xEF\xBB\xBF", 0) == 0)
+                    fields[0].erase(0, 3);
+                if (parseHeader(fields, columns))
+                    continue;
+            }
+            if (fields.size() == 1 && fields[0].empty())
+                continue; // пустая строка
+
+            Row row;
+            std::string* targets[] = {&row.title, &row.author, &row.topic, &row.file_path};
+            for (size_t k = 0; k < 4; ++k) {
+                if (columns[k] >= 0 && columns[k] < static_cast<int>(fields.size()))
+                    *targets[k] = fields[columns[k]];
+            }
+            if (!add(row))
+                break;
+        }
+        return finish();
+    }
+
+    Stats importJsonl(std::istream& in) {
+        if (!begin())
+            return stats;
+
+        std::string line;
+        std::unordered_map<std::string, std::string> object;
+        while (std::getline(in, line)) {
+            if (line.find_first_not_of(" \t\r") == std::string::npos)
+                continue;
+            Row row;
+            if (parseJsonObject(line, object)) {
+                row.title = object["title"];
+                row.author = object["author"];
+                row.topic = object["topic"];
+                row.file_path = object.count("file_path") ? object["file_path"] : object["path"];
+            }
+            if (!add(row)) // битая строка — пустые поля, попадёт в skipped
+                break;
+        }
+        return finish();
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    static double secondsSince(Clock::time_point start) {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    bool beginBatch() {
+        inBatch = 0;
+        if (sqlite3_exec(db.handle(), "BEGIN IMMEDIATE;", nullptr, nullptr, nullptr) != SQLITE_OK) {
+            std::cerr << "Failed to begin import batch: " << db.errmsg() << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool commitBatch() {
+        if (sqlite3_get_autocommit(db.handle()))
+            return true;
+        if (sqlite3_exec(db.handle(), "COMMIT;", nullptr, nullptr, nullptr) != SQLITE_OK) {
+            std::cerr << "Failed to commit import batch: " << db.errmsg() << std::endl;
+            sqlite3_exec(db.handle(), "ROLLBACK;", nullptr, nullptr, nullptr);
+            return false;
+        }
+        return true;
+    }
+
+    void report() const {
+        double elapsed = secondsSince(startedAt);
+        std::cout << "Imported " << stats.rows << " rows (" << std::fixed << std::setprecision(0)
+                  << (elapsed > 0 ? stats.rows / elapsed : 0) << " rows/s)" << std::endl;
+    }
+
+    void restore() {
+        // Соединение общее с ботом — возвращаем его собственные настройки, а не значения по умолчанию
+        std::string sql = "PRAGMA synchronous = " + std::to_string(synchronousBefore) +
+                          "; PRAGMA cache_size = " + std::to_string(cacheSizeBefore) + ";";
+        sqlite3_exec(db.handle(), sql.c_str(), nullptr, nullptr, nullptr);
+    }
+
+    int64_t maxBookId() {
+        int64_t id = 0;
+        sqlite3_stmt* stmt;
+        if (sqlite3_prepare_v2(db.handle(), "SELECT COALESCE(MAX(id), 0) FROM books;", -1, &stmt, nullptr) == SQLITE_OK &&
+            sqlite3_step(stmt) == SQLITE_ROW)
+            id = sqlite3_column_int64(stmt, 0);
+        sqlite3_finalize(stmt);
+        return id;
+    }
+
+    int64_t pragmaValue(const char* name, int64_t fallback) {
+        int64_t value = fallback;
+        sqlite3_stmt* stmt;
+        std::string sql = std::string("PRAGMA ") + name + ";";
+        if (sqlite3_prepare_v2(db.handle(), sql.c_str(), -1, &stmt, nullptr) == SQLITE_OK &&
+            sqlite3_step(stmt) == SQLITE_ROW)
+            value = sqlite3_column_int64(stmt, 0);
+        sqlite3_finalize(stmt);
+        return value;
+    }
+
+    static bool parseHeader(const std::vector<std::string>& fields, std::vector<int>& columns) {
+        static const char* names[] = {"title", "author", "topic", "file_path"};
+        std::vector<int> found(4, -1);
+        for (size_t i = 0; i < fields.size(); ++i) {
+            for (size_t k = 0; k < 4; ++k) {
+                if (fields[i] == names[k] || (k == 3 && fields[i] == "path"))
+                    found[k] = static_cast<int>(i);
+            }
+        }
+        if (found[0] < 0)
+            return false; // заголовка нет — первая строка с данными
+        columns = found;
+        return true;
+    }
+
+    // Одна запись CSV (RFC 4180): поля в кавычках могут содержать запятые и переводы строк
+    static bool readCsvRecord(std::istream& in, std::vector<std::string>& fields) {
+        fields.assign(1, std::string());
+        bool quoted = false;
+        bool any = false;
+        char c;
+        while (in.get(c)) {
+            any = true;
+            if (quoted) {
+                if (c != '"') {
+                    fields.back() += c;
+                } else if (in.peek() == '"') {
+                    in.get(c);
+                    fields.back() += '"';
+                } else {
+                    quoted = false;
+                }
+            } else if (c == '"') {
+                quoted = true;
+            } else if (c == ',') {
+                fields.emplace_back();
+            } else if (c == '\n') {
+                return true;
+            } else if (c != '\r') {
+                fields.back() += c;
+            }
+        }
+        return any;
+    }
+
+    // Плоский JSON-объект: строковые значения и скаляры; вложенные объекты не поддерживаются
+    static bool parseJsonObject(const std::string& text, std::unordered_map<std::string, std::string>& object) {
+        object.clear();
+        size_t i = 0;
+        auto skipSpace = [&] { while (i < text.size() && isspace(static_cast<unsigned char>(text[i]))) ++i; };
+
+        skipSpace();
+        if (i >= text.size() || text[i++] != '{')
+            return false;
+        skipSpace();
+        if (i < text.size() && text[i] == '}')
+            return true;
+
+        while (i < text.size()) {
+            std::string key, value;
+            skipSpace();
+            if (!parseJsonString(text, i, key))
+                return false;
+            skipSpace();
+            if (i >= text.size() || text[i++] != ':')
+                return false;
+            skipSpace();
+            if (i < text.size() && text[i] == '"') {
+                if (!parseJsonString(text, i, value))
+                    return false;
+            } else {
+                size_t start = i;
+                while (i < text.size() && text[i] != ',' && text[i] != '}' && !isspace(static_cast<unsigned char>(text[i])))
+                    ++i;
+                value = text.substr(start, i - start);
+                if (value == "null")
+                    value.clear();
+            }
+            object[key] = value;
+            skipSpace();
+            if (i >= text.size())
+                return false;
+            if (text[i] == '}')
+                return true;
+            if (text[i++] != ',')
+                return false;
+        }
+        return false;
+    }
+
+    static bool parseJsonString(const std::string& text, size_t& i, std::string& out) {
+        if (i >= text.size() || text[i++] != '"')
+            return false;
+        while (i < text.size()) {
+            char c = text[i++];
+            if (c == '"')
+                return true;
+            if (c != '\\') {
+                out += c;
+                continue;
+            }
+            if (i >= text.size())
+                return false;
+            char e = text[i++];
+            switch (e) {
+                case 'n': out += '\n'; break;
+                case 't': out += '\t'; break;
+                case 'r': out += '\r'; break;
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'u': {
+                    uint32_t code;
+                    if (!parseHex4(text, i, code))
+                        return false;
+                    // Суррогатная пара — символ вне BMP
+                    if (code >= 0xD800 && code <= 0xDBFF && text.compare(i, 2, "\\u") == 0) {
+                        size_t next = i + 2;
+                        uint32_t low;
+                        if (parseHex4(text, next, low) && low >= 0xDC00 && low <= 0xDFFF) {
+                            code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                            i = next;
+                        }
+                    }
+                    appendUtf8(out, code);
+                    break;
+                }
+                default: out += e; break; // \" \\ \/
+            }
+        }
+        return false;
+    }
+
+    static bool parseHex4(const std::string& text, size_t& i, uint32_t& code) {
+        if (i + 4 > text.size())
+            return false;
+        code = 0;
+        for (size_t k = 0; k < 4; ++k) {
+            char c = text[i + k];
+            code <<= 4;
+            if (c >= '0' && c <= '9') code |= c - '0';
+            else if (c >= 'a' && c <= 'f') code |= c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F') code |= c - 'A' + 10;
+            else return false;
+        }
+        i += 4;
+        return true;
+    }
+
+    static void appendUtf8(std::string& out, uint32_t code) {
+        if (code < 0x80) {
+            out += static_cast<char>(code);
+        } else if (code < 0x800) {
+            out += static_cast<char>(0xC0 | (code >> 6));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        } else if (code < 0x10000) {
+            out += static_cast<char>(0xE0 | (code >> 12));
+            out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        } else {
+            out += static_cast<char>(0xF0 | (code >> 18));
+            out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        }
+    }
+
+    Database& db;
+    const size_t batchSize;
+
+    sqlite3_stmt* insert = nullptr;
+    bool started = false;
+    bool deferredIndex = false;
+    int64_t synchronousBefore = 2;
+    int64_t cacheSizeBefore = -2000;
+    int64_t lastIndexed = 0;
+    size_t inBatch = 0;
+    Stats stats;
+    Clock::time_point startedAt;
+};
+
+#endif // TG_BOT_CATALOGIMPORTER_H
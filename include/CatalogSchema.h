@@ -0,0 +1,91 @@
+#ifndef TG_BOT_CATALOGSCHEMA_H
+#define TG_BOT_CATALOGSCHEMA_H
+
+#pragma once
+
+#include <sqlite3.h>
+#include <iostream>
+#include <string>
+
+/**
+ * Таблицы библиотеки. Общие для бота и утилиты импорта каталога,
+ * создаются идемпотентно при каждом запуске.
+ */
+
+class CatalogSchema {
+public:
+    static bool create(sqlite3* db) {
+        // Создание всех нужных таблиц, включая для рейтинга
+        const char* scripts[] = {
+                "CREATE TABLE IF NOT EXISTS users(tg_id INTEGER PRIMARY KEY, username TEXT);",
+                "CREATE TABLE IF NOT EXISTS books(id INTEGER PRIMARY KEY AUTOINCREMENT,"
+                " title TEXT NOT NULL, author TEXT NOT NULL,"
+                " topic TEXT NOT NULL,"
+                " file_path TEXT UNIQUE,"
+                " request_count INTEGER DEFAULT 0);",
+                // Счётчики популярности обновляют книги по названию — без индекса это полный проход
+                "CREATE INDEX IF NOT EXISTS books_title ON books(title);",
+                "CREATE TABLE IF NOT EXISTS author_requests(author TEXT PRIMARY KEY,"
+                " request_count INTEGER DEFAULT 0);",
+                "CREATE TABLE IF NOT EXISTS topic_requests(topic TEXT PRIMARY KEY,"
+                " request_count INTEGER DEFAULT 0);",
+                // file_id документа, уже загруженного в Telegram, — повторная отправка без скачивания
+                "CREATE TABLE IF NOT EXISTS book_files(book_id INTEGER PRIMARY KEY"
+                " REFERENCES books(id) ON DELETE CASCADE,"
+                " tg_file_id TEXT NOT NULL);",
+                // Состояние папок Яндекс Диска на момент последней синхронизации (DiskSync)
+                "CREATE TABLE IF NOT EXISTS disk_dirs(path TEXT PRIMARY KEY,"
+                " modified TEXT, total INTEGER);",
+                // Индекс локального кэша скачанных книг (DownloadCache)
+                "CREATE TABLE IF NOT EXISTS download_cache(key TEXT PRIMARY KEY,"
+                " file TEXT NOT NULL, source TEXT NOT NULL,"
+                " size INTEGER NOT NULL, last_access INTEGER NOT NULL);",
+                // Опубликованные ссылки на книги больше лимита Bot API (PublicLinks)
+                "CREATE TABLE IF NOT EXISTS book_links(book_id INTEGER PRIMARY KEY"
+                " REFERENCES books(id) ON DELETE CASCADE,"
+                " link TEXT NOT NULL, published_at INTEGER NOT NULL);",
+                // Снимок незавершённых диалогов и позиций страниц (SessionStore)
+                "CREATE TABLE IF NOT EXISTS sessions(scope TEXT NOT NULL, user_id INTEGER NOT NULL,"
+                " data TEXT NOT NULL, expires_at INTEGER NOT NULL,"
+                " PRIMARY KEY(scope, user_id));"
+        };
+
+        bool ok = true;
+        for (const char* script : scripts) {
+            if (sqlite3_exec(db, script, nullptr, nullptr, nullptr) != SQLITE_OK) {
+                std::cerr << "SQL error: " << sqlite3_errmsg(db) << std::endl;
+                ok = false;
+            }
+        }
+        // Колонки, добавленные после первой версии схемы
+        ok = addColumn(db, "books", "md5", "TEXT") && ok;
+        ok = addColumn(db, "books", "modified", "TEXT") && ok;
+        ok = addColumn(db, "books", "size", "INTEGER") && ok;
+        ok = addColumn(db, "books", "mime_type", "TEXT") && ok;
+        ok = addColumn(db, "books", "meta_checked", "INTEGER") && ok; // unix-время последней сверки с диском
+        return ok;
+    }
+
+private:
+    static bool addColumn(sqlite3* db, const std::string& table, const std::string& column, const std::string& type) {
+        bool exists = false;
+        sqlite3_stmt* stmt;
+        std::string info = "PRAGMA table_info(" + table + ");";
+        if (sqlite3_prepare_v2(db, info.c_str(), -1, &stmt, nullptr) == SQLITE_OK) {
+            while (!exists && sqlite3_step(stmt) == SQLITE_ROW)
+                exists = column == reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+        }
+        sqlite3_finalize(stmt);
+        if (exists)
+            return true;
+
+        std::string sql = "ALTER TABLE " + table + " ADD COLUMN " + column + " " + type + ";";
+        if (sqlite3_exec(db, sql.c_str(), nullptr, nullptr, nullptr) != SQLITE_OK) {
+            std::cerr << "SQL error: " << sqlite3_errmsg(db) << std::endl;
+            return false;
+        }
+        return true;
+    }
+};
+
+#endif // TG_BOT_CATALOGSCHEMA_H
@@ -0,0 +1,333 @@
+#ifndef TG_BOT_DATABASE_H
+#define TG_BOT_DATABASE_H
+
+#pragma once
+
+#include <sqlite3.h>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "StatementCache.h"
+
+/**
+ * База библиотеки в режиме WAL: одно соединение на запись и пул
+ * соединений на чтение, у каждого свой кэш подготовленных выражений.
+ *
+ * Читатели берут соединение через read() на время запроса; в WAL они не
+ * ждут писателя и видят последнюю зафиксированную версию, поэтому выдача
+ * каталога не стоит за обновлением счётчиков. Если свободных соединений нет,
+ * открывается ещё одно — вложенные чтения одного потока не блокируются.
+ *
+ * Все изменения идут через очередь в единственный поток записи: write()
+ * не ждёт (пока очередь не переполнена) и сливает соседние задания в одну
+ * транзакцию, writeSync() ждёт результата, и задание может само открыть
+ * транзакцию. handle() и statements() — соединение писателя: им пользуются
+ * задания записи и однопоточный код до запуска бота (схема, импорт каталога).
+ */
+
+class Database {
+public:
+    // Чтение через соединение из пула; возвращается в пул в деструкторе
+    class Reader {
+    public:
+        Reader(Reader&& other) noexcept
+                : owner(other.owner), connection(other.connection), db(other.db), cache(other.cache) {
+            other.connection = nullptr;
+        }
+
+        Reader(const Reader&) = delete;
+        Reader& operator=(const Reader&) = delete;
+        Reader& operator=(Reader&&) = delete;
+
+        ~Reader() {
+            if (connection)
+                owner->release(connection);
+        }
+
+        sqlite3* handle() const { return db; }
+        StatementCache& statements() { return *cache; }
+        const char* errmsg() const { return sqlite3_errmsg(db); }
+
+    private:
+        friend class Database;
+
+        struct Connection {
+            sqlite3* db = nullptr;
+            std::unique_ptr<StatementCache> cache;
+        };
+
+        Reader(Database* owner_, Connection* connection_, sqlite3* db_, StatementCache* cache_)
+                : owner(owner_), connection(connection_), db(db_), cache(cache_) {}
+
+        Database* owner;
+        Connection* connection;     // nullptr — чтение через соединение писателя
+        sqlite3* db;
+        StatementCache* cache;
+    };
+
+    Database() = default;
+
+    ~Database() {
+        close();
+    }
+
+    Database(const Database&) = delete;
+    Database& operator=(const Database&) = delete;
+
+    bool open(const std::string& path_, size_t readers = 4) {
+        int rc = sqlite3_open_v2(path_.c_str(), &db,
+                                 SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_FULLMUTEX, nullptr);
+        if (rc != SQLITE_OK)
+            return false;
+        path = path_;
+        // NORMAL в WAL теряет при сбое питания только последние транзакции, но не портит базу
+        static const char* pragmas =
+                "PRAGMA journal_mode = WAL;"
+                "PRAGMA synchronous = NORMAL;"
+                "PRAGMA temp_store = MEMORY;"
+                "PRAGMA busy_timeout = 5000;";
+        if (sqlite3_exec(db, pragmas, nullptr, nullptr, nullptr) != SQLITE_OK ||
+            sqlite3_exec(db, cachePragmas, nullptr, nullptr, nullptr) != SQLITE_OK)
+            std::cerr << "Failed to configure database: " << sqlite3_errmsg(db) << std::endl;
+        cache = std::make_unique<StatementCache>(db);
+
+        {
+            std::lock_guard<std::mutex> lock(readersMutex);
+            for (size_t i = 0; i < readers; ++i) {
+                if (auto* connection = openReader())
+                    idleReaders.push_back(connection);
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(writeMutex);
+            stopping = false;
+        }
+        writer = std::thread(&Database::runWriter, this);
+        return true;
+    }
+
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(writeMutex);
+            stopping = true;
+        }
+        writeReady.notify_one();
+        writeSpace.notify_all();
+        if (writer.joinable())
+            writer.join();
+
+        {
+            std::lock_guard<std::mutex> lock(readersMutex);
+            idleReaders.clear();
+            for (auto& connection : readers) {
+                connection->cache.reset();
+                sqlite3_close(connection->db);
+            }
+            readers.clear();
+        }
+
+        cache.reset();
+        if (db) {
+            sqlite3_close(db);
+            db = nullptr;
+        }
+    }
+
+    sqlite3* handle() const { return db; }
+    StatementCache& statements() { return *cache; }
+
+    const char* errmsg() const { return sqlite3_errmsg(db); }
+
+    Reader read() {
+        std::lock_guard<std::mutex> lock(readersMutex);
+        Reader::Connection* connection = nullptr;
+        if (!idleReaders.empty()) {
+            connection = idleReaders.back();
+            idleReaders.pop_back();
+        } else {
+            connection = openReader();
+        }
+        // Не открылось — читаем через соединение писателя (FULLMUTEX), как до пула
+        if (!connection)
+            return Reader(this, nullptr, db, cache.get());
+        return Reader(this, connection, connection->db, connection->cache.get());
+    }
+
+    // Изменение без ожидания; выполняется в потоке записи в общей транзакции с соседними
+    void write(std::function<bool()> job) {
+        enqueue(std::move(job), nullptr);
+    }
+
+    // Изменение с ожиданием результата; job может сам управлять транзакцией
+    bool writeSync(std::function<bool()> job) {
+        std::promise<bool> done;
+        auto result = done.get_future();
+        enqueue(std::move(job), &done);
+        return result.get();
+    }
+
+    // Попадания и промахи кэшей выражений всех соединений
+    std::pair<uint64_t, uint64_t> statementStats() {
+        std::lock_guard<std::mutex> lock(readersMutex);
+        uint64_t hits = cache ? cache->hits() : 0;
+        uint64_t misses = cache ? cache->misses() : 0;
+        for (const auto& connection : readers) {
+            hits += connection->cache->hits();
+            misses += connection->cache->misses();
+        }
+        return {hits, misses};
+    }
+
+    // Сколько транзакций записал поток записи и сколько заданий в них вошло
+    uint64_t writeBatches() const {
+        std::lock_guard<std::mutex> lock(writeMutex);
+        return batchCount;
+    }
+
+    uint64_t writeJobs() const {
+        std::lock_guard<std::mutex> lock(writeMutex);
+        return jobCount;
+    }
+
+private:
+    struct WriteJob {
+        std::function<bool()> run;
+        std::promise<bool>* done;
+    };
+
+    // Дальше write() ждёт — писатель не успевает, и очередь не должна расти без предела
+    static constexpr size_t maxQueuedWrites = 16384;
+
+    static constexpr const char* cachePragmas =
+            "PRAGMA mmap_size = 268435456;"     // 256 МБ файла читаются через отображение
+            "PRAGMA cache_size = -16384;";      // 16 МБ страничного кэша на соединение
+
+    Reader::Connection* openReader() {
+        sqlite3* reader = nullptr;
+        if (path.empty() || path == ":memory:")
+            return nullptr;
+        if (sqlite3_open_v2(path.c_str(), &reader, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, nullptr) != SQLITE_OK) {
+            std::cerr << "Failed to open read connection: " << (reader ? sqlite3_errmsg(reader) : "") << std::endl;
+            sqlite3_close(reader);
+            return nullptr;
+        }
+        sqlite3_exec(reader, cachePragmas, nullptr, nullptr, nullptr);
+        sqlite3_exec(reader, "PRAGMA query_only = ON; PRAGMA busy_timeout = 5000;", nullptr, nullptr, nullptr);
+
+        auto connection = std::make_unique<Reader::Connection>();
+        connection->db = reader;
+        connection->cache = std::make_unique<StatementCache>(reader);
+        readers.push_back(std::move(connection));
+        return readers.back().get();
+    }
+
+    void release(Reader::Connection* connection) {
+        std::lock_guard<std::mutex> lock(readersMutex);
+        idleReaders.push_back(connection);
+    }
+
+    // Без запущенного потока записи и из него самого задание выполняется на месте
+    void enqueue(std::function<bool()> job, std::promise<bool>* done) {
+        {
+            std::unique_lock<std::mutex> lock(writeMutex);
+            if (writer.joinable() && std::this_thread::get_id() != writer.get_id()) {
+                writeSpace.wait(lock, [this] { return stopping || writes.size() < maxQueuedWrites; });
+                if (!stopping) {
+                    writes.push_back({std::move(job), done});
+                    lock.unlock();
+                    writeReady.notify_one();
+                    return;
+                }
+            }
+        }
+        bool ok = job();
+        if (done)
+            done->set_value(ok);
+    }
+
+    void runWriter() {
+        std::unique_lock<std::mutex> lock(writeMutex);
+        while (true) {
+            writeReady.wait(lock, [this] { return stopping || !writes.empty(); });
+            if (writes.empty())
+                break;
+            std::deque<WriteJob> batch;
+            batch.swap(writes);
+            writeSpace.notify_all();
+            lock.unlock();
+            runBatch(batch);
+            lock.lock();
+        }
+    }
+
+    // Подряд идущие задания write() — одна транзакция; writeSync() выполняется отдельно
+    void runBatch(std::deque<WriteJob>& batch) {
+        while (!batch.empty()) {
+            if (batch.front().done) {
+                WriteJob job = std::move(batch.front());
+                batch.pop_front();
+                bool ok = false;
+                try {
+                    ok = job.run();
+                } catch (const std::exception& e) {
+                    std::cerr << "Database write failed: " << e.what() << std::endl;
+                }
+                job.done->set_value(ok);
+                count(1);
+                continue;
+            }
+
+            bool inTransaction = sqlite3_exec(db, "BEGIN IMMEDIATE;", nullptr, nullptr, nullptr) == SQLITE_OK;
+            size_t jobs = 0;
+            while (!batch.empty() && !batch.front().done) {
+                try {
+                    batch.front().run();
+                } catch (const std::exception& e) {
+                    std::cerr << "Database write failed: " << e.what() << std::endl;
+                }
+                batch.pop_front();
+                ++jobs;
+            }
+            if (inTransaction && sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr) != SQLITE_OK) {
+                std::cerr << "Failed to commit writes: " << sqlite3_errmsg(db) << std::endl;
+                sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+            }
+            count(jobs);
+        }
+    }
+
+    void count(size_t jobs) {
+        std::lock_guard<std::mutex> lock(writeMutex);
+        ++batchCount;
+        jobCount += jobs;
+    }
+
+    sqlite3* db = nullptr;
+    std::string path;
+    std::unique_ptr<StatementCache> cache;
+
+    std::mutex readersMutex;
+    std::vector<std::unique_ptr<Reader::Connection>> readers;
+    std::vector<Reader::Connection*> idleReaders;
+
+    mutable std::mutex writeMutex;
+    std::condition_variable writeReady;
+    std::condition_variable writeSpace;
+    std::deque<WriteJob> writes;
+    uint64_t batchCount = 0;
+    uint64_t jobCount = 0;
+    bool stopping = false;
+    std::thread writer;
+};
+
+#endif // TG_BOT_DATABASE_H
@@ -0,0 +1,298 @@
+#ifndef TG_BOT_DISKAPI_H
+#define TG_BOT_DISKAPI_H
+
+#pragma once
+
+#include <curl/curl.h>
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "HttpTransport.h"
+#include "Metrics.h"
+
+/**
+ * Работа с Яндекс Диском напрямую через REST API: обход каталога,
+ * типизированные метаданные файлов (размер, md5, MIME), скачивание и
+ * публикация с постоянной ссылкой. Базовый адрес берётся
+ * из YADISK_API_URL (по умолчанию облачный API) — так синхронизацию можно
+ * запускать против локальной подделки (tools/fake_disk_api.py).
+ * Запросы, включая скачивание самих файлов, идут через общий HttpTransport:
+ * соединения с API и с сервером загрузки переиспользуются, а ожидание
+ * ответа не занимает отдельный поток.
+ */
+
+class DiskApi {
+public:
+    struct Resource {
+        std::string path;       // без префикса "disk:"
+        std::string name;
+        std::string type;       // "dir" или "file"
+        std::string modified;
+        std::string md5;
+        std::string mimeType;
+        int64_t size = 0;
+    };
+
+    struct Listing {
+        bool ok = false;
+        Resource dir;
+        int64_t total = 0;      // всего элементов в папке, не только на этой странице
+        std::vector<Resource> items;
+    };
+
+    DiskApi(HttpTransport& transport_, const std::string& token_, std::string baseUrl_ = "")
+            : transport(transport_), token(token_), baseUrl(std::move(baseUrl_)) {
+        if (baseUrl.empty()) {
+            const char* env = std::getenv("YADISK_API_URL");
+            baseUrl = env ? env : "https://cloud-api.yandex.net/v1/disk";
+        }
+        while (!baseUrl.empty() && baseUrl.back() == '/')
+            baseUrl.pop_back();
+    }
+
+    // Одна страница содержимого папки вместе с метаданными самой папки
+    Listing list(const std::string& path, int64_t offset, int64_t limit) {
+        static const char* fields =
+                "path,modified,_embedded.total,_embedded.items.name,_embedded.items.path,_embedded.items.type,"
+                "_embedded.items.modified,_embedded.items.md5,_embedded.items.size,_embedded.items.mime_type";
+
+        Listing listing;
+        std::string body;
+        std::string url = baseUrl + "/resources?path=" + escape(path) + "&limit=" + std::to_string(limit) +
+                          "&offset=" + std::to_string(offset) + "&sort=name&fields=" + escape(fields);
+        static LatencyHistogram& timing = Metrics::instance().histogram(Metrics::Family::Disk, "resources.list");
+        if (!request("GET", url, body, timing))
+            return listing;
+
+        try {
+            boost::property_tree::ptree json;
+            std::istringstream in(body);
+            boost::property_tree::read_json(in, json);
+
+            listing.dir = parseResource(json);
+            listing.dir.type = "dir";
+            listing.total = json.get<int64_t>("_embedded.total", 0);
+            if (auto items = json.get_child_optional("_embedded.items")) {
+                for (const auto& item : *items)
+                    listing.items.push_back(parseResource(item.second));
+            }
+            listing.ok = true;
+        } catch (const std::exception& e) {
+            std::cerr << "Bad Disk API response for " << path << ": " << e.what() << std::endl;
+        }
+        return listing;
+    }
+
+    // Метаданные одного файла; nullopt — ресурс не найден или API недоступен
+    std::optional<Resource> info(const std::string& path) {
+        std::string body;
+        std::string url = baseUrl + "/resources?path=" + escape(path) +
+                          "&fields=" + escape("path,name,type,modified,md5,size,mime_type");
+        static LatencyHistogram& timing = Metrics::instance().histogram(Metrics::Family::Disk, "resources.info");
+        if (!request("GET", url, body, timing))
+            return std::nullopt;
+        try {
+            boost::property_tree::ptree json;
+            std::istringstream in(body);
+            boost::property_tree::read_json(in, json);
+            return parseResource(json);
+        } catch (const std::exception& e) {
+            std::cerr << "Bad Disk API response for " << path << ": " << e.what() << std::endl;
+            return std::nullopt;
+        }
+    }
+
+    // Публикует файл и возвращает его постоянную публичную ссылку (public_url).
+    // В отличие от href из /public/resources/download она не истекает,
+    // пока файл не снят с публикации; пустая строка — публикация не удалась
+    std::string publish(const std::string& path) {
+        std::string body;
+        static LatencyHistogram& publishTiming = Metrics::instance().histogram(Metrics::Family::Disk, "resources.publish");
+        if (!request("PUT", baseUrl + "/resources/publish?path=" + escape(path), body, publishTiming))
+            return "";
+
+        static LatencyHistogram& linkTiming = Metrics::instance().histogram(Metrics::Family::Disk, "resources.public_url");
+        if (!request("GET", baseUrl + "/resources?path=" + escape(path) + "&fields=public_url", body, linkTiming))
+            return "";
+        try {
+            boost::property_tree::ptree json;
+            std::istringstream in(body);
+            boost::property_tree::read_json(in, json);
+            return json.get<std::string>("public_url", "");
+        } catch (const std::exception& e) {
+            std::cerr << "Bad Disk API response for " << path << ": " << e.what() << std::endl;
+            return "";
+        }
+    }
+
+    // Скачивает файл в папку dir под его собственным именем. Адрес выдаёт
+    // /resources/download, сам файл качается без таймаута на весь ответ —
+    // обрыв ловит ограничение на скорость
+    bool download(const std::string& path, const std::string& dir) {
+        std::string body;
+        static LatencyHistogram& timing = Metrics::instance().histogram(Metrics::Family::Disk, "resources.download");
+        if (!request("GET", baseUrl + "/resources/download?path=" + escape(path), body, timing))
+            return false;
+        std::string href;
+        try {
+            boost::property_tree::ptree json;
+            std::istringstream in(body);
+            boost::property_tree::read_json(in, json);
+            href = json.get<std::string>("href", "");
+        } catch (const std::exception& e) {
+            std::cerr << "Bad Disk API response for " << path << ": " << e.what() << std::endl;
+        }
+        if (href.empty())
+            return false;
+
+        std::filesystem::path target = std::filesystem::path(dir) / std::filesystem::path(path).filename();
+        CURL* curl = threadHandle();
+        bool ok = false;
+        for (int attempt = 0; attempt < 3 && !ok; ++attempt) {
+            if (attempt > 0)
+                std::this_thread::sleep_for(std::chrono::milliseconds(500 << attempt));
+            std::FILE* file = std::fopen(target.string().c_str(), "wb");
+            if (!file) {
+                std::cerr << "Can't create " << target << std::endl;
+                break;
+            }
+            curl_easy_setopt(curl, CURLOPT_URL, href.c_str());
+            curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+            curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, &DiskApi::writeFile);
+            curl_easy_setopt(curl, CURLOPT_WRITEDATA, file);
+            curl_easy_setopt(curl, CURLOPT_TIMEOUT, 0L);
+            curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, 1024L);
+            curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME, 60L);
+
+            CURLcode rc = transport.perform(curl);
+            long status = 0;
+            curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+            bool written = std::fclose(file) == 0;
+            if (rc == CURLE_OK && status == 200 && written) {
+                ok = true;
+            } else if (rc == CURLE_OK && status != 429 && status < 500) {
+                std::cerr << "Disk download of " << path << " failed: " << (written ? "HTTP " + std::to_string(status) : "write error")
+                          << std::endl;
+                break;
+            } else {
+                std::cerr << "Disk download of " << path << " failed ("
+                          << (rc == CURLE_OK ? std::to_string(status) : curl_easy_strerror(rc)) << "), retrying" << std::endl;
+            }
+        }
+        curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 0L);
+        curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, 0L);
+        curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME, 0L);
+        if (!ok) {
+            std::error_code ec;
+            std::filesystem::remove(target, ec);
+        }
+        return ok;
+    }
+
+    // Сколько HTTP-запросов к API сделано за всё время
+    uint64_t calls() const {
+        return callCount.load();
+    }
+
+private:
+    static Resource parseResource(const boost::property_tree::ptree& json) {
+        Resource resource;
+        resource.path = json.get<std::string>("path", "");
+        if (resource.path.rfind("disk:", 0) == 0)
+            resource.path.erase(0, 5);
+        resource.name = json.get<std::string>("name", "");
+        resource.type = json.get<std::string>("type", "");
+        resource.modified = json.get<std::string>("modified", "");
+        resource.md5 = json.get<std::string>("md5", "");
+        resource.mimeType = json.get<std::string>("mime_type", "");
+        resource.size = json.get<int64_t>("size", 0);
+        return resource;
+    }
+
+    struct Handle {
+        CURL* curl = curl_easy_init();
+        ~Handle() { curl_easy_cleanup(curl); }
+    };
+
+    static CURL* threadHandle() {
+        thread_local Handle handle;
+        return handle.curl;
+    }
+
+    static size_t write(char* data, size_t size, size_t count, void* out) {
+        static_cast<std::string*>(out)->append(data, size * count);
+        return size * count;
+    }
+
+    static size_t writeFile(char* data, size_t size, size_t count, void* out) {
+        return std::fwrite(data, size, count, static_cast<std::FILE*>(out)) * size;
+    }
+
+    std::string escape(const std::string& value) {
+        char* escaped = curl_easy_escape(threadHandle(), value.c_str(), static_cast<int>(value.size()));
+        std::string result = escaped ? escaped : "";
+        curl_free(escaped);
+        return result;
+    }
+
+    // 429 и 5xx повторяются с нарастающей паузой
+    bool request(const char* method, const std::string& url, std::string& body, LatencyHistogram& timing) {
+        Metrics::Timer timer(timing);
+        CURL* curl = threadHandle();
+        std::string auth = "Authorization: OAuth " + token;
+        curl_slist* headers = curl_slist_append(nullptr, auth.c_str());
+        headers = curl_slist_append(headers, "Accept: application/json");
+
+        bool ok = false;
+        for (int attempt = 0; attempt < 3 && !ok; ++attempt) {
+            if (attempt > 0)
+                std::this_thread::sleep_for(std::chrono::milliseconds(500 << attempt));
+            body.clear();
+            curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+            curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, method);
+            curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+            curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, &DiskApi::write);
+            curl_easy_setopt(curl, CURLOPT_WRITEDATA, &body);
+            curl_easy_setopt(curl, CURLOPT_TIMEOUT, 30L);
+
+            ++callCount;
+            CURLcode rc = transport.perform(curl);
+            long status = 0;
+            curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+            if (rc == CURLE_OK && status == 200) {
+                ok = true;
+            } else if (rc == CURLE_OK && status != 429 && status < 500) {
+                std::cerr << "Disk API error " << status << ": " << body << std::endl;
+                break;
+            } else {
+                std::cerr << "Disk API request failed (" << (rc == CURLE_OK ? std::to_string(status) : curl_easy_strerror(rc))
+                          << "), retrying" << std::endl;
+            }
+        }
+        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, nullptr);
+        curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, nullptr);
+        curl_slist_free_all(headers);
+        if (!ok)
+            timer.fail();
+        return ok;
+    }
+
+    HttpTransport& transport;
+    const std::string token;
+    std::string baseUrl;
+    std::atomic<uint64_t> callCount{0};
+};
+
+#endif // TG_BOT_DISKAPI_H
@@ -0,0 +1,587 @@
+#ifndef TG_BOT_DISKSYNC_H
+#define TG_BOT_DISKSYNC_H
+
+#pragma once
+
+#include <sqlite3.h>
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "Database.h"
+#include "DiskApi.h"
+
+/**
+ * Синхронизация таблицы books с папкой на Яндекс Диске.
+ * Дерево обходится parallelism потоками, каждая папка читается страницами
+ * по pageLimit элементов. Для каждой папки запоминаются modified и число
+ * элементов: если при следующем обходе они совпали, остальные страницы
+ * не запрашиваются, а вложенные папки берутся из прошлого состояния.
+ * Книги пишутся в базу, только если у файла изменились modified или md5.
+ * Правка файла без изменения папки ловится полным обходом (run(true)).
+ * Если у известной книги сменился md5, её file_id и публичная ссылка
+ * удаляются, а onContentChanged даёт сбросить локальную копию файла.
+ *
+ * Метаданные книги выводятся из пути относительно корня:
+ * <тема>/<автор>/<название>.pdf или <тема>/<автор> - <название>.pdf.
+ */
+
+class DiskSync {
+public:
+    struct Report {
+        bool full = false;
+        bool complete = true;       // все папки прочитаны без ошибок
+        size_t dirs = 0;
+        size_t dirsUnchanged = 0;
+        size_t files = 0;
+        size_t inserted = 0;
+        size_t updated = 0;
+        size_t removed = 0;
+        uint64_t apiCalls = 0;
+        uint64_t fullCrawlCalls = 0; // столько запросов сделал бы обход без сохранённого состояния
+        double seconds = 0;
+    };
+
+    using BookAdded = std::function<void(const std::string& title, const std::string& author, const std::string& topic)>;
+    using ContentChanged = std::function<void(int bookId, const std::string& path)>;
+    using Done = std::function<void(const Report&)>;
+
+    DiskSync(Database& db_, DiskApi& api_, const std::string& root_, size_t parallelism_ = 4, int64_t pageLimit_ = 100)
+            : db(db_), api(api_), root(normalize(root_)),
+              parallelism(std::max<size_t>(1, parallelism_)), pageLimit(pageLimit_) {}
+
+    ~DiskSync() {
+        stop();
+    }
+
+    DiskSync(const DiskSync&) = delete;
+    DiskSync& operator=(const DiskSync&) = delete;
+
+    // Вызывается после записи каждой новой книги; задаётся до start()
+    void onBookAdded(BookAdded callback) {
+        bookAdded = std::move(callback);
+    }
+
+    // Вызывается после записи для каждой книги со сменившимся md5; задаётся до start()
+    void onContentChanged(ContentChanged callback) {
+        contentChanged = std::move(callback);
+    }
+
+    // Фоновый поток: первый обход сразу, дальше раз в interval (0 — только по trigger)
+    void start(std::chrono::minutes interval_) {
+        interval = interval_;
+        pending = true;
+        worker = std::thread(&DiskSync::loop, this);
+    }
+
+    // false — обход уже идёт или запрошен
+    bool trigger(bool full, Done done) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (pending || running)
+                return false;
+            pending = true;
+            pendingFull = full;
+            pendingDone = std::move(done);
+        }
+        wake.notify_one();
+        return true;
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        if (worker.joinable())
+            worker.join();
+    }
+
+    Report run(bool full) {
+        std::lock_guard<std::mutex> runLock(runMutex);
+        auto started = std::chrono::steady_clock::now();
+        uint64_t callsBefore = api.calls();
+
+        Crawl crawl;
+        crawl.full = full;
+        crawl.report.full = full;
+        loadState(crawl);
+        crawl.queue.push_back(root);
+        crawl.queued.insert(root);
+
+        std::vector<std::thread> workers;
+        for (size_t i = 0; i < parallelism; ++i)
+            workers.emplace_back([this, &crawl] { crawlLoop(crawl); });
+        for (auto& thread : workers)
+            thread.join();
+
+        // Запись идёт в потоке записи базы; индексы бота обновляются уже после неё
+        db.writeSync([this, &crawl] {
+            write(crawl);
+            return crawl.report.complete;
+        });
+        if (bookAdded) {
+            for (const auto& change : crawl.added) {
+                auto meta = describe(change.file.path);
+                bookAdded(meta.title, meta.author, meta.topic);
+            }
+        }
+        if (contentChanged) {
+            for (const auto& [bookId, path] : crawl.replaced)
+                contentChanged(bookId, path);
+        }
+
+        crawl.report.apiCalls = api.calls() - callsBefore;
+        crawl.report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        return crawl.report;
+    }
+
+private:
+    struct DirState {
+        std::string modified;
+        int64_t total = 0;
+    };
+
+    struct FileState {
+        std::string md5;
+        std::string modified;
+    };
+
+    struct Change {
+        DiskApi::Resource file;
+        bool inserted;
+        bool contentChanged;        // был md5 и он другой — кэш file_id устарел
+    };
+
+    // Папка, прочитанная целиком: по ней можно удалять пропавшие книги и подпапки
+    struct Listed {
+        std::string path;
+        DirState state;
+        std::unordered_set<std::string> files;
+        std::unordered_set<std::string> dirs;
+    };
+
+    struct Crawl {
+        bool full = false;
+        Report report;
+
+        // Прошлое состояние, только чтение во время обхода
+        std::unordered_map<std::string, DirState> dirs;
+        std::unordered_map<std::string, FileState> files;
+        std::unordered_map<std::string, std::vector<std::string>> childDirs;
+        std::unordered_map<std::string, std::vector<std::string>> childFiles;
+
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::vector<std::string> queue;
+        std::unordered_set<std::string> queued;
+        size_t active = 0;
+
+        std::vector<Change> changes;
+        std::vector<Change> added;      // вставленные книги, для onBookAdded после записи
+        std::vector<std::pair<int, std::string>> replaced; // сменился md5, для onContentChanged
+        std::vector<Listed> listed;
+        std::vector<std::pair<std::string, DirState>> unchanged;
+    };
+
+    void loop() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!stopping) {
+            auto ready = [this] { return stopping || pending; };
+            if (interval.count() > 0) {
+                if (!wake.wait_for(lock, interval, ready))
+                    pending = true; // плановый обход
+            } else {
+                wake.wait(lock, ready);
+            }
+            if (stopping)
+                break;
+
+            bool full = pendingFull;
+            Done done = std::move(pendingDone);
+            pending = false;
+            pendingFull = false;
+            pendingDone = nullptr;
+            running = true;
+            lock.unlock();
+
+            Report report = run(full);
+            std::cout << "Disk sync: " << report.dirs << " dirs (" << report.dirsUnchanged << " unchanged), "
+                      << report.files << " books, +" << report.inserted << " ~" << report.updated << " -" << report.removed
+                      << ", " << report.apiCalls << " API calls (full crawl " << report.fullCrawlCalls << ")" << std::endl;
+            if (done)
+                done(report);
+
+            lock.lock();
+            running = false;
+        }
+    }
+
+    void crawlLoop(Crawl& crawl) {
+        std::unique_lock<std::mutex> lock(crawl.mutex);
+        while (true) {
+            crawl.wake.wait(lock, [&crawl] { return !crawl.queue.empty() || crawl.active == 0; });
+            if (crawl.queue.empty())
+                break; // очередь пуста и никто не может её пополнить
+
+            std::string path = std::move(crawl.queue.back());
+            crawl.queue.pop_back();
+            ++crawl.active;
+            lock.unlock();
+
+            scan(crawl, path);
+
+            lock.lock();
+            --crawl.active;
+            crawl.wake.notify_all();
+        }
+    }
+
+    void scan(Crawl& crawl, const std::string& path) {
+        auto page = api.list(path, 0, pageLimit);
+        if (!page.ok) {
+            std::lock_guard<std::mutex> lock(crawl.mutex);
+            ++crawl.report.dirs;
+            ++crawl.report.fullCrawlCalls;
+            crawl.report.complete = false;
+            // Состояние не трогаем: папка и её содержимое будут перечитаны в следующий раз
+            auto known = crawl.childDirs.find(path);
+            if (known != crawl.childDirs.end())
+                enqueue(crawl, known->second);
+            return;
+        }
+
+        DirState state{page.dir.modified, page.total};
+        auto known = crawl.dirs.find(path);
+        bool unchanged = !crawl.full && known != crawl.dirs.end() &&
+                         known->second.modified == state.modified && known->second.total == state.total;
+
+        Listed listed{path, state, {}, {}};
+        std::vector<std::string> subdirs;
+        std::vector<Change> changes;
+        size_t files = 0;
+        bool complete = true;
+
+        int64_t offset = 0;
+        while (true) {
+            for (const auto& item : page.items) {
+                if (item.type == "dir") {
+                    subdirs.push_back(item.path);
+                    listed.dirs.insert(item.path);
+                } else if (isBook(item.name)) {
+                    ++files;
+                    listed.files.insert(item.path);
+                    compare(crawl, item, changes);
+                }
+            }
+            offset += pageLimit;
+            if (unchanged || offset >= page.total || page.items.empty())
+                break;
+            page = api.list(path, offset, pageLimit);
+            if (!page.ok) {
+                complete = false;
+                break;
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(crawl.mutex);
+        ++crawl.report.dirs;
+        crawl.report.fullCrawlCalls += std::max<int64_t>(1, (state.total + pageLimit - 1) / pageLimit);
+        crawl.changes.insert(crawl.changes.end(), changes.begin(), changes.end());
+        enqueue(crawl, subdirs);
+
+        if (unchanged) {
+            // Остальные страницы не читали — книги и подпапки берём из прошлого обхода
+            ++crawl.report.dirsUnchanged;
+            auto knownFiles = crawl.childFiles.find(path);
+            crawl.report.files += std::max(files, knownFiles != crawl.childFiles.end() ? knownFiles->second.size() : 0);
+            auto knownDirs = crawl.childDirs.find(path);
+            if (knownDirs != crawl.childDirs.end())
+                enqueue(crawl, knownDirs->second);
+            crawl.unchanged.emplace_back(path, state);
+        } else if (complete) {
+            crawl.report.files += files;
+            crawl.listed.push_back(std::move(listed));
+        } else {
+            crawl.report.files += files;
+            crawl.report.complete = false;
+        }
+    }
+
+    // Вызывается под crawl.mutex
+    static void enqueue(Crawl& crawl, const std::vector<std::string>& paths) {
+        for (const auto& path : paths) {
+            if (crawl.queued.insert(path).second)
+                crawl.queue.push_back(path);
+        }
+        crawl.wake.notify_all();
+    }
+
+    static void compare(const Crawl& crawl, const DiskApi::Resource& file, std::vector<Change>& changes) {
+        auto known = crawl.files.find(file.path);
+        if (known == crawl.files.end()) {
+            changes.push_back({file, true, false});
+        } else if (known->second.md5 != file.md5 || known->second.modified != file.modified) {
+            changes.push_back({file, false, !known->second.md5.empty() && known->second.md5 != file.md5});
+        }
+    }
+
+    void loadState(Crawl& crawl) {
+        std::string prefix = childPrefix(root);
+        std::string upper = prefix;
+        ++upper.back(); // '/' + 1 = '0': диапазон [prefix, upper) — всё поддерево
+
+        auto reader = db.read();
+        sqlite3_stmt* stmt;
+        if (sqlite3_prepare_v2(reader.handle(), "SELECT path, modified, total FROM disk_dirs"
+                                            " WHERE path = ? OR (path >= ? AND path < ?);", -1, &stmt, nullptr) == SQLITE_OK) {
+            sqlite3_bind_text(stmt, 1, root.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_text(stmt, 2, prefix.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_text(stmt, 3, upper.c_str(), -1, SQLITE_TRANSIENT);
+            while (sqlite3_step(stmt) == SQLITE_ROW) {
+                std::string path = text(stmt, 0);
+                crawl.dirs[path] = DirState{text(stmt, 1), sqlite3_column_int64(stmt, 2)};
+                if (path != root)
+                    crawl.childDirs[parent(path)].push_back(path);
+            }
+        }
+        sqlite3_finalize(stmt);
+
+        if (sqlite3_prepare_v2(reader.handle(), "SELECT file_path, md5, modified FROM books"
+                                            " WHERE file_path >= ? AND file_path < ?;", -1, &stmt, nullptr) == SQLITE_OK) {
+            sqlite3_bind_text(stmt, 1, prefix.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_text(stmt, 2, upper.c_str(), -1, SQLITE_TRANSIENT);
+            while (sqlite3_step(stmt) == SQLITE_ROW) {
+                std::string path = text(stmt, 0);
+                crawl.files[path] = FileState{text(stmt, 1), text(stmt, 2)};
+                crawl.childFiles[parent(path)].push_back(path);
+            }
+        }
+        sqlite3_finalize(stmt);
+    }
+
+    // Все изменения одной транзакцией; выполняется в потоке записи базы
+    void write(Crawl& crawl) {
+        if (sqlite3_exec(db.handle(), "BEGIN IMMEDIATE;", nullptr, nullptr, nullptr) != SQLITE_OK) {
+            std::cerr << "Failed to begin disk sync: " << db.errmsg() << std::endl;
+            crawl.report.complete = false;
+            return;
+        }
+
+        bool ok = true;
+        for (const auto& change : crawl.changes) {
+            auto stmt = db.statements().acquire(
+                    "INSERT INTO books (title, author, topic, file_path, md5, modified, size, mime_type, meta_checked,"
+                    " request_count) VALUES (?, ?, ?, ?, ?, ?, ?, ?, strftime('%s', 'now'), 0)"
+                    " ON CONFLICT(file_path) DO UPDATE SET md5 = excluded.md5, modified = excluded.modified,"
+                    " size = excluded.size, mime_type = excluded.mime_type, meta_checked = excluded.meta_checked;");
+            if (!stmt) {
+                ok = false;
+                break;
+            }
+            auto meta = describe(change.file.path);
+            sqlite3_bind_text(stmt, 1, meta.title.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_text(stmt, 2, meta.author.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_text(stmt, 3, meta.topic.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_text(stmt, 4, change.file.path.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_text(stmt, 5, change.file.md5.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_text(stmt, 6, change.file.modified.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_int64(stmt, 7, change.file.size);
+            sqlite3_bind_text(stmt, 8, change.file.mimeType.c_str(), -1, SQLITE_TRANSIENT);
+            if (sqlite3_step(stmt) != SQLITE_DONE) {
+                ok = false;
+                break;
+            }
+            stmt = StatementCache::Statement();
+
+            if (change.inserted) {
+                ++crawl.report.inserted;
+                crawl.added.push_back(change);
+            } else {
+                ++crawl.report.updated;
+            }
+            if (change.contentChanged) {
+                int bookId = findBook(change.file.path);
+                if (bookId > 0)
+                    crawl.replaced.emplace_back(bookId, change.file.path);
+                ok = exec("DELETE FROM book_files WHERE book_id = (SELECT id FROM books WHERE file_path = ?);",
+                          change.file.path) && ok;
+                ok = exec("DELETE FROM book_links WHERE book_id = (SELECT id FROM books WHERE file_path = ?);",
+                          change.file.path) && ok;
+            }
+        }
+
+        for (const auto& dir : crawl.listed) {
+            if (!ok)
+                break;
+            auto files = crawl.childFiles.find(dir.path);
+            if (files != crawl.childFiles.end()) {
+                for (const auto& path : files->second) {
+                    if (dir.files.count(path))
+                        continue;
+                    ok = exec("DELETE FROM books WHERE file_path = ?;", path) && ok;
+                    ++crawl.report.removed;
+                }
+            }
+            auto dirs = crawl.childDirs.find(dir.path);
+            if (dirs != crawl.childDirs.end()) {
+                for (const auto& path : dirs->second) {
+                    if (!dir.dirs.count(path))
+                        ok = removeTree(crawl, path) && ok;
+                }
+            }
+            ok = saveDir(dir.path, dir.state) && ok;
+        }
+        for (const auto& [path, state] : crawl.unchanged) {
+            if (ok)
+                ok = saveDir(path, state);
+        }
+        if (ok && crawl.report.removed > 0)
+            ok = sqlite3_exec(db.handle(), "DELETE FROM book_files WHERE book_id NOT IN (SELECT id FROM books);"
+                                           "DELETE FROM book_links WHERE book_id NOT IN (SELECT id FROM books);",
+                              nullptr, nullptr, nullptr) == SQLITE_OK;
+
+        if (!ok || sqlite3_exec(db.handle(), "COMMIT;", nullptr, nullptr, nullptr) != SQLITE_OK) {
+            std::cerr << "Failed to write disk sync: " << db.errmsg() << std::endl;
+            sqlite3_exec(db.handle(), "ROLLBACK;", nullptr, nullptr, nullptr);
+            crawl.report.complete = false;
+            crawl.report.inserted = crawl.report.updated = crawl.report.removed = 0;
+            crawl.added.clear();
+            crawl.replaced.clear();
+        }
+    }
+
+    bool removeTree(Crawl& crawl, const std::string& path) {
+        std::string prefix = childPrefix(path);
+        std::string upper = prefix;
+        ++upper.back();
+        for (const auto& [file, state] : crawl.files) {
+            if (file.compare(0, prefix.size(), prefix) == 0)
+                ++crawl.report.removed;
+        }
+        return exec("DELETE FROM books WHERE file_path >= ? AND file_path < ?;", prefix, upper) &&
+               exec("DELETE FROM disk_dirs WHERE path = ? OR (path >= ? AND path < ?);", path, prefix, upper);
+    }
+
+    int findBook(const std::string& path) {
+        auto stmt = db.statements().acquire("SELECT id FROM books WHERE file_path = ?;");
+        if (!stmt)
+            return 0;
+        sqlite3_bind_text(stmt, 1, path.c_str(), -1, SQLITE_TRANSIENT);
+        return sqlite3_step(stmt) == SQLITE_ROW ? sqlite3_column_int(stmt, 0) : 0;
+    }
+
+    bool saveDir(const std::string& path, const DirState& state) {
+        auto stmt = db.statements().acquire("INSERT INTO disk_dirs (path, modified, total) VALUES (?, ?, ?)"
+                                            " ON CONFLICT(path) DO UPDATE SET modified = excluded.modified, total = excluded.total;");
+        if (!stmt)
+            return false;
+        sqlite3_bind_text(stmt, 1, path.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(stmt, 2, state.modified.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int64(stmt, 3, state.total);
+        return sqlite3_step(stmt) == SQLITE_DONE;
+    }
+
+    template<typename... Args>
+    bool exec(const char* sql, const Args&... args) {
+        auto stmt = db.statements().acquire(sql);
+        if (!stmt)
+            return false;
+        int index = 1;
+        (sqlite3_bind_text(stmt, index++, args.c_str(), -1, SQLITE_TRANSIENT), ...);
+        return sqlite3_step(stmt) == SQLITE_DONE;
+    }
+
+    struct BookMeta {
+        std::string title;
+        std::string author;
+        std::string topic;
+    };
+
+    BookMeta describe(const std::string& path) const {
+        std::string relative = path.substr(std::min(path.size(), childPrefix(root).size()));
+        std::vector<std::string> parts;
+        size_t start = 0;
+        for (size_t slash; (slash = relative.find('/', start)) != std::string::npos; start = slash + 1)
+            parts.push_back(relative.substr(start, slash - start));
+        std::string name = relative.substr(start);
+        std::string stem = name.substr(0, name.rfind('.'));
+
+        BookMeta meta{stem, "Неизвестный автор", parts.empty() ? "Без темы" : parts.front()};
+        if (parts.size() >= 2) {
+            meta.author = parts.back();
+        } else {
+            auto dash = stem.find(" - ");
+            if (dash != std::string::npos) {
+                meta.author = stem.substr(0, dash);
+                meta.title = stem.substr(dash + 3);
+            }
+        }
+        return meta;
+    }
+
+    static bool isBook(const std::string& name) {
+        static const char* extensions[] = {".pdf", ".epub", ".fb2", ".djvu", ".txt", ".mobi", ".azw3", ".doc", ".docx", ".rtf"};
+        auto dot = name.rfind('.');
+        if (dot == std::string::npos)
+            return false;
+        std::string ext = name.substr(dot);
+        std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return std::tolower(c); });
+        return std::find(std::begin(extensions), std::end(extensions), ext) != std::end(extensions);
+    }
+
+    static std::string normalize(std::string path) {
+        if (path.rfind("disk:", 0) == 0)
+            path.erase(0, 5);
+        if (path.empty() || path.front() != '/')
+            path.insert(path.begin(), '/');
+        while (path.size() > 1 && path.back() == '/')
+            path.pop_back();
+        return path;
+    }
+
+    static std::string childPrefix(const std::string& dir) {
+        return dir == "/" ? dir : dir + "/";
+    }
+
+    static std::string parent(const std::string& path) {
+        auto slash = path.rfind('/');
+        return slash == 0 || slash == std::string::npos ? "/" : path.substr(0, slash);
+    }
+
+    static std::string text(sqlite3_stmt* stmt, int column) {
+        const unsigned char* value = sqlite3_column_text(stmt, column);
+        return value ? reinterpret_cast<const char*>(value) : "";
+    }
+
+    Database& db;
+    DiskApi& api;
+    const std::string root;
+    const size_t parallelism;
+    const int64_t pageLimit;
+    BookAdded bookAdded;
+    ContentChanged contentChanged;
+
+    std::mutex runMutex;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::chrono::minutes interval{0};
+    bool pending = false;
+    bool pendingFull = false;
+    Done pendingDone;
+    bool running = false;
+    bool stopping = false;
+    std::thread worker;
+};
+
+#endif // TG_BOT_DISKSYNC_H
@@ -0,0 +1,133 @@
+#ifndef TG_BOT_DOCUMENTUPLOADER_H
+#define TG_BOT_DOCUMENTUPLOADER_H
+
+#pragma once
+
+#include <curl/curl.h>
+#include <tgbot/tgbot.h>
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include "HttpTransport.h"
+#include "Metrics.h"
+#include "MappedFile.h"
+
+/**
+ * Загрузка документа в Telegram (sendDocument) потоком из отображённого файла.
+ * InputFile::fromFile читает файл в std::string, а HTTP-клиент tgbot-cpp
+ * собирает из него ещё одну строку с multipart-телом — две копии книги в куче.
+ * Здесь тело multipart собирает libcurl, а содержимое документа читается
+ * кусками прямо из MappedFile, поэтому память на загрузку не зависит от
+ * размера файла. Ошибки Telegram бросаются как TgBot::TgException.
+ */
+
+class DocumentUploader {
+public:
+    DocumentUploader(HttpTransport& transport_, const std::string& token,
+                     const std::string& apiUrl = "https://api.telegram.org")
+            : transport(transport_), url(apiUrl + "/bot" + token + "/sendDocument") {}
+
+    // Возвращает file_id загруженного документа
+    std::string sendDocument(int64_t chatId, const std::filesystem::path& file,
+                             const std::string& fileName, const std::string& mimeType) const {
+        static LatencyHistogram& timing = Metrics::instance().histogram(Metrics::Family::Telegram, "sendDocument");
+        Metrics::Timer timer(timing);
+        MappedFile mapped(file);
+        if (!mapped)
+            throw std::runtime_error("Can't map " + file.string());
+
+        CURL* curl = threadHandle();
+        Reader reader{&mapped, 0};
+        std::string chat = std::to_string(chatId);
+        std::string body;
+
+        curl_mime* form = curl_mime_init(curl);
+        curl_mimepart* part = curl_mime_addpart(form);
+        curl_mime_name(part, "chat_id");
+        curl_mime_data(part, chat.c_str(), chat.size());
+
+        part = curl_mime_addpart(form);
+        curl_mime_name(part, "document");
+        curl_mime_filename(part, fileName.c_str());
+        curl_mime_type(part, mimeType.c_str());
+        curl_mime_data_cb(part, static_cast<curl_off_t>(mapped.size()), &DocumentUploader::read,
+                          &DocumentUploader::seek, nullptr, &reader);
+
+        curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+        curl_easy_setopt(curl, CURLOPT_MIMEPOST, form);
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, &DocumentUploader::write);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &body);
+        curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 20L);
+        curl_easy_setopt(curl, CURLOPT_TIMEOUT, 600L);
+
+        CURLcode rc = transport.perform(curl);
+        curl_easy_setopt(curl, CURLOPT_MIMEPOST, nullptr);
+        curl_mime_free(form);
+        if (rc != CURLE_OK)
+            throw std::runtime_error(std::string("sendDocument upload failed: ") + curl_easy_strerror(rc));
+
+        boost::property_tree::ptree json;
+        try {
+            std::istringstream in(body);
+            boost::property_tree::read_json(in, json);
+        } catch (const std::exception&) {
+            throw TgBot::TgException("Bad sendDocument response: " + body.substr(0, 200),
+                                     TgBot::TgException::ErrorCode::InvalidJson);
+        }
+        if (!json.get<bool>("ok", false))
+            throw TgBot::TgException(json.get<std::string>("description", "sendDocument failed"),
+                                     static_cast<TgBot::TgException::ErrorCode>(json.get<size_t>("error_code", 0)));
+        return json.get<std::string>("result.document.file_id", "");
+    }
+
+private:
+    struct Reader {
+        MappedFile* file;
+        size_t offset;
+    };
+
+    static size_t read(char* buffer, size_t size, size_t count, void* arg) {
+        auto* reader = static_cast<Reader*>(arg);
+        size_t chunk = std::min(size * count, reader->file->size() - reader->offset);
+        std::memcpy(buffer, reader->file->bytes() + reader->offset, chunk);
+        reader->offset += chunk;
+        reader->file->release(reader->offset);
+        return chunk;
+    }
+
+    // Нужна libcurl для повторной отправки тела (редиректы, переподключение)
+    static int seek(void* arg, curl_off_t offset, int origin) {
+        auto* reader = static_cast<Reader*>(arg);
+        if (origin != SEEK_SET || offset < 0 || static_cast<size_t>(offset) > reader->file->size())
+            return 1; // CURL_SEEKFUNC_FAIL
+        reader->offset = static_cast<size_t>(offset);
+        return 0;     // CURL_SEEKFUNC_OK
+    }
+
+    static size_t write(char* data, size_t size, size_t count, void* out) {
+        static_cast<std::string*>(out)->append(data, size * count);
+        return size * count;
+    }
+
+    struct Handle {
+        CURL* curl = curl_easy_init();
+        ~Handle() { curl_easy_cleanup(curl); }
+    };
+
+    static CURL* threadHandle() {
+        thread_local Handle handle;
+        return handle.curl;
+    }
+
+    HttpTransport& transport;
+    const std::string url;
+};
+
+#endif // TG_BOT_DOCUMENTUPLOADER_H
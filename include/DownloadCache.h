@@ -0,0 +1,348 @@
+#ifndef TG_BOT_DOWNLOADCACHE_H
+#define TG_BOT_DOWNLOADCACHE_H
+
+#pragma once
+
+#include <sqlite3.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include <unordered_set>
+#include "Database.h"
+
+/**
+ * Локальный кэш скачанных с Яндекс Диска книг с ограничением по объёму.
+ * Файл хранится под хэшем пути на диске (dir/ab/abcdef0123456789.pdf),
+ * поэтому одинаковые имена из разных папок не пересекаются. Скачивание
+ * идёт во временную папку и переносится на место одним rename — читатели
+ * никогда не видят недокачанный файл. При превышении budgetBytes удаляются
+ * давно не использованные файлы. Индекс (таблица download_cache) переживает
+ * перезапуск; load() сверяет его с содержимым папки. Папка может оказаться
+ * общей (BOOK_CACHE_DIR=/tmp), поэтому удаляются только файлы, имя и место
+ * которых кэш мог дать сам: ab/<16 hex>.<ext> и tmp/<16 hex>-<n>.
+ *
+ * fetch() закрепляет файл за вызывающим, пока жив возвращённый указатель:
+ * закреплённые файлы не вытесняются, а снятые с индекса (invalidate) удаляются
+ * с диска только после того, как их отпустит последний владелец.
+ */
+
+class DownloadCache {
+public:
+    // Скачивает файл в переданную папку под его исходным именем
+    using Download = std::function<bool(const std::string& dir)>;
+    // Путь к закреплённой локальной копии; пустой — скачать не удалось
+    using Pinned = std::shared_ptr<const std::filesystem::path>;
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        uint64_t bytes = 0;
+        size_t files = 0;
+        size_t pinned = 0;      // файлов сейчас в работе
+    };
+
+    DownloadCache(Database& db_, std::filesystem::path dir_, uint64_t budgetBytes_)
+            : db(db_), dir(std::move(dir_)), budgetBytes(budgetBytes_) {}
+
+    DownloadCache(const DownloadCache&) = delete;
+    DownloadCache& operator=(const DownloadCache&) = delete;
+
+    // Поднимает индекс: записи без файлов забываются, файлы кэша без записей и недокачанное удаляются
+    void load() {
+        std::error_code ec;
+        for (const auto& item : std::filesystem::directory_iterator(dir / "tmp", ec)) {
+            std::string name = item.path().filename().string();
+            if (name.size() > 17 && isKey(name.substr(0, 16)) && name[16] == '-')
+                std::filesystem::remove_all(item.path(), ec);
+        }
+        std::filesystem::create_directories(dir / "tmp", ec);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<std::string> missing;
+        auto reader = db.read();
+        sqlite3_stmt* stmt;
+        if (sqlite3_prepare_v2(reader.handle(), "SELECT key, file, source, size, last_access FROM download_cache"
+                                            " ORDER BY last_access ASC;", -1, &stmt, nullptr) == SQLITE_OK) {
+            while (sqlite3_step(stmt) == SQLITE_ROW) {
+                Entry entry;
+                std::string key = text(stmt, 0);
+                entry.file = dir / text(stmt, 1);
+                entry.source = text(stmt, 2);
+                entry.size = static_cast<uint64_t>(sqlite3_column_int64(stmt, 3));
+                entry.lastAccess = sqlite3_column_int64(stmt, 4);
+                if (!std::filesystem::is_regular_file(entry.file, ec)) {
+                    missing.push_back(key);
+                    continue;
+                }
+                lru.push_front(key);
+                entry.lruPos = lru.begin();
+                bytes += entry.size;
+                entries.emplace(key, std::move(entry));
+            }
+        }
+        sqlite3_finalize(stmt);
+        for (const auto& key : missing)
+            forget(key);
+
+        std::unordered_set<std::string> known;
+        for (const auto& [key, entry] : entries)
+            known.insert(entry.file.lexically_normal().string());
+        for (const auto& shard : std::filesystem::directory_iterator(dir, ec)) {
+            std::string prefix = shard.path().filename().string();
+            if (prefix.size() != 2 || !isKey(prefix) || !shard.is_directory(ec))
+                continue;
+            for (const auto& item : std::filesystem::directory_iterator(shard.path(), ec)) {
+                std::string stem = item.path().stem().string();
+                if (item.is_regular_file(ec) && isKey(stem) && stem.size() == 16 && stem.compare(0, 2, prefix) == 0 &&
+                    !known.count(item.path().lexically_normal().string()))
+                    std::filesystem::remove(item.path(), ec);
+            }
+        }
+        evict();
+        std::cout << "Download cache: " << entries.size() << " files, " << bytes / (1024 * 1024) << " MB of "
+                  << budgetBytes / (1024 * 1024) << " MB" << std::endl;
+    }
+
+    // Локальная копия source; при промахе файл скачивается через download
+    Pinned fetch(const std::string& source, const Download& download) {
+        std::string key = hashKey(source);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = entries.find(key);
+            if (it != entries.end()) {
+                std::error_code ec;
+                if (it->second.source == source && std::filesystem::is_regular_file(it->second.file, ec)) {
+                    ++hitCount;
+                    touch(key, it->second);
+                    return pin(key, it->second.file);
+                }
+                bytes -= it->second.size;
+                lru.erase(it->second.lruPos);
+                entries.erase(it);
+            }
+            ++missCount;
+        }
+
+        std::error_code ec;
+        std::filesystem::path temp = dir / "tmp" / (key + "-" + std::to_string(tempCounter++));
+        std::filesystem::create_directories(temp, ec);
+        auto cleanup = [&] { std::filesystem::remove_all(temp, ec); };
+
+        if (!download(temp.string())) {
+            cleanup();
+            return nullptr;
+        }
+
+        std::filesystem::path downloaded;
+        for (const auto& item : std::filesystem::directory_iterator(temp, ec)) {
+            if (item.is_regular_file(ec))
+                downloaded = item.path();
+        }
+        if (downloaded.empty()) {
+            std::cerr << "Download of " << source << " produced no file" << std::endl;
+            cleanup();
+            return nullptr;
+        }
+
+        std::string name = key + std::filesystem::path(source).extension().string();
+        std::filesystem::path file = dir / key.substr(0, 2) / name;
+        std::filesystem::create_directories(file.parent_path(), ec);
+        std::filesystem::rename(downloaded, file, ec);
+        cleanup();
+        if (ec) {
+            std::cerr << "Failed to move " << source << " into download cache: " << ec.message() << std::endl;
+            return nullptr;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        auto previous = entries.find(key);
+        if (previous != entries.end()) {
+            // Параллельный промах по тому же ключу уже положил файл — rename его заменил
+            bytes -= previous->second.size;
+            lru.erase(previous->second.lruPos);
+            entries.erase(previous);
+        }
+        Entry entry;
+        entry.file = file;
+        entry.source = source;
+        entry.size = std::filesystem::file_size(file, ec);
+        lru.push_front(key);
+        entry.lruPos = lru.begin();
+        bytes += entry.size;
+        auto& stored = entries.emplace(key, std::move(entry)).first->second;
+        touch(key, stored);
+        retired.erase(key);     // путь снова в индексе — удалять его при откреплении нельзя
+        auto pinned = pin(key, file);
+        evict();
+        return pinned;
+    }
+
+    // Удаляет локальную копию source, если она есть (файл на диске сменился)
+    void invalidate(const std::string& source) {
+        std::string key = hashKey(source);
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = entries.find(key);
+        if (it == entries.end() || it->second.source != source)
+            return;
+        drop(key, it->second.file);
+        bytes -= it->second.size;
+        lru.erase(it->second.lruPos);
+        entries.erase(it);
+        forget(key);
+    }
+
+    Stats stats() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return {hitCount, missCount, evictionCount, bytes, entries.size(), pins.size()};
+    }
+
+private:
+    struct Entry {
+        std::filesystem::path file;
+        std::string source;
+        uint64_t size = 0;
+        int64_t lastAccess = 0;
+        std::list<std::string>::iterator lruPos;
+    };
+
+    // FNV-1a от пути на диске, 16 hex-символов
+    // Строчные шестнадцатеричные цифры, как в hashKey
+    static bool isKey(const std::string& name) {
+        return !name.empty() && name.find_first_not_of("0123456789abcdef") == std::string::npos;
+    }
+
+    static std::string hashKey(const std::string& source) {
+        uint64_t hash = 1469598103934665603ULL;
+        for (unsigned char c : source) {
+            hash ^= c;
+            hash *= 1099511628211ULL;
+        }
+        static const char digits[] = "0123456789abcdef";
+        std::string key(16, '0');
+        for (int i = 15; i >= 0; --i, hash >>= 4)
+            key[i] = digits[hash & 0xF];
+        return key;
+    }
+
+    // Вызывается под mutex; открепление — в деструкторе последней копии указателя
+    Pinned pin(const std::string& key, const std::filesystem::path& file) {
+        ++pins[key];
+        return Pinned(new std::filesystem::path(file), [this, key](const std::filesystem::path* path) {
+            unpin(key);
+            delete path;
+        });
+    }
+
+    void unpin(const std::string& key) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = pins.find(key);
+        if (it == pins.end() || --it->second > 0)
+            return;
+        pins.erase(it);
+        auto stale = retired.find(key);
+        if (stale != retired.end()) {
+            std::error_code ec;
+            std::filesystem::remove(stale->second, ec);
+            retired.erase(stale);
+        }
+        evict();    // вытеснение могло упереться в этот файл
+    }
+
+    // Файл уходит из индекса: занятый удаляется при откреплении, свободный — сразу
+    void drop(const std::string& key, const std::filesystem::path& file) {
+        if (pins.count(key)) {
+            retired[key] = file;
+            return;
+        }
+        std::error_code ec;
+        std::filesystem::remove(file, ec);
+    }
+
+    // Вызывается под mutex
+    void touch(const std::string& key, Entry& entry) {
+        lru.splice(lru.begin(), lru, entry.lruPos);
+        entry.lastAccess = std::chrono::duration_cast<std::chrono::seconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+
+        // Индекс пишется в потоке записи базы — под mutex кэша только постановка в очередь
+        db.write([this, key, relative = entry.file.lexically_relative(dir).generic_string(), source = entry.source,
+                  size = entry.size, lastAccess = entry.lastAccess] {
+            auto stmt = db.statements().acquire(
+                    "INSERT INTO download_cache (key, file, source, size, last_access) VALUES (?, ?, ?, ?, ?)"
+                    " ON CONFLICT(key) DO UPDATE SET file = excluded.file, source = excluded.source,"
+                    " size = excluded.size, last_access = excluded.last_access;");
+            if (!stmt)
+                return false;
+            sqlite3_bind_text(stmt, 1, key.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_text(stmt, 2, relative.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_text(stmt, 3, source.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_int64(stmt, 4, static_cast<int64_t>(size));
+            sqlite3_bind_int64(stmt, 5, lastAccess);
+            if (sqlite3_step(stmt) != SQLITE_DONE) {
+                std::cerr << "Failed to update download cache index: " << db.errmsg() << std::endl;
+                return false;
+            }
+            return true;
+        });
+    }
+
+    void forget(const std::string& key) {
+        db.write([this, key] {
+            auto stmt = db.statements().acquire("DELETE FROM download_cache WHERE key = ?;");
+            if (!stmt)
+                return false;
+            sqlite3_bind_text(stmt, 1, key.c_str(), -1, SQLITE_TRANSIENT);
+            return sqlite3_step(stmt) == SQLITE_DONE;
+        });
+    }
+
+    // С хвоста LRU, пока не уложимся в бюджет; закреплённые файлы пропускаются
+    void evict() {
+        for (auto pos = lru.end(); bytes > budgetBytes && pos != lru.begin();) {
+            --pos;
+            if (pins.count(*pos))
+                continue;
+            std::string key = *pos;
+            auto it = entries.find(key);
+            std::error_code ec;
+            std::filesystem::remove(it->second.file, ec);
+            bytes -= it->second.size;
+            pos = lru.erase(pos);
+            entries.erase(it);
+            forget(key);
+            ++evictionCount;
+        }
+    }
+
+    static std::string text(sqlite3_stmt* stmt, int column) {
+        const unsigned char* value = sqlite3_column_text(stmt, column);
+        return value ? reinterpret_cast<const char*>(value) : "";
+    }
+
+    Database& db;
+    const std::filesystem::path dir;
+    const uint64_t budgetBytes;
+
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, Entry> entries;
+    std::list<std::string> lru;
+    uint64_t bytes = 0;
+    uint64_t hitCount = 0;
+    uint64_t missCount = 0;
+    uint64_t evictionCount = 0;
+    std::unordered_map<std::string, int> pins;                      // ключ -> число владельцев
+    std::unordered_map<std::string, std::filesystem::path> retired; // сняты с индекса, пока были закреплены
+    std::atomic<uint64_t> tempCounter{0};
+};
+
+#endif // TG_BOT_DOWNLOADCACHE_H
@@ -17,36 +17,44 @@ struct FindAuthorSession {
     int lastBotMsg = 0;
     int64_t userId = 0;
     int topMsgId = 0;
+
+    void save(SessionCodec& codec) const {
+        codec.set("state", static_cast<int>(state));
+        codec.set("lastBotMsg", lastBotMsg);
+        codec.set("topMsgId", topMsgId);
+        codec.set("userId", userId);
+    }
+
+    void load(const SessionCodec& codec) {
+        state = static_cast<FindAuthorState>(codec.get("state", 0));
+        lastBotMsg = codec.get("lastBotMsg", 0);
+        topMsgId = codec.get("topMsgId", 0);
+        userId = codec.get<int64_t>("userId", 0);
+    }
 };
 
 class FindByAuthorCommand : public FindByFieldCommand<FindAuthorSession> {
 public:
-    FindByAuthorCommand(sqlite3* db, TgBot::Bot& bot, YandexDiskClient& yandex)
-            : FindByFieldCommand<FindAuthorSession>(db, bot, yandex, "author",
+    FindByAuthorCommand(BookListPaginator& paginator, TelegramOutbox& outbox, ActiveDialogs& dialogs)
+            : FindByFieldCommand<FindAuthorSession>(paginator, outbox, dialogs, "author",
                                                     "Введите фамилию и/или инициалы автора книги (например, Дж. К. Роулинг):") {}
 
     void execute(TgBot::Bot& bot, TgBot::Message::Ptr message) override {
-        auto& session = this->sessions[message->from->id];
+        auto active = this->startSession(message->from->id);
+        auto& session = *active;
         session.state = FindAuthorSession::waitState;
         session.userId = message->from->id;
 
-        auto topAuthors = paginator.getTopAuthors(10);
-        if (!topAuthors.empty()) {
-            std::ostringstream oss;
-            oss << u8"🔥 *ТОП-10 АВТОРОВ:*\n\n";
-            int num = 1;
-            for (const auto& author : topAuthors) {
-                oss << num++ << ". " << author << "\n";
-            }
-            session.topMsgId = bot.getApi().sendMessage(
+        auto topText = paginator.topAuthorsMessage();
+        if (!topText.empty()) {
+            session.topMsgId = outbox.sendMessage(
                     message->chat->id,
-                    oss.str(),
-                    false, 0, nullptr, "Markdown"
+                    topText, "Markdown"
             )->messageId;
         } else {
             session.topMsgId = 0;
         }
-        session.lastBotMsg = bot.getApi().sendMessage(message->chat->id, prompt)->messageId;
+        session.lastBotMsg = outbox.sendMessage(message->chat->id, prompt)->messageId;
     }
 
 };
@@ -5,7 +5,8 @@
 
 #include "SessionCommand.h"
 #include "BookListPaginator.h"
-#include "YandexDiskClient.h"
+#include "FullTextSearch.h"
+#include "TelegramOutbox.h"
 #include <sstream>
 #include <vector>
 #include <string>
@@ -15,19 +16,17 @@
 template<typename SessionType>
 class FindByFieldCommand : public SessionCommand<SessionType> {
 public:
-    FindByFieldCommand(sqlite3* db_, TgBot::Bot& bot_, YandexDiskClient& yandex_,
+    FindByFieldCommand(BookListPaginator& paginator_, TelegramOutbox& outbox_, ActiveDialogs& dialogs,
                        const std::string& fieldName_, const std::string& prompt_)
-            : db(db_), bot(bot_), yandex(yandex_), paginator(db_, bot_, yandex_), fieldName(fieldName_), prompt(prompt_) {}
+            : SessionCommand<SessionType>("find_by_" + fieldName_, dialogs),
+              paginator(paginator_), outbox(outbox_), prompt(prompt_), fieldName(fieldName_) {}
 
 protected:
-    BookListPaginator paginator;
+    BookListPaginator& paginator;
+    TelegramOutbox& outbox;
     std::string prompt;
     std::string fieldName;
 
-    void safeDeleteMessage(TgBot::Bot& bot, int64_t chatId, int msgId) {
-        try { bot.getApi().deleteMessage(chatId, msgId); } catch (...) {}
-    }
-
     static std::string normalize(const std::string& s) {
         std::string result;
         for (char c : s) {
@@ -37,13 +36,37 @@ protected:
         return result;
     }
 
+    // В HTML достаточно экранировать &, < и >, а внутри <code> — любой текст;
+    // в Markdown ввод с _ * ` [ ломал разметку, и Telegram отклонял сообщение
+    static std::string escapeHtml(const std::string& s) {
+        std::string result;
+        for (char c : s) {
+            switch (c) {
+                case '&': result += "&amp;"; break;
+                case '<': result += "&lt;"; break;
+                case '>': result += "&gt;"; break;
+                default: result += c;
+            }
+        }
+        return result;
+    }
+
+    static std::string formatSuggestions(const std::string& input, const std::vector<std::string>& suggestions) {
+        std::ostringstream oss;
+        oss << u8"По запросу «" << escapeHtml(input) << u8"» ничего не найдено 😔\n\n<b>Возможно, вы имели в виду:</b>\n";
+        for (const auto& suggestion : suggestions)
+            oss << "<code>" << escapeHtml(suggestion) << "</code>\n";
+        oss << u8"\nОтправьте исправленный запрос:";
+        return oss.str();
+    }
+
     bool handleSessionMessage(TgBot::Bot& bot, TgBot::Message::Ptr message, SessionType& session) override {
-        safeDeleteMessage(bot, message->chat->id, message->messageId);
+        outbox.deleteMessage(message->chat->id, message->messageId);
 
         if (session.lastBotMsg != 0)
-            safeDeleteMessage(bot, message->chat->id, session.lastBotMsg);
+            outbox.deleteMessage(message->chat->id, session.lastBotMsg);
         if (session.topMsgId != 0)
-            safeDeleteMessage(bot, message->chat->id, session.topMsgId);
+            outbox.deleteMessage(message->chat->id, session.topMsgId);
 
         auto trim = [](const std::string& s) -> std::string {
             size_t start = s.find_first_not_of(" \n\r\t");
@@ -87,13 +110,28 @@ protected:
                     }
                 }
 
-                std::string whereClause = fieldName + " LIKE ?";
-                std::vector<std::string> params = { "%" + input + "%" };
+                std::string match = FullTextSearch::columnQuery(fieldName, input);
+                std::string whereClause = match.empty() ? fieldName + " LIKE ?" : FullTextSearch::whereClause;
+                std::vector<std::string> params = { match.empty() ? "%" + input + "%" : match };
                 paginator.setUserPage(session.userId, 0);
+
+                // Точный поиск пуст — предлагаем похожие варианты и ждём исправленный ввод
+                if (!foundExactMatch && paginator.countResults(whereClause, params) == 0) {
+                    auto suggestions = paginator.suggest(fieldName, input);
+                    if (!suggestions.empty()) {
+                        session.topMsgId = 0;
+                        session.lastBotMsg = outbox.sendMessage(
+                                message->chat->id,
+                                formatSuggestions(input, suggestions), "HTML"
+                        )->messageId;
+                        return true;
+                    }
+                }
+
                 paginator.sendPage(message->chat->id, session.userId, whereClause, params);
-                this->sessions.erase(session.userId);
+                this->finishSession(session.userId);
             } else {
-                session.lastBotMsg = bot.getApi().sendMessage(
+                session.lastBotMsg = outbox.sendMessage(
                         message->chat->id,
                         "Некорректный ввод. Попробуйте ещё раз"
                 )->messageId;
@@ -102,11 +140,6 @@ protected:
         }
         return false;
     }
-
-private:
-    sqlite3* db;
-    TgBot::Bot& bot;
-    YandexDiskClient& yandex;
 };
 
 #endif // TG_BOT_FINDBYFIELDCOMMAND_H
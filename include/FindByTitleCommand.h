@@ -17,36 +17,44 @@ struct FindTitleSession {
     int lastBotMsg = 0;
     int64_t userId = 0;
     int topMsgId = 0;
+
+    void save(SessionCodec& codec) const {
+        codec.set("state", static_cast<int>(state));
+        codec.set("lastBotMsg", lastBotMsg);
+        codec.set("topMsgId", topMsgId);
+        codec.set("userId", userId);
+    }
+
+    void load(const SessionCodec& codec) {
+        state = static_cast<FindTitleState>(codec.get("state", 0));
+        lastBotMsg = codec.get("lastBotMsg", 0);
+        topMsgId = codec.get("topMsgId", 0);
+        userId = codec.get<int64_t>("userId", 0);
+    }
 };
 
 class FindByTitleCommand : public FindByFieldCommand<FindTitleSession> {
 public:
-    FindByTitleCommand(sqlite3* db, TgBot::Bot& bot, YandexDiskClient& yandex)
-            : FindByFieldCommand<FindTitleSession>(db, bot, yandex, "title",
+    FindByTitleCommand(BookListPaginator& paginator, TelegramOutbox& outbox, ActiveDialogs& dialogs)
+            : FindByFieldCommand<FindTitleSession>(paginator, outbox, dialogs, "title",
                                                    "Введите название книги (например, Занимательная физика):") {}
 
     void execute(TgBot::Bot& bot, TgBot::Message::Ptr message) override {
-        auto& session = this->sessions[message->from->id];
+        auto active = this->startSession(message->from->id);
+        auto& session = *active;
         session.state = FindTitleSession::waitState;
         session.userId = message->from->id;
 
-        auto topBooks = paginator.getTopBooks(10);
-        if (!topBooks.empty()) {
-            std::ostringstream oss;
-            oss << u8"📚 *ТОП-10 КНИГ:*\n\n";
-            int num = 1;
-            for (const auto& book : topBooks) {
-                oss << num++ << ". " << book.first << " — " << book.second << "\n";
-            }
-            session.topMsgId = bot.getApi().sendMessage(
+        auto topText = paginator.topBooksMessage();
+        if (!topText.empty()) {
+            session.topMsgId = outbox.sendMessage(
                     message->chat->id,
-                    oss.str(),
-                    false, 0, nullptr, "Markdown"
+                    topText, "Markdown"
                     )->messageId;
         } else {
             session.topMsgId = 0;
         }
-        session.lastBotMsg = bot.getApi().sendMessage(message->chat->id, prompt)->messageId;
+        session.lastBotMsg = outbox.sendMessage(message->chat->id, prompt)->messageId;
     }
 };
 
@@ -17,35 +17,43 @@ struct FindTopicSession {
     int lastBotMsg = 0;
     int64_t userId = 0;
     int topMsgId = 0;
+
+    void save(SessionCodec& codec) const {
+        codec.set("state", static_cast<int>(state));
+        codec.set("lastBotMsg", lastBotMsg);
+        codec.set("topMsgId", topMsgId);
+        codec.set("userId", userId);
+    }
+
+    void load(const SessionCodec& codec) {
+        state = static_cast<FindTopicState>(codec.get("state", 0));
+        lastBotMsg = codec.get("lastBotMsg", 0);
+        topMsgId = codec.get("topMsgId", 0);
+        userId = codec.get<int64_t>("userId", 0);
+    }
 };
 
 class FindByTopicCommand : public FindByFieldCommand<FindTopicSession> {
 public:
-    FindByTopicCommand(sqlite3* db, TgBot::Bot& bot, YandexDiskClient& yandex)
-            : FindByFieldCommand<FindTopicSession>(db, bot, yandex, "topic",
+    FindByTopicCommand(BookListPaginator& paginator, TelegramOutbox& outbox, ActiveDialogs& dialogs)
+            : FindByFieldCommand<FindTopicSession>(paginator, outbox, dialogs, "topic",
                                                    "Введите тему/жанр книги (например, Фэнтези):") {}
 
     void execute(TgBot::Bot& bot, TgBot::Message::Ptr message) override {
-        auto& session = this->sessions[message->from->id];
+        auto active = this->startSession(message->from->id);
+        auto& session = *active;
         session.state = FindTopicSession::waitState;
         session.userId = message->from->id;
 
-        auto topTopics = paginator.getTopTopics(10);
-        if (!topTopics.empty()) {
-            std::ostringstream oss;
-            oss << u8"🔥 *ТОП-10 ТЕМ/ЖАНРОВ:*\n\n";
-            int num = 1;
-            for (const auto& topic : topTopics) {
-                oss << num++ << ". " << topic << "\n";
-            }
-            session.topMsgId = bot.getApi().sendMessage(
+        auto topText = paginator.topTopicsMessage();
+        if (!topText.empty()) {
+            session.topMsgId = outbox.sendMessage(
                     message->chat->id,
-                    oss.str(),
-                    false,0,nullptr,"Markdown")->messageId;
+                    topText, "Markdown")->messageId;
         } else {
             session.topMsgId = 0;
         }
-        session.lastBotMsg = bot.getApi().sendMessage(message->chat->id, prompt)->messageId;
+        session.lastBotMsg = outbox.sendMessage(message->chat->id, prompt)->messageId;
     }
 };
 
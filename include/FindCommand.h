@@ -5,7 +5,8 @@
 
 #include "SessionCommand.h"
 #include "BookListPaginator.h"
-#include "YandexDiskClient.h"
+#include "FullTextSearch.h"
+#include "TelegramOutbox.h"
 #include <sstream>
 
 enum class FindState {
@@ -20,36 +21,47 @@ struct FindSession {
     int lastBotMsg = 0;
     int topMsgId = 0;
     int64_t userId = 0;
+
+    void save(SessionCodec& codec) const {
+        codec.set("state", static_cast<int>(state));
+        codec.set("author", author);
+        codec.set("lastBotMsg", lastBotMsg);
+        codec.set("topMsgId", topMsgId);
+        codec.set("userId", userId);
+    }
+
+    void load(const SessionCodec& codec) {
+        state = static_cast<FindState>(codec.get("state", 0));
+        author = codec.get<std::string>("author", "");
+        lastBotMsg = codec.get("lastBotMsg", 0);
+        topMsgId = codec.get("topMsgId", 0);
+        userId = codec.get<int64_t>("userId", 0);
+    }
 };
 
 class FindCommand : public SessionCommand<FindSession> {
 public:
-    FindCommand(sqlite3* db_, TgBot::Bot& bot_, YandexDiskClient& yandex_)
-            : db(db_), bot(bot_), yandex(yandex_), paginator(db_, bot_, yandex_) {}
+    FindCommand(BookListPaginator& paginator_, TelegramOutbox& outbox_, ActiveDialogs& dialogs)
+            : SessionCommand<FindSession>("find", dialogs), paginator(paginator_), outbox(outbox_) {}
 
     void execute(TgBot::Bot& bot, TgBot::Message::Ptr message) override {
-        auto& session = this->sessions[message->from->id];
+        auto active = this->startSession(message->from->id);
+        auto& session = *active;
         session.state = FindState::WAIT_AUTHOR;
         session.author.clear();
         session.userId = message->from->id;
 
-        auto topBooks = paginator.getTopBooks(10);
-        if (!topBooks.empty()) {
-            std::ostringstream oss;
-            oss << u8"📚 *ТОП-10 КНИГ:*\n";
-            int num = 1;
-            for (const auto& book : topBooks) {
-                oss << num++ << ". " << book.first << " — " << book.second << "\n";
-            }
-            session.topMsgId = bot.getApi().sendMessage(
+        // Текст топа кэшируется в рейтинге и пересобирается только при его изменении
+        auto topText = paginator.topBooksMessage();
+        if (!topText.empty()) {
+            session.topMsgId = outbox.sendMessage(
                     message->chat->id,
-                    oss.str(),
-                    false, 0, nullptr, "Markdown"
+                    topText, "Markdown"
                     )->messageId;
         } else {
             session.topMsgId = 0;
         }
-        session.lastBotMsg = bot.getApi().sendMessage(
+        session.lastBotMsg = outbox.sendMessage(
                 message->chat->id,
                 "Введите фамилию и/или инициалы автора книги (например, Дж. К. Роулинг):"
         )->messageId;
@@ -57,11 +69,11 @@ public:
 
 protected:
     bool handleSessionMessage(TgBot::Bot& bot, TgBot::Message::Ptr message, FindSession& session) override {
-        safeDeleteMessage(bot, message->chat->id, message->messageId);
+        outbox.deleteMessage(message->chat->id, message->messageId);
         if (session.lastBotMsg != 0)
-            safeDeleteMessage(bot, message->chat->id, session.lastBotMsg);
+            outbox.deleteMessage(message->chat->id, session.lastBotMsg);
         if (session.topMsgId != 0)
-            safeDeleteMessage(bot, message->chat->id, session.topMsgId);
+            outbox.deleteMessage(message->chat->id, session.topMsgId);
 
         auto trim = [](const std::string& s) -> std::string {
             size_t start = s.find_first_not_of(" \n\r\t");
@@ -75,12 +87,12 @@ protected:
             if (!input.empty()) {
                 session.author = input;
                 session.state = FindState::WAIT_TITLE;
-                session.lastBotMsg = bot.getApi().sendMessage(
+                session.lastBotMsg = outbox.sendMessage(
                         message->chat->id,
                         "Введите название книги:"
                 )->messageId;
             } else {
-                session.lastBotMsg = bot.getApi().sendMessage(
+                session.lastBotMsg = outbox.sendMessage(
                         message->chat->id,
                         "Некорректный ввод. Попробуйте ещё раз"
                 )->messageId;
@@ -92,13 +104,16 @@ protected:
             std::string input = trim(message->text);
             if (!input.empty()) {
                 paginator.increaseBookRequestCount(input);
-                std::string whereClause = "author LIKE ? AND title LIKE ?";
-                std::vector<std::string> params = {"%" + session.author + "%", "%" + input + "%"};
+                std::string match = FullTextSearch::matchAll({{"author", session.author}, {"title", input}});
+                std::string whereClause = match.empty() ? "author LIKE ? AND title LIKE ?" : FullTextSearch::whereClause;
+                std::vector<std::string> params = match.empty()
+                        ? std::vector<std::string>{"%" + session.author + "%", "%" + input + "%"}
+                        : std::vector<std::string>{match};
                 paginator.setUserPage(session.userId, 0);
                 paginator.sendPage(message->chat->id, session.userId, whereClause, params);
-                this->sessions.erase(session.userId);
+                this->finishSession(session.userId);
             } else {
-                session.lastBotMsg = bot.getApi().sendMessage(
+                session.lastBotMsg = outbox.sendMessage(
                         message->chat->id,
                         "Некорректное название. Попробуйте ещё раз"
                 )->messageId;
@@ -109,15 +124,8 @@ protected:
     }
 
 private:
-    sqlite3* db;
-    TgBot::Bot& bot;
-    YandexDiskClient& yandex;
-    BookListPaginator paginator;
-
-    void safeDeleteMessage(TgBot::Bot& bot, int64_t chatId, int msgId) {
-        try { bot.getApi().deleteMessage(chatId, msgId); }
-        catch (...) {}
-    }
+    BookListPaginator& paginator;
+    TelegramOutbox& outbox;
 };
 
 #endif // TG_BOT_FINDCOMMAND_H
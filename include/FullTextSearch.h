@@ -0,0 +1,171 @@
+#ifndef TG_BOT_FULLTEXTSEARCH_H
+#define TG_BOT_FULLTEXTSEARCH_H
+
+#pragma once
+
+#include <sqlite3.h>
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Полнотекстовый поиск по каталогу на FTS5.
+ * books_fts — external content таблица над books(title, author, topic),
+ * синхронизируется триггерами на books. Ввод пользователя превращается
+ * в MATCH-выражение: каждое слово — префиксный запрос, слова через AND.
+ * Если FTS5 недоступен, columnQuery/matchAll возвращают пустую строку
+ * и вызывающий код остаётся на LIKE.
+ */
+
+class FullTextSearch {
+public:
+    // Условие для BookListPaginator: выборка идёт через books_fts с сортировкой по bm25
+    static constexpr const char* whereClause = "books_fts MATCH ?";
+
+    static bool isRanked(const std::string& where) {
+        return where.find("books_fts") != std::string::npos;
+    }
+
+    // Создаёт индекс и триггеры; при первом создании индексирует уже лежащие книги.
+    // Индекс есть, а триггера вставки нет — импорт упал между suspendSync и resumeSync,
+    // и загруженные им строки в индекс не попали: тогда он тоже строится заново
+    static bool ensureIndex(sqlite3* db) {
+        bool rebuild = !exists(db, "books_fts") || !exists(db, "books_fts_ai");
+        if (!createIndex(db))
+            return false;
+
+        if (rebuild && sqlite3_exec(db, "INSERT INTO books_fts(books_fts) VALUES ('rebuild');",
+                                    nullptr, nullptr, nullptr) != SQLITE_OK) {
+            std::cerr << "Failed to build full-text index: " << sqlite3_errmsg(db) << std::endl;
+            return false;
+        }
+
+        enabled().store(true);
+        return true;
+    }
+
+    // Массовая вставка: построчная синхронизация индекса отключается,
+    // после загрузки одним запросом индексируются строки с rowid > lastIndexed.
+    // Удалённый триггер заодно служит отметкой незаконченной загрузки для ensureIndex
+    static void suspendSync(sqlite3* db) {
+        sqlite3_exec(db, "DROP TRIGGER IF EXISTS books_fts_ai;", nullptr, nullptr, nullptr);
+    }
+
+    static bool resumeSync(sqlite3* db, int64_t lastIndexed) {
+        if (!exists(db, "books_fts"))
+            return ensureIndex(db); // строит индекс целиком
+
+        sqlite3_stmt* stmt;
+        int rc = sqlite3_prepare_v2(db, "INSERT INTO books_fts(rowid, title, author, topic)"
+                                        " SELECT id, title, author, topic FROM books WHERE id > ?;", -1, &stmt, nullptr);
+        if (rc == SQLITE_OK) {
+            sqlite3_bind_int64(stmt, 1, lastIndexed);
+            rc = sqlite3_step(stmt);
+        }
+        sqlite3_finalize(stmt);
+        if (rc != SQLITE_DONE) {
+            std::cerr << "Failed to index imported books: " << sqlite3_errmsg(db) << std::endl;
+            return false;
+        }
+        // Триггер возвращается только после дозаписи, иначе сбой в ней остался бы незамеченным
+        if (!createIndex(db))
+            return false;
+        enabled().store(true);
+        return true;
+    }
+
+    static bool available() {
+        return enabled().load();
+    }
+
+    // "Дж. Роулинг" -> author : ("Дж."* AND "Роулинг"*)
+    static std::string columnQuery(const std::string& column, const std::string& input) {
+        if (!available())
+            return "";
+
+        std::istringstream words(input);
+        std::string word;
+        std::string terms;
+        while (words >> word) {
+            if (!terms.empty()) terms += " AND ";
+            terms += quote(word) + "*";
+        }
+        if (terms.empty())
+            return "";
+        return column + " : (" + terms + ")";
+    }
+
+    // Пары (колонка, ввод) через AND; пустой ввод пропускается
+    static std::string matchAll(const std::vector<std::pair<std::string, std::string>>& columnInputs) {
+        std::string match;
+        for (const auto& [column, input] : columnInputs) {
+            if (input.empty())
+                continue;
+            std::string query = columnQuery(column, input);
+            if (query.empty())
+                return "";
+            if (!match.empty()) match += " AND ";
+            match += query;
+        }
+        return match;
+    }
+
+private:
+    static bool createIndex(sqlite3* db) {
+        const char* scripts[] = {
+                "CREATE VIRTUAL TABLE IF NOT EXISTS books_fts USING fts5("
+                " title, author, topic, content='books', content_rowid='id',"
+                " tokenize='unicode61 remove_diacritics 2');",
+                "CREATE TRIGGER IF NOT EXISTS books_fts_ai AFTER INSERT ON books BEGIN"
+                " INSERT INTO books_fts(rowid, title, author, topic) VALUES (new.id, new.title, new.author, new.topic);"
+                " END;",
+                "CREATE TRIGGER IF NOT EXISTS books_fts_ad AFTER DELETE ON books BEGIN"
+                " INSERT INTO books_fts(books_fts, rowid, title, author, topic)"
+                " VALUES ('delete', old.id, old.title, old.author, old.topic);"
+                " END;",
+                "CREATE TRIGGER IF NOT EXISTS books_fts_au AFTER UPDATE OF title, author, topic ON books BEGIN"
+                " INSERT INTO books_fts(books_fts, rowid, title, author, topic)"
+                " VALUES ('delete', old.id, old.title, old.author, old.topic);"
+                " INSERT INTO books_fts(rowid, title, author, topic) VALUES (new.id, new.title, new.author, new.topic);"
+                " END;"
+        };
+        for (const char* script : scripts) {
+            if (sqlite3_exec(db, script, nullptr, nullptr, nullptr) != SQLITE_OK) {
+                std::cerr << "Full-text index is unavailable, falling back to LIKE: " << sqlite3_errmsg(db) << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static bool exists(sqlite3* db, const char* name) {
+        bool found = false;
+        sqlite3_stmt* stmt;
+        if (sqlite3_prepare_v2(db, "SELECT 1 FROM sqlite_master WHERE name = ?;", -1, &stmt, nullptr) == SQLITE_OK) {
+            sqlite3_bind_text(stmt, 1, name, -1, SQLITE_STATIC);
+            found = sqlite3_step(stmt) == SQLITE_ROW;
+        }
+        sqlite3_finalize(stmt);
+        return found;
+    }
+
+    static std::atomic<bool>& enabled() {
+        static std::atomic<bool> flag{false};
+        return flag;
+    }
+
+    static std::string quote(const std::string& word) {
+        std::string quoted = "\"";
+        for (char c : word) {
+            if (c == '"') quoted += '"';
+            quoted += c;
+        }
+        return quoted + "\"";
+    }
+};
+
+#endif // TG_BOT_FULLTEXTSEARCH_H
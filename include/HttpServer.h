@@ -0,0 +1,409 @@
+#ifndef TG_BOT_HTTPSERVER_H
+#define TG_BOT_HTTPSERVER_H
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+
+struct HttpRequest {
+    std::string method;
+    std::string path;
+    std::map<std::string, std::string> headers;    // имена в нижнем регистре
+    std::string body;
+
+    std::string header(const std::string& name) const {
+        auto it = headers.find(name);
+        return it == headers.end() ? "" : it->second;
+    }
+};
+
+struct HttpResponse {
+    int status = 200;
+    std::string body;
+    std::string contentType = "text/plain";
+};
+
+/**
+ * Минимальный HTTP/1.1-сервер для вебхука и служебных страниц: тело только
+ * с Content-Length, соединения keep-alive, поток на соединение. Число
+ * соединений ограничено (Telegram держит их не больше max_connections из
+ * setWebhook), сверх лимита сразу отвечаем 503. Соединение без запросов
+ * дольше idleTimeout закрывается. TLS нет — снаружи его снимает обратный прокси.
+ */
+
+class HttpServer {
+public:
+    using Handler = std::function<HttpResponse(const HttpRequest&)>;
+
+    struct Stats {
+        uint64_t connections = 0;
+        uint64_t requests = 0;
+        uint64_t refused = 0;       // сверх maxConnections
+    };
+
+    explicit HttpServer(Handler handler_, size_t maxConnections_ = 64,
+                        std::chrono::seconds idleTimeout_ = std::chrono::seconds(60))
+            : handler(std::move(handler_)), maxConnections(maxConnections_), idleTimeout(idleTimeout_) {
+#ifdef _WIN32
+        WSADATA data;
+        WSAStartup(MAKEWORD(2, 2), &data);
+#endif
+    }
+
+    ~HttpServer() {
+        stop();
+#ifdef _WIN32
+        WSACleanup();
+#endif
+    }
+
+    HttpServer(const HttpServer&) = delete;
+    HttpServer& operator=(const HttpServer&) = delete;
+
+    // port = 0 — любой свободный, узнать его можно через port()
+    bool listen(const std::string& host, uint16_t port_) {
+        listener = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (listener == invalidSocket) {
+            std::cerr << "HTTP server: can't create socket" << std::endl;
+            return false;
+        }
+        int reuse = 1;
+        setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port_);
+        if (inet_pton(AF_INET, host.c_str(), &address.sin_addr) != 1 ||
+            ::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+            ::listen(listener, SOMAXCONN) != 0) {
+            std::cerr << "HTTP server: can't listen on " << host << ":" << port_ << std::endl;
+            closeSocket(listener);
+            listener = invalidSocket;
+            return false;
+        }
+
+        socklen_t length = sizeof(address);
+        getsockname(listener, reinterpret_cast<sockaddr*>(&address), &length);
+        boundPort = ntohs(address.sin_port);
+        return true;
+    }
+
+    uint16_t port() const {
+        return boundPort;
+    }
+
+    // Принимает соединения в вызывающем потоке до stop().
+    // Ошибка accept не останавливает приём: оборванное клиентом соединение
+    // и прерванный вызов повторяются сразу, нехватка дескрипторов или памяти —
+    // с нарастающей паузой, пока соединения не закроются
+    void run() {
+        if (listener == invalidSocket)
+            return;
+        std::chrono::milliseconds backoff(0);
+        while (!stopping) {
+            Socket client = ::accept(listener, nullptr, nullptr);
+            if (client != invalidSocket) {
+                backoff = std::chrono::milliseconds(0);
+                serve(client);
+                continue;
+            }
+            if (stopping)
+                break;
+            int error = lastError();
+            if (isTransient(error))
+                continue;
+            backoff = backoff.count() == 0 ? std::chrono::milliseconds(50)
+                                           : std::min<std::chrono::milliseconds>(backoff * 2, std::chrono::seconds(1));
+            std::cerr << "HTTP server: accept failed (error " << error << "), retrying in "
+                      << backoff.count() << " ms" << std::endl;
+            std::this_thread::sleep_for(backoff);
+        }
+    }
+
+    // То же в отдельном потоке
+    void start() {
+        acceptor = std::thread(&HttpServer::run, this);
+    }
+
+    void stop() {
+        if (stopping.exchange(true))
+            return;
+        if (listener != invalidSocket) {
+            shutdownSocket(listener);
+            closeSocket(listener);
+        }
+        if (acceptor.joinable())
+            acceptor.join();
+
+        std::list<Connection> remaining;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (auto& connection : connections) {
+                if (!connection.done)
+                    shutdownSocket(connection.socket);
+            }
+            remaining.swap(connections);
+        }
+        for (auto& connection : remaining) {
+            if (connection.thread.joinable())
+                connection.thread.join();
+        }
+    }
+
+    Stats stats() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return counters;
+    }
+
+private:
+#ifdef _WIN32
+    using Socket = SOCKET;
+    static constexpr Socket invalidSocket = INVALID_SOCKET;
+    static void closeSocket(Socket socket) { closesocket(socket); }
+    static void shutdownSocket(Socket socket) { shutdown(socket, SD_BOTH); }
+    static int lastError() { return WSAGetLastError(); }
+    static bool isTransient(int error) {
+        return error == WSAEINTR || error == WSAECONNRESET || error == WSAEWOULDBLOCK;
+    }
+#else
+    using Socket = int;
+    static constexpr Socket invalidSocket = -1;
+    static void closeSocket(Socket socket) { ::close(socket); }
+    static void shutdownSocket(Socket socket) { shutdown(socket, SHUT_RDWR); }
+    static int lastError() { return errno; }
+    // Соединение оборвалось до accept или вызов прерван сигналом — слушающий сокет в порядке
+    static bool isTransient(int error) {
+        return error == EINTR || error == ECONNABORTED || error == EAGAIN ||
+               error == EPROTO || error == ENETDOWN || error == ENETUNREACH || error == EHOSTUNREACH;
+    }
+#endif
+
+    static constexpr size_t maxHeaderBytes = 16 * 1024;
+    static constexpr size_t maxBodyBytes = 4 * 1024 * 1024;
+
+    struct Connection {
+        Socket socket;
+        std::thread thread;
+        std::atomic<bool> done{false};
+    };
+
+    void serve(Socket client) {
+        std::lock_guard<std::mutex> lock(mutex);
+        // Заодно собираем потоки закрытых соединений
+        for (auto it = connections.begin(); it != connections.end();) {
+            if (it->done) {
+                it->thread.join();
+                it = connections.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        if (connections.size() >= maxConnections) {
+            ++counters.refused;
+            sendAll(client, format({503, "Too many connections"}, false));
+            closeSocket(client);
+            return;
+        }
+        ++counters.connections;
+
+        int noDelay = 1;
+        setsockopt(client, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+#ifdef _WIN32
+        DWORD timeout = static_cast<DWORD>(idleTimeout.count() * 1000);
+#else
+        timeval timeout{static_cast<decltype(timeval::tv_sec)>(idleTimeout.count()), 0};
+#endif
+        setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+
+        connections.emplace_back();
+        Connection& connection = connections.back();
+        connection.socket = client;
+        connection.thread = std::thread([this, &connection] {
+            handleConnection(connection.socket);
+            // Под mutex, чтобы stop() не тронул уже закрытый (и, возможно, переиспользованный) сокет
+            std::lock_guard<std::mutex> lock(mutex);
+            closeSocket(connection.socket);
+            connection.done = true;
+        });
+    }
+
+    // Запросы одного соединения по очереди, пока клиент не закроет его или не замолчит
+    void handleConnection(Socket client) {
+        std::string buffer;
+        char chunk[16 * 1024];
+        while (!stopping) {
+            size_t headerEnd;
+            while ((headerEnd = buffer.find("\r\n\r\n")) == std::string::npos) {
+                if (buffer.size() > maxHeaderBytes) {
+                    sendAll(client, format({431, "Headers too large"}, false));
+                    return;
+                }
+                int received = static_cast<int>(recv(client, chunk, sizeof(chunk), 0));
+                if (received <= 0)
+                    return;
+                buffer.append(chunk, static_cast<size_t>(received));
+            }
+
+            HttpRequest request;
+            std::string version;
+            if (!parseHead(buffer.substr(0, headerEnd), request, version)) {
+                sendAll(client, format({400, "Bad request"}, false));
+                return;
+            }
+            if (!request.header("transfer-encoding").empty()) {
+                sendAll(client, format({411, "Content-Length required"}, false));
+                return;
+            }
+            size_t length = 0;
+            try {
+                std::string value = request.header("content-length");
+                length = value.empty() ? 0 : std::stoul(value);
+            } catch (const std::exception&) {
+                sendAll(client, format({400, "Bad Content-Length"}, false));
+                return;
+            }
+            if (length > maxBodyBytes) {
+                sendAll(client, format({413, "Body too large"}, false));
+                return;
+            }
+
+            size_t bodyStart = headerEnd + 4;
+            while (buffer.size() < bodyStart + length) {
+                int received = static_cast<int>(recv(client, chunk, sizeof(chunk), 0));
+                if (received <= 0)
+                    return;
+                buffer.append(chunk, static_cast<size_t>(received));
+            }
+            request.body = buffer.substr(bodyStart, length);
+            buffer.erase(0, bodyStart + length);
+
+            std::string connectionHeader = lower(request.header("connection"));
+            bool keepAlive = version == "HTTP/1.1" ? connectionHeader != "close" : connectionHeader == "keep-alive";
+
+            HttpResponse response;
+            try {
+                response = handler(request);
+            } catch (const std::exception& e) {
+                std::cerr << "HTTP handler error: " << e.what() << std::endl;
+                response = {500, "Internal error"};
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                ++counters.requests;
+            }
+            if (!sendAll(client, format(response, keepAlive)) || !keepAlive)
+                return;
+        }
+    }
+
+    static bool parseHead(const std::string& head, HttpRequest& request, std::string& version) {
+        size_t lineEnd = head.find("\r\n");
+        std::string line = head.substr(0, lineEnd);
+        size_t first = line.find(' ');
+        size_t second = line.find(' ', first + 1);
+        if (first == std::string::npos || second == std::string::npos)
+            return false;
+        request.method = line.substr(0, first);
+        request.path = line.substr(first + 1, second - first - 1);
+        version = line.substr(second + 1);
+
+        while (lineEnd != std::string::npos) {
+            size_t start = lineEnd + 2;
+            lineEnd = head.find("\r\n", start);
+            std::string header = head.substr(start, lineEnd == std::string::npos ? std::string::npos : lineEnd - start);
+            size_t colon = header.find(':');
+            if (colon == std::string::npos)
+                continue;
+            size_t value = header.find_first_not_of(' ', colon + 1);
+            request.headers[lower(header.substr(0, colon))] = value == std::string::npos ? "" : header.substr(value);
+        }
+        return true;
+    }
+
+    static std::string format(const HttpResponse& response, bool keepAlive) {
+        std::string out = "HTTP/1.1 " + std::to_string(response.status) + " " + reason(response.status) + "\r\n";
+        out += "Content-Type: " + response.contentType + "\r\n";
+        out += "Content-Length: " + std::to_string(response.body.size()) + "\r\n";
+        out += keepAlive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+        return out + response.body;
+    }
+
+    static const char* reason(int status) {
+        switch (status) {
+            case 200: return "OK";
+            case 400: return "Bad Request";
+            case 403: return "Forbidden";
+            case 404: return "Not Found";
+            case 405: return "Method Not Allowed";
+            case 411: return "Length Required";
+            case 413: return "Payload Too Large";
+            case 431: return "Request Header Fields Too Large";
+            case 503: return "Service Unavailable";
+            default: return status < 500 ? "Client Error" : "Server Error";
+        }
+    }
+
+    static bool sendAll(Socket client, const std::string& data) {
+        size_t sent = 0;
+        while (sent < data.size()) {
+#ifdef _WIN32
+            int written = ::send(client, data.data() + sent, static_cast<int>(data.size() - sent), 0);
+#else
+            int written = static_cast<int>(::send(client, data.data() + sent, data.size() - sent, MSG_NOSIGNAL));
+#endif
+            if (written <= 0)
+                return false;
+            sent += static_cast<size_t>(written);
+        }
+        return true;
+    }
+
+    static std::string lower(std::string value) {
+        std::transform(value.begin(), value.end(), value.begin(),
+                       [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        return value;
+    }
+
+    Handler handler;
+    const size_t maxConnections;
+    const std::chrono::seconds idleTimeout;
+
+    Socket listener = invalidSocket;
+    uint16_t boundPort = 0;
+    std::atomic<bool> stopping{false};
+    std::thread acceptor;
+
+    mutable std::mutex mutex;
+    std::list<Connection> connections;
+    Stats counters;
+};
+
+#endif // TG_BOT_HTTPSERVER_H
@@ -0,0 +1,179 @@
+#ifndef TG_BOT_HTTPTRANSPORT_H
+#define TG_BOT_HTTPTRANSPORT_H
+
+#pragma once
+
+#include <curl/curl.h>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Общий HTTP-транспорт для запросов к Telegram и Яндекс Диску. Все передачи
+ * выполняет один поток через curl multi: у него общий кэш соединений, поэтому
+ * соединение с хостом открывается один раз и переиспользуется всеми потоками
+ * бота, а с HTTP/2 параллельные запросы идут потоками по одному соединению.
+ * DNS и TLS-сессии лежат в share-хэндле — новое соединение к знакомому хосту
+ * обходится без полного рукопожатия. Share-хэндл трогает только поток
+ * транспорта (подключает его к хэндлу при добавлении в multi и отключает
+ * при удалении), поэтому блокировки CURLSHOPT_LOCKFUNC ему не нужны.
+ *
+ * Вызывающий настраивает свой easy-хэндл как обычно и зовёт perform() вместо
+ * curl_easy_perform: вызов блокируется до конца передачи. Колбэки чтения и
+ * записи выполняются в потоке транспорта.
+ */
+
+class HttpTransport {
+public:
+    struct HostStats {
+        uint64_t requests = 0;
+        uint64_t connections = 0;   // сколько раз пришлось открыть новое соединение
+        uint64_t http2 = 0;         // запросов по HTTP/2
+        uint64_t failures = 0;
+        double seconds = 0;         // суммарное время запросов
+    };
+
+    explicit HttpTransport(long maxConnections = 16) {
+        curl_global_init(CURL_GLOBAL_DEFAULT);
+        share = curl_share_init();
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+        multi = curl_multi_init();
+        curl_multi_setopt(multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+        curl_multi_setopt(multi, CURLMOPT_MAXCONNECTS, maxConnections);
+        loop = std::thread(&HttpTransport::run, this);
+    }
+
+    // Дожидается начатых передач; новые после этого завершаются ошибкой
+    ~HttpTransport() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        curl_multi_wakeup(multi);
+        loop.join();
+        curl_multi_cleanup(multi);
+        curl_share_cleanup(share);
+    }
+
+    HttpTransport(const HttpTransport&) = delete;
+    HttpTransport& operator=(const HttpTransport&) = delete;
+
+    // Выполняет настроенный запрос; хэндл нельзя трогать из других потоков до возврата
+    CURLcode perform(CURL* easy) {
+        Transfer transfer{easy};
+        curl_easy_setopt(easy, CURLOPT_HTTP_VERSION, static_cast<long>(CURL_HTTP_VERSION_2TLS));
+        curl_easy_setopt(easy, CURLOPT_PIPEWAIT, 1L);       // подождать HTTP/2 вместо второго соединения
+        curl_easy_setopt(easy, CURLOPT_TCP_KEEPALIVE, 1L);
+        curl_easy_setopt(easy, CURLOPT_NOSIGNAL, 1L);
+        curl_easy_setopt(easy, CURLOPT_PRIVATE, &transfer);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopping)
+                return CURLE_FAILED_INIT;
+            incoming.push_back(&transfer);
+        }
+        curl_multi_wakeup(multi);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [&transfer] { return transfer.done; });
+        return transfer.result;
+    }
+
+    std::map<std::string, HostStats> stats() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return hosts;
+    }
+
+private:
+    struct Transfer {
+        CURL* easy;
+        CURLcode result = CURLE_OK;
+        bool done = false;
+    };
+
+    void run() {
+        int running = 0;
+        while (true) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (stopping && incoming.empty() && active == 0)
+                    break;
+                for (Transfer* transfer : incoming) {
+                    curl_easy_setopt(transfer->easy, CURLOPT_SHARE, share);
+                    curl_multi_add_handle(multi, transfer->easy);
+                }
+                active += incoming.size();
+                incoming.clear();
+            }
+
+            curl_multi_perform(multi, &running);
+            int queued = 0;
+            while (CURLMsg* message = curl_multi_info_read(multi, &queued)) {
+                if (message->msg == CURLMSG_DONE)
+                    complete(message->easy_handle, message->data.result);
+            }
+            curl_multi_poll(multi, nullptr, 0, 1000, nullptr);
+        }
+    }
+
+    void complete(CURL* easy, CURLcode result) {
+        Transfer* transfer = nullptr;
+        curl_easy_getinfo(easy, CURLINFO_PRIVATE, reinterpret_cast<char**>(&transfer));
+        curl_multi_remove_handle(multi, easy);
+
+        char* url = nullptr;
+        long connects = 0;
+        long version = 0;
+        double seconds = 0;
+        curl_easy_getinfo(easy, CURLINFO_EFFECTIVE_URL, &url);
+        curl_easy_getinfo(easy, CURLINFO_NUM_CONNECTS, &connects);
+        curl_easy_getinfo(easy, CURLINFO_HTTP_VERSION, &version);
+        curl_easy_getinfo(easy, CURLINFO_TOTAL_TIME, &seconds);
+        std::string host = hostOf(url ? url : "");
+        // Хэндл может пережить транспорт (thread_local у вызывающих)
+        curl_easy_setopt(easy, CURLOPT_SHARE, nullptr);
+        curl_easy_setopt(easy, CURLOPT_PRIVATE, nullptr);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            HostStats& stats = hosts[host];
+            ++stats.requests;
+            stats.connections += static_cast<uint64_t>(connects);
+            if (version == CURL_HTTP_VERSION_2_0)
+                ++stats.http2;
+            if (result != CURLE_OK)
+                ++stats.failures;
+            stats.seconds += seconds;
+
+            transfer->result = result;
+            transfer->done = true;
+            --active;
+        }
+        finished.notify_all();
+    }
+
+    // "https://api.telegram.org/bot.../getMe" -> "api.telegram.org"
+    static std::string hostOf(const std::string& url) {
+        size_t scheme = url.find("://");
+        size_t start = scheme == std::string::npos ? 0 : scheme + 3;
+        return url.substr(start, url.find_first_of("/?#", start) - start);
+    }
+
+    CURLM* multi = nullptr;
+    CURLSH* share = nullptr;
+    std::thread loop;
+
+    mutable std::mutex mutex;
+    std::condition_variable finished;
+    std::vector<Transfer*> incoming;
+    size_t active = 0;
+    bool stopping = false;
+    std::map<std::string, HostStats> hosts;
+};
+
+#endif // TG_BOT_HTTPTRANSPORT_H
@@ -3,11 +3,15 @@
 #pragma once
 
 #include <tgbot/tgbot.h>
+#include <cstddef>
+#include "Database.h"
 
 /**
  * Базовый интерфейс для всех команд.
  * execute - вызов по /command
  * handleMessage - опциональная обработка обычных сообщений
+ * cancelDialog - сброс незавершённого диалога, когда пользователь начал другой
+ * saveSessions/restoreSessions - снимок незавершённых диалогов в базу
  */
 
 class ICommand {
@@ -21,6 +25,17 @@ public:
     virtual bool handleMessage(TgBot::Bot& bot, TgBot::Message::Ptr message) {
         return false;
     }
+
+    virtual void cancelDialog(int64_t userId) {}
+
+    virtual bool saveSessions(Database& db) {
+        return true;
+    }
+
+    // Сколько сессий поднято из снимка
+    virtual size_t restoreSessions(Database& db) {
+        return 0;
+    }
 };
 
 #endif // TG_BOT_ICOMMAND_H
@@ -0,0 +1,152 @@
+#ifndef TG_BOT_LEADERBOARD_H
+#define TG_BOT_LEADERBOARD_H
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Рейтинг популярности в памяти: хэш-таблица ключ -> счётчик плюс
+ * упорядоченный индекс по убыванию счётчика.
+ * При старте загружается топ из базы, дальше обновляется на месте каждым
+ * инкрементом. Ключ, которого ещё нет в памяти, дочитывается через lookup:
+ * счётчики только растут, поэтому ключ вне загруженного топа может попасть
+ * в него только через инкремент.
+ *
+ * В памяти не больше depth + admission ключей: глубина топа и небольшой
+ * буфер для поднимающихся. Лишний ключ с наименьшим счётчиком вытесняется
+ * и при следующем инкременте снова читается через lookup — он обязан учесть
+ * и инкременты, ещё не записанные в базу. Пользователи вводят
+ * произвольные строки, и без предела каждая осталась бы в памяти навсегда.
+ * Текст сообщения с топом кэшируется и строится заново только при
+ * изменении состава или порядка первых watched позиций.
+ */
+
+class Leaderboard {
+public:
+    struct Entry {
+        std::string key;
+        std::string extra;
+        int64_t count = 0;
+    };
+
+    using Lookup = std::function<std::optional<Entry>(const std::string&)>;
+    using Formatter = std::function<std::string(const std::vector<Entry>&)>;
+
+    explicit Leaderboard(size_t watched_ = 10, size_t depth_ = 100, size_t admission_ = 32)
+            : watched(watched_), capacity(std::max(depth_, watched_) + admission_) {}
+
+    void load(const std::vector<Entry>& top) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto& entry : top) {
+            if (entries.count(entry.key))
+                continue;
+            entries.emplace(entry.key, entry);
+            order.insert({entry.count, entry.key});
+        }
+        trim();
+        ++version;
+    }
+
+    // lookup должен вернуть значение без этого инкремента: вызывать до записи его в базу
+    void increment(const std::string& key, const Lookup& lookup) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = entries.find(key);
+            if (it != entries.end()) {
+                bump(it->second, 1);
+                return;
+            }
+        }
+
+        // Первое обращение к ключу — базовое значение из базы, вне блокировки
+        auto stored = lookup(key);
+        if (!stored)
+            return;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = entries.find(key);
+        if (it == entries.end()) {
+            stored->key = key;
+            it = entries.emplace(key, *stored).first;
+            order.insert({it->second.count, key});
+        }
+        bump(it->second, 1);
+        trim();
+    }
+
+
+    std::vector<Entry> top(size_t n) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return topLocked(n);
+    }
+
+    std::string render(const Formatter& format) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (renderedVersion != version) {
+            rendered = format(topLocked(watched));
+            renderedVersion = version;
+        }
+        return rendered;
+    }
+
+private:
+    struct ByCountDesc {
+        bool operator()(const std::pair<int64_t, std::string>& a, const std::pair<int64_t, std::string>& b) const {
+            return a.first != b.first ? a.first > b.first : a.second < b.second;
+        }
+    };
+
+    void bump(Entry& entry, int64_t delta) {
+        auto before = topKeys();
+        order.erase({entry.count, entry.key});
+        entry.count += delta;
+        order.insert({entry.count, entry.key});
+        if (topKeys() != before)
+            ++version;
+    }
+
+    // Вытесняет ключи с наименьшими счётчиками сверх capacity; в первые watched они не входят
+    void trim() {
+        while (entries.size() > capacity) {
+            auto last = std::prev(order.end());
+            entries.erase(last->second);
+            order.erase(last);
+        }
+    }
+
+    std::vector<std::string> topKeys() const {
+        std::vector<std::string> keys;
+        for (auto it = order.begin(); it != order.end() && keys.size() < watched; ++it)
+            keys.push_back(it->second);
+        return keys;
+    }
+
+    std::vector<Entry> topLocked(size_t n) const {
+        std::vector<Entry> result;
+        for (auto it = order.begin(); it != order.end() && result.size() < n; ++it)
+            result.push_back(entries.at(it->second));
+        return result;
+    }
+
+    const size_t watched;
+    const size_t capacity;
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, Entry> entries;
+    std::set<std::pair<int64_t, std::string>, ByCountDesc> order;
+
+    uint64_t version = 0;
+    uint64_t renderedVersion = UINT64_MAX;
+    std::string rendered;
+};
+
+#endif // TG_BOT_LEADERBOARD_H
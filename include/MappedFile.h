@@ -0,0 +1,107 @@
+#ifndef TG_BOT_MAPPEDFILE_H
+#define TG_BOT_MAPPEDFILE_H
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/**
+ * Файл, отображённый в память только для чтения.
+ * Страницы подгружаются ядром по мере чтения и не копируются в кучу;
+ * release(offset) отдаёт уже прочитанный префикс обратно, так что при
+ * последовательном чтении резидентной остаётся лишь небольшая часть файла.
+ */
+
+class MappedFile {
+public:
+    explicit MappedFile(const std::filesystem::path& path) {
+#ifdef _WIN32
+        file = CreateFileW(path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+                           OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return;
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+            return;
+        mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping)
+            return;
+        data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        if (data)
+            length = static_cast<size_t>(fileSize.QuadPart);
+#else
+        fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return;
+        struct stat info {};
+        if (fstat(fd, &info) != 0 || info.st_size == 0)
+            return;
+        void* mapped = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED)
+            return;
+        madvise(mapped, static_cast<size_t>(info.st_size), MADV_SEQUENTIAL);
+        data = static_cast<const char*>(mapped);
+        length = static_cast<size_t>(info.st_size);
+#endif
+    }
+
+    ~MappedFile() {
+#ifdef _WIN32
+        if (data) UnmapViewOfFile(data);
+        if (mapping) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+        if (data) munmap(const_cast<char*>(data), length);
+        if (fd >= 0) ::close(fd);
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    explicit operator bool() const { return data != nullptr; }
+    const char* bytes() const { return data; }
+    size_t size() const { return length; }
+
+    // Прочитанные страницы до offset больше не нужны — ядро может их выгрузить
+    void release(size_t offset) {
+#ifndef _WIN32
+        static const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        size_t end = offset / page * page;
+        if (end > released) {
+            madvise(const_cast<char*>(data) + released, end - released, MADV_DONTNEED);
+            released = end;
+        }
+#else
+        (void)offset; // Windows сам вытесняет страницы отображения при нехватке памяти
+#endif
+    }
+
+private:
+    const char* data = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#else
+    int fd = -1;
+    size_t released = 0;
+#endif
+};
+
+#endif // TG_BOT_MAPPEDFILE_H
@@ -0,0 +1,381 @@
+#ifndef TG_BOT_METRICS_H
+#define TG_BOT_METRICS_H
+
+#pragma once
+
+#include <fmt/format.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include "Tracing.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+/**
+ * Метрики бота: гистограммы задержек команд, типов callback-запросов,
+ * SQL-выражений, вызовов Яндекс Диска и методов Bot API.
+ *
+ * Гистограмма в духе HDR: 16 корзин на каждую степень двойки наносекунд
+ * (погрешность квантилей ~6%) от 1 нс до ~73 минут. Запись — несколько
+ * relaxed-инкрементов атомиков без блокировок, поэтому горячий путь платит
+ * только за два чтения часов. Гистограммы создаются один раз и живут до
+ * конца процесса; вызывающие держат ссылку и не ищут её на каждом вызове.
+ *
+ * Снаружи метрики видны в текстовом формате Prometheus (prometheus()) и
+ * краткой сводкой для команды /stats (summary()). Подсистемы, которые сами
+ * считают свою статистику (кэш загрузок, HTTP-транспорт), подключаются через
+ * addCollector; ряды с метками (хост) идут под общим HELP/TYPE.
+ * Timer заодно пишет спан трассировки, если текущий апдейт попал в выборку
+ * (Tracing.h).
+ */
+
+class LatencyHistogram {
+public:
+    static constexpr int subBits = 4;
+    static constexpr uint64_t subBuckets = 1 << subBits;
+    static constexpr int maxExponent = 42;      // 2^42 нс ≈ 73 минуты
+    static constexpr size_t bucketCount = subBuckets * (maxExponent - subBits + 2);
+
+    explicit LatencyHistogram(const char* category_ = "", std::string name_ = "")
+            : family(category_), label(std::move(name_)) {}
+
+    // Категория и имя спана трассировки: метрика семейства и метка ряда
+    const char* category() const {
+        return family;
+    }
+
+    const std::string& name() const {
+        return label;
+    }
+
+    struct Snapshot {
+        uint64_t count = 0;
+        uint64_t failures = 0;
+        uint64_t sum = 0;       // нс
+        uint64_t max = 0;       // нс
+        std::array<uint64_t, bucketCount> buckets{};
+
+        // Верхняя граница корзины, в которую попал квантиль q, нс
+        uint64_t quantile(double q) const {
+            if (count == 0)
+                return 0;
+            uint64_t rank = static_cast<uint64_t>(q * static_cast<double>(count - 1)) + 1;
+            uint64_t seen = 0;
+            for (size_t i = 0; i < bucketCount; ++i) {
+                seen += buckets[i];
+                if (seen >= rank)
+                    return std::min(upperBound(i), max);
+            }
+            return max;
+        }
+    };
+
+    void record(uint64_t nanoseconds, bool failed = false) {
+        buckets[index(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+        sum.fetch_add(nanoseconds, std::memory_order_relaxed);
+        if (failed)
+            failures.fetch_add(1, std::memory_order_relaxed);
+        uint64_t seen = max.load(std::memory_order_relaxed);
+        while (nanoseconds > seen && !max.compare_exchange_weak(seen, nanoseconds, std::memory_order_relaxed)) {}
+    }
+
+    // Счётчики читаются по отдельности: снимок под нагрузкой согласован лишь приблизительно
+    Snapshot snapshot() const {
+        Snapshot out;
+        for (size_t i = 0; i < bucketCount; ++i) {
+            out.buckets[i] = buckets[i].load(std::memory_order_relaxed);
+            out.count += out.buckets[i];
+        }
+        out.failures = failures.load(std::memory_order_relaxed);
+        out.sum = sum.load(std::memory_order_relaxed);
+        out.max = max.load(std::memory_order_relaxed);
+        return out;
+    }
+
+    static size_t index(uint64_t value) {
+        if (value < subBuckets)
+            return static_cast<size_t>(value);
+        int exponent = highestBit(value);
+        if (exponent > maxExponent)
+            return bucketCount - 1;
+        uint64_t sub = (value >> (exponent - subBits)) & (subBuckets - 1);
+        return static_cast<size_t>(subBuckets * (exponent - subBits + 1) + sub);
+    }
+
+    // Первое значение следующей корзины
+    static uint64_t upperBound(size_t index) {
+        if (index + 1 < subBuckets)
+            return index + 1;
+        size_t next = index + 1;
+        int exponent = static_cast<int>(next / subBuckets) + subBits - 1;
+        return (subBuckets + next % subBuckets) << (exponent - subBits);
+    }
+
+private:
+    static int highestBit(uint64_t value) {
+#ifdef _MSC_VER
+        unsigned long bit;
+        _BitScanReverse64(&bit, value);
+        return static_cast<int>(bit);
+#else
+        return 63 - __builtin_clzll(value);
+#endif
+    }
+
+    const char* const family;
+    const std::string label;
+    // Общего счётчика нет: число замеров — сумма корзин, на запись на один атомик меньше
+    std::array<std::atomic<uint64_t>, bucketCount> buckets{};
+    std::atomic<uint64_t> failures{0};
+    std::atomic<uint64_t> sum{0};
+    std::atomic<uint64_t> max{0};
+};
+
+class Metrics {
+public:
+    enum class Family { Command, Message, Callback, Sql, Disk, Telegram };
+
+    // Замер от создания до разрушения; исключение или fail() считается ошибкой
+    class Timer {
+    public:
+        explicit Timer(LatencyHistogram& histogram_)
+                : histogram(histogram_), start(std::chrono::steady_clock::now()),
+                  exceptions(std::uncaught_exceptions()), span(histogram_.category(), histogram_.name(), start) {}
+
+        ~Timer() {
+            auto end = std::chrono::steady_clock::now();
+            histogram.record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count()),
+                             failed || std::uncaught_exceptions() > exceptions);
+            span.finish(end);
+        }
+
+        Timer(const Timer&) = delete;
+        Timer& operator=(const Timer&) = delete;
+
+        void fail() {
+            failed = true;
+        }
+
+    private:
+        LatencyHistogram& histogram;
+        const std::chrono::steady_clock::time_point start;
+        const int exceptions;
+        bool failed = false;
+        Tracer::Scope span;
+    };
+
+    // Счётчик или показатель подсистемы со своей статистикой
+    struct Value {
+        const char* metric;     // имя ряда без префикса tg_bot_
+        const char* type;       // counter или gauge
+        const char* help;
+        std::string caption;    // подпись в /stats
+        double value;
+        double scale = 1;       // множитель для /stats: байты -> МБ
+        std::string labels;     // метки ряда без скобок, см. label()
+    };
+    using Collector = std::function<std::vector<Value>()>;
+
+    static Metrics& instance() {
+        static Metrics metrics;
+        return metrics;
+    }
+
+    // Ссылка стабильна до конца процесса — её стоит запомнить
+    LatencyHistogram& histogram(Family family, const std::string& label) {
+        auto key = std::make_pair(family, label);
+        {
+            std::shared_lock<std::shared_mutex> lock(mutex);
+            auto it = histograms.find(key);
+            if (it != histograms.end())
+                return *it->second;
+        }
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        auto& slot = histograms[key];
+        if (!slot)
+            slot = std::make_unique<LatencyHistogram>(describe(family).metric, label);
+        return *slot;
+    }
+
+    // Метка ряда для Value::labels: host="api.telegram.org"
+    static std::string label(const char* name, const std::string& value) {
+        return fmt::format("{}=\"{}\"", name, escape(value));
+    }
+
+    // Опрашивается при каждой выдаче /metrics и /stats; источник должен жить, пока они отвечают
+    void addCollector(std::string title, Collector collect) {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        collectors.emplace_back(std::move(title), std::move(collect));
+    }
+
+    // Текстовый формат Prometheus 0.0.4
+    std::string prometheus() const {
+        static const double bounds[] = {0.0001, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05,
+                                        0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30, 60};
+        auto rows = collect();
+        std::string out;
+        for (size_t begin = 0, end = 0; begin < rows.size(); begin = end) {
+            Family family = std::get<0>(rows[begin]);
+            while (end < rows.size() && std::get<0>(rows[end]) == family)
+                ++end;
+            const Info& info = describe(family);
+
+            out += fmt::format("# HELP tg_bot_{0}_seconds {1}\n# TYPE tg_bot_{0}_seconds histogram\n", info.metric, info.help);
+            for (size_t i = begin; i < end; ++i) {
+                const auto& snapshot = std::get<2>(rows[i]);
+                std::string labels = fmt::format("{}=\"{}\"", info.label, escape(std::get<1>(rows[i])));
+                uint64_t cumulative = 0;
+                size_t bucket = 0;
+                for (double bound : bounds) {
+                    auto limit = static_cast<uint64_t>(bound * 1e9);
+                    for (; bucket < LatencyHistogram::bucketCount && LatencyHistogram::upperBound(bucket) <= limit; ++bucket)
+                        cumulative += snapshot.buckets[bucket];
+                    out += fmt::format("tg_bot_{}_seconds_bucket{{{},le=\"{}\"}} {}\n", info.metric, labels, bound, cumulative);
+                }
+                out += fmt::format("tg_bot_{}_seconds_bucket{{{},le=\"+Inf\"}} {}\n", info.metric, labels, snapshot.count);
+                out += fmt::format("tg_bot_{}_seconds_sum{{{}}} {:.9f}\n", info.metric, labels, snapshot.sum / 1e9);
+                out += fmt::format("tg_bot_{}_seconds_count{{{}}} {}\n", info.metric, labels, snapshot.count);
+            }
+
+            out += fmt::format("# HELP tg_bot_{0}_failures_total Failed or thrown {0} calls.\n"
+                               "# TYPE tg_bot_{0}_failures_total counter\n", info.metric);
+            for (size_t i = begin; i < end; ++i) {
+                out += fmt::format("tg_bot_{}_failures_total{{{}=\"{}\"}} {}\n", info.metric, info.label,
+                                   escape(std::get<1>(rows[i])), std::get<2>(rows[i]).failures);
+            }
+        }
+        // Ряды одной метрики с разными метками идут подряд под одним HELP/TYPE
+        std::vector<Value> values;
+        for (const auto& [title, collect] : sources()) {
+            auto collected = collect();
+            values.insert(values.end(), std::make_move_iterator(collected.begin()), std::make_move_iterator(collected.end()));
+        }
+        std::stable_sort(values.begin(), values.end(), [](const Value& a, const Value& b) {
+            return std::strcmp(a.metric, b.metric) < 0;
+        });
+        for (size_t i = 0; i < values.size(); ++i) {
+            const Value& value = values[i];
+            if (i == 0 || std::strcmp(values[i - 1].metric, value.metric) != 0)
+                out += fmt::format("# HELP tg_bot_{0} {1}\n# TYPE tg_bot_{0} {2}\n", value.metric, value.help, value.type);
+            out += value.labels.empty() ? fmt::format("tg_bot_{} {}\n", value.metric, value.value)
+                                        : fmt::format("tg_bot_{}{{{}}} {}\n", value.metric, value.labels, value.value);
+        }
+        return out;
+    }
+
+    // По limit самых частых рядов каждого семейства: число вызовов, p50/p99/max, ошибки
+    std::string summary(size_t limit = 5) const {
+        auto rows = collect();
+        std::stable_sort(rows.begin(), rows.end(), [](const Row& a, const Row& b) {
+            return std::get<0>(a) != std::get<0>(b) ? std::get<0>(a) < std::get<0>(b)
+                                                    : std::get<2>(a).count > std::get<2>(b).count;
+        });
+        std::string out;
+        size_t shown = 0;
+        for (size_t i = 0; i < rows.size(); ++i) {
+            const auto& [family, label, snapshot] = rows[i];
+            if (i == 0 || std::get<0>(rows[i - 1]) != family) {
+                out += fmt::format("\n{}:\n", describe(family).title);
+                shown = 0;
+            }
+            if (snapshot.count == 0 || shown++ >= limit)
+                continue;
+            out += fmt::format("{} — {}, p50 {} / p99 {} / max {}{}\n",
+                               label.size() > 48 ? label.substr(0, 45) + "..." : label, snapshot.count,
+                               duration(snapshot.quantile(0.5)), duration(snapshot.quantile(0.99)), duration(snapshot.max),
+                               snapshot.failures ? fmt::format(", ошибок {}", snapshot.failures) : "");
+        }
+        // Ряды с другими метками (другой хост) — с новой строки
+        for (const auto& [title, collect] : sources()) {
+            std::string line;
+            const std::string* labels = nullptr;
+            for (const auto& value : collect()) {
+                const char* separator = !labels ? "" : *labels != value.labels ? "\n" : ", ";
+                line += fmt::format("{}{}: {:.0f}", separator, value.caption, value.value * value.scale);
+                labels = &value.labels;
+            }
+            out += fmt::format("\n{}:\n{}\n", title, line);
+        }
+        return out.empty() ? "Замеров пока нет" : out.substr(1);
+    }
+
+private:
+    struct Info {
+        const char* metric;
+        const char* label;
+        const char* help;
+        const char* title;
+    };
+
+    using Row = std::tuple<Family, std::string, LatencyHistogram::Snapshot>;
+
+    static const Info& describe(Family family) {
+        static const Info infos[] = {
+                {"command", "command", "Command execution time.", "Команды"},
+                {"message", "command", "Dialog message handling time by the owning command.", "Сообщения в диалогах"},
+                {"callback", "type", "Callback query handling time.", "Кнопки"},
+                {"sql", "statement", "Time a prepared statement is held, from acquire to reset.", "SQL"},
+                {"disk", "call", "Yandex Disk call time.", "Яндекс Диск"},
+                {"telegram", "method", "Bot API call time.", "Bot API"},
+        };
+        return infos[static_cast<size_t>(family)];
+    }
+
+    // Копия списка: источники опрашиваются без блокировки гистограмм
+    std::vector<std::pair<std::string, Collector>> sources() const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        return collectors;
+    }
+
+    std::vector<Row> collect() const {
+        std::vector<Row> rows;
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        rows.reserve(histograms.size());
+        for (const auto& [key, histogram] : histograms)
+            rows.emplace_back(key.first, key.second, histogram->snapshot());
+        return rows;
+    }
+
+    static std::string duration(uint64_t nanoseconds) {
+        if (nanoseconds < 1000000)
+            return fmt::format("{} мкс", nanoseconds / 1000);
+        if (nanoseconds < 10000000000ULL)
+            return fmt::format("{:.1f} мс", nanoseconds / 1e6);
+        return fmt::format("{:.1f} с", nanoseconds / 1e9);
+    }
+
+    static std::string escape(const std::string& value) {
+        std::string out;
+        for (char c : value) {
+            if (c == '\\' || c == '"')
+                out += '\\';
+            if (c == '\n')
+                out += "\\n";
+            else
+                out += c;
+        }
+        return out;
+    }
+
+    mutable std::shared_mutex mutex;
+    std::map<std::pair<Family, std::string>, std::unique_ptr<LatencyHistogram>> histograms;
+    std::vector<std::pair<std::string, Collector>> collectors;
+};
+
+#endif // TG_BOT_METRICS_H
@@ -0,0 +1,112 @@
+#ifndef TG_BOT_PIPELINESTAGE_H
+#define TG_BOT_PIPELINESTAGE_H
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Ступень конвейера: ограниченная очередь и свой пул потоков.
+ * push ждёт места в очереди — так медленная следующая ступень притормаживает
+ * предыдущую; tryPush не ждёт и годится для потоков, которые нельзя занимать.
+ * stop() дорабатывает уже принятые задания и останавливает потоки.
+ */
+
+template<typename Job>
+class PipelineStage {
+public:
+    using Handler = std::function<void(Job&)>;
+
+    PipelineStage(std::string name_, size_t threads, size_t capacity_, Handler handler_)
+            : name(std::move(name_)), capacity(capacity_), handler(std::move(handler_)) {
+        for (size_t i = 0; i < threads; ++i)
+            workers.emplace_back(&PipelineStage::run, this);
+    }
+
+    ~PipelineStage() {
+        stop();
+    }
+
+    PipelineStage(const PipelineStage&) = delete;
+    PipelineStage& operator=(const PipelineStage&) = delete;
+
+    bool push(Job job) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [this] { return stopping || queue.size() < capacity; });
+        if (stopping)
+            return false;
+        queue.push_back(std::move(job));
+        notEmpty.notify_one();
+        return true;
+    }
+
+    bool tryPush(Job job) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopping || queue.size() >= capacity)
+            return false;
+        queue.push_back(std::move(job));
+        notEmpty.notify_one();
+        return true;
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return queue.size();
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        notEmpty.notify_all();
+        notFull.notify_all();
+        for (auto& worker : workers) {
+            if (worker.joinable())
+                worker.join();
+        }
+    }
+
+private:
+    void run() {
+        while (true) {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                notEmpty.wait(lock, [this] { return stopping || !queue.empty(); });
+                if (queue.empty())
+                    return; // остановка и очередь разобрана
+                job = std::move(queue.front());
+                queue.pop_front();
+                notFull.notify_one();
+            }
+
+            try {
+                handler(job);
+            } catch (const std::exception& e) {
+                std::cerr << "Pipeline stage " << name << " error: " << e.what() << std::endl;
+            }
+        }
+    }
+
+    const std::string name;
+    const size_t capacity;
+    Handler handler;
+
+    mutable std::mutex mutex;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+    std::deque<Job> queue;
+    bool stopping = false;
+    std::vector<std::thread> workers;
+};
+
+#endif // TG_BOT_PIPELINESTAGE_H
@@ -0,0 +1,213 @@
+#ifndef TG_BOT_PUBLICLINKS_H
+#define TG_BOT_PUBLICLINKS_H
+
+#pragma once
+
+#include <sqlite3.h>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "Database.h"
+#include "DiskApi.h"
+
+/**
+ * Публичные ссылки на книги, которые слишком велики для отправки документом.
+ * Ссылка публикуется один раз и хранится в book_links вместе со временем
+ * публикации; повторные нажатия берут её из базы без обращения к диску.
+ * Хранится постоянный public_url: подписанная ссылка на скачивание
+ * истекает через несколько часов и в базе быстро стала бы нерабочей.
+ * Запись сбрасывается invalidate() (файл на диске сменился или удалён) или
+ * по возрасту, если задан maxAge.
+ *
+ * Фоновый поток раз в interval публикует ссылки для самых запрашиваемых
+ * больших книг, у которых их ещё нет, — первое нажатие тоже не ждёт диска.
+ */
+
+class PublicLinks {
+public:
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t published = 0;
+        uint64_t prepublished = 0;
+    };
+
+    // maxAge = 0 — ссылка живёт до явного invalidate()
+    PublicLinks(Database& db_, DiskApi& api_, int64_t minSize_,
+                std::chrono::seconds maxAge_ = std::chrono::seconds(0))
+            : db(db_), api(api_), minSize(minSize_), maxAge(maxAge_) {}
+
+    ~PublicLinks() {
+        stop();
+    }
+
+    PublicLinks(const PublicLinks&) = delete;
+    PublicLinks& operator=(const PublicLinks&) = delete;
+
+    // Ссылка из базы или, если её нет, только что опубликованная; пустая — публикация не удалась
+    std::string get(int bookId, const std::string& path) {
+        std::string link = lookup(bookId);
+        if (!link.empty()) {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++counters.hits;
+            return link;
+        }
+        link = publish(bookId, path);
+        if (!link.empty()) {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++counters.published;
+        }
+        return link;
+    }
+
+    void invalidate(int bookId) {
+        db.write([this, bookId] {
+            auto stmt = db.statements().acquire("DELETE FROM book_links WHERE book_id = ?;");
+            if (!stmt)
+                return false;
+            sqlite3_bind_int(stmt, 1, bookId);
+            if (sqlite3_step(stmt) != SQLITE_DONE) {
+                std::cerr << "Failed to drop public link: " << db.errmsg() << std::endl;
+                return false;
+            }
+            return true;
+        });
+    }
+
+    // Предпубликация top самых запрашиваемых больших книг раз в interval
+    void start(std::chrono::minutes interval, int top) {
+        worker = std::thread([this, interval, top] {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (!stopping) {
+                lock.unlock();
+                prepublish(top);
+                lock.lock();
+                wake.wait_for(lock, interval, [this] { return stopping; });
+            }
+        });
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        if (worker.joinable())
+            worker.join();
+    }
+
+    // Публикует недостающие ссылки для top книг; возвращает число опубликованных
+    int prepublish(int top) {
+        std::vector<std::pair<int, std::string>> books;
+        {
+            auto reader = db.read();
+            auto stmt = reader.statements().acquire(
+                    "SELECT b.id, b.file_path FROM books b LEFT JOIN book_links l ON l.book_id = b.id"
+                    " WHERE b.size > ? AND b.request_count > 0 AND (l.book_id IS NULL OR l.published_at < ?)"
+                    " ORDER BY b.request_count DESC LIMIT ?;");
+            if (!stmt)
+                return 0;
+            sqlite3_bind_int64(stmt, 1, minSize);
+            sqlite3_bind_int64(stmt, 2, oldest());
+            sqlite3_bind_int(stmt, 3, top);
+            while (sqlite3_step(stmt) == SQLITE_ROW)
+                books.emplace_back(sqlite3_column_int(stmt, 0), text(stmt, 1));
+        }
+
+        int published = 0;
+        for (const auto& [bookId, path] : books) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (stopping)
+                    break;
+            }
+            try {
+                if (!publish(bookId, path).empty())
+                    ++published;
+            } catch (const std::exception& e) {
+                std::cerr << "Failed to prepublish " << path << ": " << e.what() << std::endl;
+            }
+        }
+        if (published > 0) {
+            std::lock_guard<std::mutex> lock(mutex);
+            counters.prepublished += published;
+            std::cout << "Prepublished " << published << " public links" << std::endl;
+        }
+        return published;
+    }
+
+    Stats stats() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return counters;
+    }
+
+private:
+    std::string lookup(int bookId) {
+        auto reader = db.read();
+        auto stmt = reader.statements().acquire("SELECT link FROM book_links WHERE book_id = ? AND published_at >= ?;");
+        if (!stmt)
+            return "";
+        sqlite3_bind_int(stmt, 1, bookId);
+        sqlite3_bind_int64(stmt, 2, oldest());
+        return sqlite3_step(stmt) == SQLITE_ROW ? text(stmt, 0) : "";
+    }
+
+    std::string publish(int bookId, const std::string& path) {
+        std::string link = api.publish(path);
+        if (link.empty()) {
+            std::cerr << "Disk returned no public link for " << path << std::endl;
+            return link;
+        }
+
+        db.write([this, bookId, link, publishedAt = now()] {
+            auto stmt = db.statements().acquire(
+                    "INSERT INTO book_links (book_id, link, published_at) VALUES (?, ?, ?)"
+                    " ON CONFLICT(book_id) DO UPDATE SET link = excluded.link, published_at = excluded.published_at;");
+            if (!stmt)
+                return false;
+            sqlite3_bind_int(stmt, 1, bookId);
+            sqlite3_bind_text(stmt, 2, link.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_int64(stmt, 3, publishedAt);
+            if (sqlite3_step(stmt) != SQLITE_DONE) {
+                std::cerr << "Failed to store public link: " << db.errmsg() << std::endl;
+                return false;
+            }
+            return true;
+        });
+        return link;
+    }
+
+    // Ссылки, опубликованные раньше этого момента, считаются устаревшими
+    int64_t oldest() const {
+        return maxAge.count() > 0 ? now() - maxAge.count() : 0;
+    }
+
+    static int64_t now() {
+        return std::chrono::duration_cast<std::chrono::seconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    static std::string text(sqlite3_stmt* stmt, int column) {
+        const unsigned char* value = sqlite3_column_text(stmt, column);
+        return value ? reinterpret_cast<const char*>(value) : "";
+    }
+
+    Database& db;
+    DiskApi& api;
+    const int64_t minSize;
+    const std::chrono::seconds maxAge;
+
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    Stats counters;
+    bool stopping = false;
+    std::thread worker;
+};
+
+#endif // TG_BOT_PUBLICLINKS_H
@@ -0,0 +1,182 @@
+#ifndef TG_BOT_REQUESTCOUNTERS_H
+#define TG_BOT_REQUESTCOUNTERS_H
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include "Database.h"
+
+/**
+ * Отложенная запись счётчиков популярности (авторы, темы, книги).
+ * Инкременты копятся в памяти и пишутся одной транзакцией раз в flushInterval
+ * или по достижении maxPending событий; остаток сбрасывается при остановке.
+ * Транзакция выполняется в потоке записи базы, чтение каталога её не ждёт.
+ * Читающие пути база не спрашивают: актуальные значения держат рейтинги
+ * в памяти (Leaderboard), которые обновляются тем же инкрементом.
+ */
+
+class RequestCounters {
+public:
+    enum class Kind { Author = 0, Topic = 1, Book = 2 };
+    using Deltas = std::unordered_map<std::string, int64_t>;
+
+    explicit RequestCounters(Database& db_,
+                             std::chrono::milliseconds flushInterval_ = std::chrono::milliseconds(500),
+                             size_t maxPending_ = 256)
+            : db(db_), flushInterval(flushInterval_), maxPending(maxPending_),
+              worker(&RequestCounters::run, this) {}
+
+    ~RequestCounters() {
+        stop();
+    }
+
+    RequestCounters(const RequestCounters&) = delete;
+    RequestCounters& operator=(const RequestCounters&) = delete;
+
+    void increment(Kind kind, const std::string& key) {
+        bool full;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++queued[index(kind)][key];
+            full = ++pendingEvents >= maxPending;
+        }
+        if (full)
+            wake.notify_one();
+    }
+
+    // Пока возвращённая блокировка жива, сброс не начнётся и не идёт: база плюс
+    // pending() дают каждый инкремент ровно один раз
+    std::unique_lock<std::mutex> pauseFlush() {
+        return std::unique_lock<std::mutex>(flushMutex);
+    }
+
+    // Ещё не записанные инкременты ключа; вызывать под pauseFlush()
+    int64_t pending(Kind kind, const std::string& key) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = queued[index(kind)].find(key);
+        return it == queued[index(kind)].end() ? 0 : it->second;
+    }
+
+    void flush() {
+        std::lock_guard<std::mutex> flushLock(flushMutex);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (pendingEvents == 0)
+                return;
+            inflight.swap(queued);
+            pendingEvents = 0;
+        }
+
+        bool ok = db.writeSync([this] { return write(inflight); });
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!ok) {
+            // Не записали — возвращаем дельты в очередь до следующей попытки
+            for (size_t k = 0; k < inflight.size(); ++k) {
+                for (const auto& [key, delta] : inflight[k]) {
+                    queued[k][key] += delta;
+                    ++pendingEvents;
+                }
+            }
+        }
+        for (auto& deltas : inflight)
+            deltas.clear();
+    }
+
+    // Останавливает фоновый поток и записывает остаток
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        if (worker.joinable())
+            worker.join();
+        flush();
+    }
+
+private:
+    static size_t index(Kind kind) {
+        return static_cast<size_t>(kind);
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!stopping) {
+            wake.wait_for(lock, flushInterval, [this] { return stopping || pendingEvents >= maxPending; });
+            if (stopping)
+                break;
+            lock.unlock();
+            flush();
+            lock.lock();
+        }
+    }
+
+    bool write(const std::array<Deltas, 3>& deltas) {
+        static const char* sql[] = {
+                "INSERT INTO author_requests (author, request_count) VALUES (?, ?) "
+                "ON CONFLICT(author) DO UPDATE SET request_count = request_count + excluded.request_count;",
+                "INSERT INTO topic_requests (topic, request_count) VALUES (?, ?) "
+                "ON CONFLICT(topic) DO UPDATE SET request_count = request_count + excluded.request_count;",
+                "UPDATE books SET request_count = request_count + ?2 WHERE title = ?1;"
+        };
+
+        if (sqlite3_exec(db.handle(), "BEGIN IMMEDIATE;", nullptr, nullptr, nullptr) != SQLITE_OK) {
+            std::cerr << "Failed to begin counters flush: " << db.errmsg() << std::endl;
+            return false;
+        }
+
+        bool ok = true;
+        for (size_t k = 0; k < deltas.size() && ok; ++k) {
+            for (const auto& [key, delta] : deltas[k]) {
+                auto stmt = db.statements().acquire(sql[k]);
+                if (!stmt) {
+                    ok = false;
+                    break;
+                }
+                sqlite3_bind_text(stmt, 1, key.c_str(), -1, SQLITE_TRANSIENT);
+                sqlite3_bind_int64(stmt, 2, delta);
+                if (sqlite3_step(stmt) != SQLITE_DONE) {
+                    ok = false;
+                    break;
+                }
+            }
+        }
+
+        if (!ok) {
+            std::cerr << "Failed to update requests: " << db.errmsg() << std::endl;
+            sqlite3_exec(db.handle(), "ROLLBACK;", nullptr, nullptr, nullptr);
+            return false;
+        }
+        if (sqlite3_exec(db.handle(), "COMMIT;", nullptr, nullptr, nullptr) != SQLITE_OK) {
+            std::cerr << "Failed to commit counters flush: " << db.errmsg() << std::endl;
+            sqlite3_exec(db.handle(), "ROLLBACK;", nullptr, nullptr, nullptr);
+            return false;
+        }
+        return true;
+    }
+
+    Database& db;
+    const std::chrono::milliseconds flushInterval;
+    const size_t maxPending;
+
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::array<Deltas, 3> queued;
+    std::array<Deltas, 3> inflight;
+    size_t pendingEvents = 0;
+    bool stopping = false;
+
+    std::mutex flushMutex;
+    std::thread worker;
+};
+
+#endif // TG_BOT_REQUESTCOUNTERS_H
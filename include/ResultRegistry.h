@@ -0,0 +1,147 @@
+#ifndef TG_BOT_RESULTREGISTRY_H
+#define TG_BOT_RESULTREGISTRY_H
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Реестр материализованных результатов поиска.
+ * Поиск один раз сохраняет упорядоченный список id книг под коротким
+ * хэндлом; кнопки листания несут только хэндл и номер страницы, а страница
+ * — это срез списка. Одинаковые запросы в течение reuseFor делят один
+ * результат. Хэндл живёт ttl с последнего обращения; при превышении
+ * maxHandles или maxIds вытесняются самые давно использованные.
+ */
+
+class ResultRegistry {
+public:
+    using Ids = std::shared_ptr<const std::vector<int>>;
+    using Clock = std::chrono::steady_clock;
+
+    struct Result {
+        std::string handle;
+        Ids ids;
+    };
+
+    explicit ResultRegistry(size_t maxHandles_ = 10000,
+                            size_t maxIds_ = 5000000,
+                            std::chrono::seconds ttl_ = std::chrono::minutes(30),
+                            std::chrono::seconds reuseFor_ = std::chrono::seconds(60))
+            : maxHandles(maxHandles_), maxIds(maxIds_), ttl(ttl_), reuseFor(reuseFor_),
+              sequence(std::random_device{}()) {}
+
+    // load вызывается без блокировки и только если свежего результата для queryKey нет
+    Result materialize(const std::string& queryKey, const std::function<std::vector<int>()>& load) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = byQuery.find(queryKey);
+            if (it != byQuery.end()) {
+                auto entry = entries.find(it->second);
+                if (entry != entries.end() && Clock::now() - entry->second.created < reuseFor) {
+                    touch(entry->second);
+                    return {entry->first, entry->second.ids};
+                }
+            }
+        }
+
+        auto ids = std::make_shared<const std::vector<int>>(load());
+
+        std::lock_guard<std::mutex> lock(mutex);
+        std::string handle = nextHandle();
+        auto now = Clock::now();
+        lru.push_front(handle);
+        entries[handle] = Entry{ids, queryKey, now, now, lru.begin()};
+        byQuery[queryKey] = handle;
+        totalIds += ids->size();
+        evict(now);
+        return {handle, ids};
+    }
+
+    Ids find(const std::string& handle) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = entries.find(handle);
+        if (it == entries.end())
+            return nullptr;
+        if (Clock::now() - it->second.lastAccess > ttl) {
+            erase(it);
+            return nullptr;
+        }
+        touch(it->second);
+        return it->second.ids;
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return entries.size();
+    }
+
+private:
+    struct Entry {
+        Ids ids;
+        std::string queryKey;
+        Clock::time_point created;
+        Clock::time_point lastAccess;
+        std::list<std::string>::iterator lruPos;
+    };
+
+    void touch(Entry& entry) {
+        entry.lastAccess = Clock::now();
+        lru.splice(lru.begin(), lru, entry.lruPos);
+    }
+
+    void erase(std::unordered_map<std::string, Entry>::iterator it) {
+        auto query = byQuery.find(it->second.queryKey);
+        if (query != byQuery.end() && query->second == it->first)
+            byQuery.erase(query);
+        totalIds -= it->second.ids->size();
+        lru.erase(it->second.lruPos);
+        entries.erase(it);
+    }
+
+    // С хвоста LRU: просроченные и всё, что не влезает в лимиты
+    void evict(Clock::time_point now) {
+        while (!lru.empty()) {
+            auto it = entries.find(lru.back());
+            bool expired = now - it->second.lastAccess > ttl;
+            bool overLimit = entries.size() > maxHandles || (totalIds > maxIds && entries.size() > 1);
+            if (!expired && !overLimit)
+                break;
+            erase(it);
+        }
+    }
+
+    std::string nextHandle() {
+        static const char digits[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+        uint64_t value = sequence++;
+        std::string handle;
+        do {
+            handle += digits[value % 36];
+            value /= 36;
+        } while (value);
+        return handle;
+    }
+
+    const size_t maxHandles;
+    const size_t maxIds;
+    const std::chrono::seconds ttl;
+    const std::chrono::seconds reuseFor;
+
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, Entry> entries;
+    std::unordered_map<std::string, std::string> byQuery;
+    std::list<std::string> lru;
+    size_t totalIds = 0;
+    uint64_t sequence;
+};
+
+#endif // TG_BOT_RESULTREGISTRY_H
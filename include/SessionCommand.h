@@ -3,25 +3,64 @@
 #pragma once
 
 #include "ICommand.h"
-#include <unordered_map>
+#include "ActiveDialogs.h"
+#include "SessionStore.h"
+#include <memory>
+#include <string>
 
 /**
  * Базовый класс для диалоговых команд с поддержкой сессий.
  * Хранит user_id -> SessionState и вызывает handleSessionMessage.
+ * Сессии лежат в SessionStore: брошенный диалог истекает через ttl, а при
+ * переполнении вытесняются самые давние. Обработчик держит shared_ptr на
+ * сессию, поэтому вытеснение посреди апдейта ей не вредит. Session умеет
+ * save(SessionCodec&)/load(const SessionCodec&) для снимка в базу.
+ * Открытая сессия регистрируется в ActiveDialogs, который и направляет
+ * сюда сообщения пользователя.
  */
 
 template <typename Session>
 class SessionCommand : public ICommand {
 public:
-    std::unordered_map<int64_t, Session> sessions;
+    SessionCommand(const std::string& scope, ActiveDialogs& dialogs_)
+            : dialogs(dialogs_),
+              sessions(scope, dialogs_.options(),
+                       [](const Session& session) {
+                           SessionCodec codec;
+                           session.save(codec);
+                           return codec.str();
+                       },
+                       [](const std::string& data, Session& session) {
+                           SessionCodec codec;
+                           if (!codec.parse(data))
+                               return false;
+                           session.load(codec);
+                           return true;
+                       }) {}
 
     bool handleMessage(TgBot::Bot& bot, TgBot::Message::Ptr message) override {
-        int64_t userId = message->from->id;
-        auto it = sessions.find(userId);
-        if (it == sessions.end())
-            return false; // нет сессии — это не наша команда
+        auto session = sessions.find(message->from->id);
+        if (!session) {
+            dialogs.end(message->from->id, this); // сессия истекла раньше записи в индексе
+            return false;
+        }
 
-        return handleSessionMessage(bot, message, it->second);
+        return handleSessionMessage(bot, message, *session);
+    }
+
+    bool saveSessions(Database& db) override {
+        return sessions.save(db);
+    }
+
+    void cancelDialog(int64_t userId) override {
+        sessions.erase(userId);
+    }
+
+    size_t restoreSessions(Database& db) override {
+        size_t restored = sessions.restore(db);
+        for (int64_t userId : sessions.keys())
+            dialogs.begin(userId, this);
+        return restored;
     }
 
 protected:
@@ -29,6 +68,21 @@ protected:
     virtual bool handleSessionMessage(TgBot::Bot& bot,
                                       TgBot::Message::Ptr message,
                                       Session& session) = 0;
+
+    // Возвращает сессию пользователя, создавая её при необходимости
+    std::shared_ptr<Session> startSession(int64_t userId) {
+        dialogs.begin(userId, this);
+        return sessions.start(userId);
+    }
+
+    void finishSession(int64_t userId) {
+        sessions.erase(userId);
+        dialogs.end(userId, this);
+    }
+
+private:
+    ActiveDialogs& dialogs;
+    SessionStore<Session> sessions;
 };
 
 #endif // TG_BOT_SESSIONCOMMAND_H
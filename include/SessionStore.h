@@ -0,0 +1,337 @@
+#ifndef TG_BOT_SESSIONSTORE_H
+#define TG_BOT_SESSIONSTORE_H
+
+#pragma once
+
+#include <sqlite3.h>
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "Database.h"
+
+// Общие для всех хранилищ ограничения: время жизни записи и их предельное число
+struct SessionOptions {
+    std::chrono::seconds ttl = std::chrono::minutes(30);
+    size_t maxEntries = 100000;
+};
+
+// Поля сессии в JSON для снимка в SQLite
+class SessionCodec {
+public:
+    template<typename T>
+    void set(const std::string& name, const T& value) {
+        tree.put(name, value);
+    }
+
+    template<typename T>
+    T get(const std::string& name, const T& fallback) const {
+        return tree.get<T>(name, fallback);
+    }
+
+    std::string str() const {
+        std::ostringstream out;
+        boost::property_tree::write_json(out, tree, false);
+        return out.str();
+    }
+
+    bool parse(const std::string& data) {
+        try {
+            std::istringstream in(data);
+            boost::property_tree::read_json(in, tree);
+            return true;
+        } catch (const std::exception&) {
+            return false;
+        }
+    }
+
+private:
+    boost::property_tree::ptree tree;
+};
+
+/**
+ * Состояние пользователей (диалоги команд, позиции страниц) с временем жизни.
+ * Каждое обращение продлевает запись на ttl; просроченные снимает
+ * хэшированное колесо таймеров — слот на секунду, колесо проворачивается
+ * при обращениях к хранилищу, так что отдельный поток не нужен. Сверх
+ * maxEntries вытесняются записи, к которым дольше всего не обращались.
+ *
+ * Значения отдаются через shared_ptr: запись, вытесненная или просроченная
+ * во время обработки апдейта, доживает до конца обработчика.
+ * save()/restore() сохраняют живые записи в таблицу sessions, чтобы диалоги
+ * пережили перезапуск; save() вызывается, когда обработчики уже остановлены.
+ */
+
+template<typename Value>
+class SessionStore {
+public:
+    using Encode = std::function<std::string(const Value&)>;
+    using Decode = std::function<bool(const std::string&, Value&)>;
+
+    struct Stats {
+        size_t entries = 0;
+        uint64_t expired = 0;
+        uint64_t evicted = 0;
+    };
+
+    SessionStore(std::string scope_, const SessionOptions& options_, Encode encode_ = nullptr, Decode decode_ = nullptr)
+            : scope(std::move(scope_)), options(options_), encode(std::move(encode_)), decode(std::move(decode_)),
+              wheel(wheelSlots) {}
+
+    SessionStore(const SessionStore&) = delete;
+    SessionStore& operator=(const SessionStore&) = delete;
+
+    // Запись пользователя с продлением срока; nullptr — нет или истекла
+    std::shared_ptr<Value> find(int64_t key) {
+        std::lock_guard<std::mutex> lock(mutex);
+        int64_t now = clock();
+        advance(now);
+        auto it = entries.find(key);
+        if (it == entries.end())
+            return nullptr;
+        touch(it->second, now);
+        return it->second.value;
+    }
+
+    // Существующая запись или новая со значением по умолчанию
+    std::shared_ptr<Value> start(int64_t key) {
+        std::lock_guard<std::mutex> lock(mutex);
+        int64_t now = clock();
+        advance(now);
+        auto it = entries.find(key);
+        if (it != entries.end()) {
+            touch(it->second, now);
+            return it->second.value;
+        }
+        return insert(key, std::make_shared<Value>(), now + options.ttl.count());
+    }
+
+    void put(int64_t key, Value value) {
+        std::lock_guard<std::mutex> lock(mutex);
+        int64_t now = clock();
+        advance(now);
+        auto it = entries.find(key);
+        if (it != entries.end()) {
+            it->second.value = std::make_shared<Value>(std::move(value));
+            touch(it->second, now);
+            return;
+        }
+        insert(key, std::make_shared<Value>(std::move(value)), now + options.ttl.count());
+    }
+
+    void erase(int64_t key) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = entries.find(key);
+        if (it == entries.end())
+            return;
+        lru.erase(it->second.lruPos);
+        entries.erase(it);
+    }
+
+    std::vector<int64_t> keys() {
+        std::lock_guard<std::mutex> lock(mutex);
+        advance(clock());
+        std::vector<int64_t> result;
+        result.reserve(entries.size());
+        for (const auto& [key, entry] : entries)
+            result.push_back(key);
+        return result;
+    }
+
+    Stats stats() {
+        std::lock_guard<std::mutex> lock(mutex);
+        advance(clock());
+        return {entries.size(), expiredCount, evictedCount};
+    }
+
+    // Заменяет снимок этого хранилища живыми записями (одна транзакция в потоке записи базы)
+    bool save(Database& db) {
+        if (!encode)
+            return false;
+        std::vector<std::pair<int64_t, std::pair<std::string, int64_t>>> rows;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            advance(clock());
+            rows.reserve(entries.size());
+            for (const auto& [key, entry] : entries)
+                rows.push_back({key, {encode(*entry.value), entry.expiresAt}});
+        }
+
+        return db.writeSync([this, &db, &rows] {
+            sqlite3* handle = db.handle();
+            if (sqlite3_exec(handle, "BEGIN;", nullptr, nullptr, nullptr) != SQLITE_OK)
+                return false;
+
+            bool ok = true;
+            {
+                auto stmt = db.statements().acquire("DELETE FROM sessions WHERE scope = ?;");
+                ok = stmt && sqlite3_bind_text(stmt, 1, scope.c_str(), -1, SQLITE_TRANSIENT) == SQLITE_OK &&
+                     sqlite3_step(stmt) == SQLITE_DONE;
+            }
+            for (auto it = rows.begin(); ok && it != rows.end(); ++it) {
+                auto stmt = db.statements().acquire(
+                        "INSERT INTO sessions (scope, user_id, data, expires_at) VALUES (?, ?, ?, ?);");
+                if (!stmt) {
+                    ok = false;
+                    break;
+                }
+                sqlite3_bind_text(stmt, 1, scope.c_str(), -1, SQLITE_TRANSIENT);
+                sqlite3_bind_int64(stmt, 2, it->first);
+                sqlite3_bind_text(stmt, 3, it->second.first.c_str(), -1, SQLITE_TRANSIENT);
+                sqlite3_bind_int64(stmt, 4, it->second.second);
+                ok = sqlite3_step(stmt) == SQLITE_DONE;
+            }
+
+            if (!ok || sqlite3_exec(handle, "COMMIT;", nullptr, nullptr, nullptr) != SQLITE_OK) {
+                std::cerr << "Failed to save " << scope << " sessions: " << db.errmsg() << std::endl;
+                sqlite3_exec(handle, "ROLLBACK;", nullptr, nullptr, nullptr);
+                return false;
+            }
+            return true;
+        });
+    }
+
+    // Поднимает неистёкшие записи из снимка; возвращает их число
+    size_t restore(Database& db) {
+        if (!decode)
+            return 0;
+        std::lock_guard<std::mutex> lock(mutex);
+        int64_t now = clock();
+        advance(now);
+        auto reader = db.read();
+        auto stmt = reader.statements().acquire(
+                "SELECT user_id, data, expires_at FROM sessions WHERE scope = ? AND expires_at > ?"
+                " ORDER BY expires_at ASC;");
+        if (!stmt)
+            return 0;
+        sqlite3_bind_text(stmt, 1, scope.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int64(stmt, 2, now);
+
+        size_t restored = 0;
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            const unsigned char* data = sqlite3_column_text(stmt, 1);
+            auto value = std::make_shared<Value>();
+            if (!data || !decode(reinterpret_cast<const char*>(data), *value))
+                continue;
+            int64_t key = sqlite3_column_int64(stmt, 0);
+            if (entries.count(key))
+                continue;
+            // Срок из снимка, а не полный ttl от момента запуска
+            insert(key, std::move(value), std::min(now + options.ttl.count(),
+                                                   static_cast<int64_t>(sqlite3_column_int64(stmt, 2))));
+            ++restored;
+        }
+        return restored;
+    }
+
+private:
+    // Больше типичного ttl в секундах — запись обычно снимается с первого оборота
+    static constexpr size_t wheelSlots = 4096;
+
+    struct Entry {
+        std::shared_ptr<Value> value;
+        int64_t expiresAt = 0;
+        int64_t scheduledAt = 0;    // секунда, в слот которой запись положена в колесо
+        std::list<int64_t>::iterator lruPos;
+    };
+
+    struct Timer {
+        int64_t key;
+        int64_t at;
+    };
+
+    static int64_t clock() {
+        return std::chrono::duration_cast<std::chrono::seconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    // Вызывается под mutex
+    std::shared_ptr<Value> insert(int64_t key, std::shared_ptr<Value> value, int64_t expiresAt) {
+        lru.push_front(key);
+        Entry entry;
+        entry.value = std::move(value);
+        entry.expiresAt = expiresAt;
+        entry.lruPos = lru.begin();
+        auto& stored = entries.emplace(key, std::move(entry)).first->second;
+        schedule(key, stored);
+
+        while (entries.size() > options.maxEntries && lru.back() != key) {
+            entries.erase(lru.back());
+            lru.pop_back();
+            ++evictedCount;
+        }
+        return stored.value;
+    }
+
+    // Продление не трогает колесо: слот заметит новый срок и переложит запись
+    void touch(Entry& entry, int64_t now) {
+        entry.expiresAt = now + options.ttl.count();
+        lru.splice(lru.begin(), lru, entry.lruPos);
+    }
+
+    void schedule(int64_t key, Entry& entry) {
+        entry.scheduledAt = entry.expiresAt;
+        wheel[static_cast<size_t>(entry.expiresAt) % wheelSlots].push_back({key, entry.expiresAt});
+    }
+
+    // Обходит слоты секунд, прошедших с прошлого вызова, но не больше одного оборота.
+    // Текущая секунда ещё не закончилась, поэтому запись живёт не меньше ttl
+    void advance(int64_t now) {
+        int64_t due = now - 1;
+        if (lastTick == 0)
+            lastTick = due;
+        int64_t steps = std::min<int64_t>(due - lastTick, wheelSlots);
+        for (int64_t step = 1; step <= steps; ++step) {
+            auto& slot = wheel[static_cast<size_t>(lastTick + step) % wheelSlots];
+            std::vector<Timer> keep;
+            for (const Timer& timer : slot) {
+                auto it = entries.find(timer.key);
+                if (it == entries.end() || it->second.scheduledAt != timer.at)
+                    continue;               // запись удалена или переложена
+                if (timer.at > due) {
+                    keep.push_back(timer);  // срок на следующем обороте
+                } else if (it->second.expiresAt <= due) {
+                    lru.erase(it->second.lruPos);
+                    entries.erase(it);
+                    ++expiredCount;
+                } else {
+                    Timer moved{timer.key, it->second.expiresAt};
+                    it->second.scheduledAt = moved.at;
+                    size_t index = static_cast<size_t>(moved.at) % wheelSlots;
+                    if (&wheel[index] == &slot)
+                        keep.push_back(moved);
+                    else
+                        wheel[index].push_back(moved);
+                }
+            }
+            slot.swap(keep);
+        }
+        lastTick = std::max(lastTick, due);
+    }
+
+    const std::string scope;
+    const SessionOptions options;
+    const Encode encode;
+    const Decode decode;
+
+    std::mutex mutex;
+    std::unordered_map<int64_t, Entry> entries;
+    std::list<int64_t> lru;
+    std::vector<std::vector<Timer>> wheel;
+    int64_t lastTick = 0;
+    uint64_t expiredCount = 0;
+    uint64_t evictedCount = 0;
+};
+
+#endif // TG_BOT_SESSIONSTORE_H
@@ -5,11 +5,15 @@
 #include <fmt/core.h>
 #include <tgbot/tgbot.h>
 #include "ICommand.h"
+#include "TelegramOutbox.h"
 
 class StartCommand : public ICommand {
 public:
+    explicit StartCommand(TelegramOutbox& outbox_)
+            : outbox(outbox_) {}
+
     void execute(TgBot::Bot& bot, TgBot::Message::Ptr message) override {
-        bot.getApi().sendMessage(
+        outbox.sendMessage(
                 message->chat->id,
                 fmt::format(u8"*Добро пожаловать в электронную библиотеку, {}! \xF0\x9F\x98\x8A*\n\n"
                             "Мои возможности:\n\n"
@@ -21,13 +25,12 @@ public:
                             "*/find_by_author* - найти книгу по автору. Выдает список всех книг этого автора\n"
                             "*/find_by_topic* - найти книгу по теме. Выдает список наиболее подходящих книг по этой теме\n\n"
                             "Все эти команды также доступны по кнопке *меню* слева снизу. Enjoy!",
-                            message->from->firstName),
-                false,
-                0,
-                nullptr,
-                "Markdown"
+                            message->from->firstName), "Markdown"
         );
     }
+
+private:
+    TelegramOutbox& outbox;
 };
 
 #endif //TG_BOT_ELECTRONIC_LIBRARY_STARTCOMMAND_H
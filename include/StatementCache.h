@@ -0,0 +1,172 @@
+#ifndef TG_BOT_STATEMENTCACHE_H
+#define TG_BOT_STATEMENTCACHE_H
+
+#pragma once
+
+#include <sqlite3.h>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Metrics.h"
+
+/**
+ * Кэш подготовленных выражений одного соединения.
+ * Ключ — "форма" запроса (текст SQL или короткий ключ, по которому текст
+ * строится только при промахе). Выражение выдаётся во временное владение:
+ * пока Statement жив, им пользуется только один поток; при возврате оно
+ * сбрасывается (reset + clear_bindings) и ждёт следующего вызова.
+ * Все выражения финализируются в деструкторе кэша. Время от выдачи до
+ * возврата попадает в гистограмму SQL с меткой по ключу выражения и,
+ * если апдейт трассируется, в спан "sql".
+ */
+
+class StatementCache {
+public:
+    class Statement {
+    public:
+        Statement() = default;
+        Statement(std::vector<sqlite3_stmt*>* pool_, std::mutex* mutex_, sqlite3_stmt* stmt_, LatencyHistogram* timing_)
+                : pool(pool_), mutex(mutex_), stmt(stmt_), timing(timing_), start(std::chrono::steady_clock::now()),
+                  trace(Tracer::current()) {}
+
+        Statement(Statement&& other) noexcept
+                : pool(other.pool), mutex(other.mutex), stmt(other.stmt), timing(other.timing), start(other.start),
+                  trace(other.trace) {
+            other.stmt = nullptr;
+        }
+
+        Statement& operator=(Statement&& other) noexcept {
+            if (this != &other) {
+                release();
+                pool = other.pool;
+                mutex = other.mutex;
+                stmt = other.stmt;
+                timing = other.timing;
+                start = other.start;
+                trace = other.trace;
+                other.stmt = nullptr;
+            }
+            return *this;
+        }
+
+        Statement(const Statement&) = delete;
+        Statement& operator=(const Statement&) = delete;
+
+        ~Statement() {
+            release();
+        }
+
+        sqlite3_stmt* get() const { return stmt; }
+        operator sqlite3_stmt*() const { return stmt; }
+        explicit operator bool() const { return stmt != nullptr; }
+
+    private:
+        void release() {
+            if (!stmt)
+                return;
+            sqlite3_reset(stmt);
+            sqlite3_clear_bindings(stmt);
+            auto end = std::chrono::steady_clock::now();
+            timing->record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count()));
+            // Лист: выражения одного потока могут жить внахлёст, поэтому текущий спан не меняется
+            if (trace) {
+                auto& tracer = Tracer::instance();
+                tracer.record(trace.traceId, tracer.nextId(), trace.spanId, timing->category(), timing->name(), start, end);
+            }
+            std::lock_guard<std::mutex> lock(*mutex);
+            pool->push_back(stmt);
+            stmt = nullptr;
+        }
+
+        std::vector<sqlite3_stmt*>* pool = nullptr;
+        std::mutex* mutex = nullptr;
+        sqlite3_stmt* stmt = nullptr;
+        LatencyHistogram* timing = nullptr;
+        std::chrono::steady_clock::time_point start;
+        TraceContext trace;
+    };
+
+    explicit StatementCache(sqlite3* db_) : db(db_) {}
+
+    ~StatementCache() {
+        for (auto& [key, pool] : idle) {
+            for (auto* stmt : pool.statements)
+                sqlite3_finalize(stmt);
+        }
+    }
+
+    StatementCache(const StatementCache&) = delete;
+    StatementCache& operator=(const StatementCache&) = delete;
+
+    Statement acquire(const std::string& sql) {
+        return acquire(sql, [&sql] { return sql; });
+    }
+
+    // buildSql вызывается только при промахе, когда выражение нужно подготовить
+    Statement acquire(const std::string& key, const std::function<std::string()>& buildSql) {
+        Pool* pool;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pool = &idle[key];
+            if (!pool->statements.empty()) {
+                sqlite3_stmt* stmt = pool->statements.back();
+                pool->statements.pop_back();
+                hitCount.fetch_add(1, std::memory_order_relaxed);
+                return Statement(&pool->statements, &mutex, stmt, pool->timing);
+            }
+        }
+
+        missCount.fetch_add(1, std::memory_order_relaxed);
+        sqlite3_stmt* stmt = nullptr;
+        if (sqlite3_prepare_v3(db, buildSql().c_str(), -1, SQLITE_PREPARE_PERSISTENT, &stmt, nullptr) != SQLITE_OK) {
+            sqlite3_finalize(stmt);
+            return Statement();
+        }
+        {
+            // Гистограмма общая для всех соединений: ищем её только при подготовке
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!pool->timing)
+                pool->timing = &Metrics::instance().histogram(Metrics::Family::Sql, label(key));
+        }
+        return Statement(&pool->statements, &mutex, stmt, pool->timing);
+    }
+
+    uint64_t hits() const { return hitCount.load(std::memory_order_relaxed); }
+    uint64_t misses() const { return missCount.load(std::memory_order_relaxed); }
+
+private:
+    struct Pool {
+        std::vector<sqlite3_stmt*> statements;
+        LatencyHistogram* timing = nullptr;
+    };
+
+    // Пробелы и переводы строк SQL схлопываются, длинный текст обрезается
+    static std::string label(const std::string& key) {
+        std::string out;
+        for (char c : key) {
+            if (std::isspace(static_cast<unsigned char>(c))) {
+                if (!out.empty() && out.back() != ' ')
+                    out += ' ';
+            } else {
+                out += c;
+            }
+        }
+        if (out.size() > 96)
+            out = out.substr(0, 93) + "...";
+        return out;
+    }
+
+    sqlite3* db;
+    std::mutex mutex;
+    std::unordered_map<std::string, Pool> idle;
+    std::atomic<uint64_t> hitCount{0};
+    std::atomic<uint64_t> missCount{0};
+};
+
+#endif // TG_BOT_STATEMENTCACHE_H
@@ -0,0 +1,44 @@
+#ifndef TG_BOT_ELECTRONIC_LIBRARY_STATSCOMMAND_H
+#define TG_BOT_ELECTRONIC_LIBRARY_STATSCOMMAND_H
+
+#pragma once
+
+#include <cstdint>
+#include <set>
+#include "ICommand.h"
+#include "Metrics.h"
+#include "TelegramOutbox.h"
+
+/**
+ * /stats — сводка задержек из Metrics (только для администраторов):
+ * самые частые команды, кнопки, SQL-выражения, вызовы Диска и Bot API
+ * с числом вызовов, p50/p99/max и ошибками. Полный набор — на /metrics.
+ */
+
+class StatsCommand : public ICommand {
+public:
+    StatsCommand(TelegramOutbox& outbox_, std::set<int64_t> admins_)
+            : outbox(outbox_), admins(std::move(admins_)) {}
+
+    void execute(TgBot::Bot& bot, TgBot::Message::Ptr message) override {
+        int64_t chatId = message->chat->id;
+        if (!message->from || !admins.count(message->from->id)) {
+            outbox.sendMessage(chatId, "Команда доступна только администраторам");
+            return;
+        }
+
+        // Без разметки: в тексте SQL встречаются символы Markdown
+        std::string text = Metrics::instance().summary(5);
+        if (text.size() > maxMessageBytes)
+            text = text.substr(0, text.rfind('\n', maxMessageBytes)) + "\n...";
+        outbox.sendMessage(chatId, text);
+    }
+
+private:
+    static constexpr size_t maxMessageBytes = 4000;     // Bot API режет сообщения на 4096 символах
+
+    TelegramOutbox& outbox;
+    std::set<int64_t> admins;
+};
+
+#endif // TG_BOT_ELECTRONIC_LIBRARY_STATSCOMMAND_H
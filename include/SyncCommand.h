@@ -0,0 +1,62 @@
+#ifndef TG_BOT_ELECTRONIC_LIBRARY_SYNCCOMMAND_H
+#define TG_BOT_ELECTRONIC_LIBRARY_SYNCCOMMAND_H
+
+#pragma once
+
+#include <fmt/core.h>
+#include <cstdint>
+#include <set>
+#include "ICommand.h"
+#include "DiskSync.h"
+#include "TelegramOutbox.h"
+
+/**
+ * /sync — внеочередная синхронизация каталога с Яндекс Диском (только для администраторов).
+ * /sync full — полный обход без учёта сохранённого состояния папок.
+ * Итог приходит отдельным сообщением, когда обход закончится.
+ */
+
+class SyncCommand : public ICommand {
+public:
+    SyncCommand(DiskSync& sync_, TelegramOutbox& outbox_, std::set<int64_t> admins_)
+            : sync(sync_), outbox(outbox_), admins(std::move(admins_)) {}
+
+    void execute(TgBot::Bot& bot, TgBot::Message::Ptr message) override {
+        int64_t chatId = message->chat->id;
+        if (!message->from || !admins.count(message->from->id)) {
+            outbox.sendMessage(chatId, "Команда доступна только администраторам");
+            return;
+        }
+
+        bool full = message->text.find("full") != std::string::npos;
+        bool started = sync.trigger(full, [this, chatId](const DiskSync::Report& report) {
+            try { outbox.sendMessage(chatId, formatReport(report), "Markdown"); } catch (...) {}
+        });
+        outbox.sendMessage(chatId, started ? u8"🔄 Синхронизация с Яндекс Диском запущена"
+                                           : "Синхронизация уже выполняется, дождитесь её окончания");
+    }
+
+    static std::string formatReport(const DiskSync::Report& report) {
+        std::string text = fmt::format(
+                u8"*Синхронизация{} завершена* за {:.1f} с\n\n"
+                "Папок: {} (без изменений: {})\n"
+                "Книг на диске: {}\n"
+                "Добавлено: {}, обновлено: {}, удалено: {}\n"
+                "Запросов к API: {} (полный обход: {}, сэкономлено: {})",
+                report.full ? " (полная)" : "", report.seconds,
+                report.dirs, report.dirsUnchanged, report.files,
+                report.inserted, report.updated, report.removed,
+                report.apiCalls, report.fullCrawlCalls,
+                report.fullCrawlCalls > report.apiCalls ? report.fullCrawlCalls - report.apiCalls : 0);
+        if (!report.complete)
+            text += u8"\n\n⚠️ Часть папок прочитать не удалось, они будут перечитаны при следующем запуске";
+        return text;
+    }
+
+private:
+    DiskSync& sync;
+    TelegramOutbox& outbox;
+    std::set<int64_t> admins;
+};
+
+#endif // TG_BOT_ELECTRONIC_LIBRARY_SYNCCOMMAND_H
@@ -0,0 +1,96 @@
+#ifndef TG_BOT_TELEGRAMHTTPCLIENT_H
+#define TG_BOT_TELEGRAMHTTPCLIENT_H
+
+#pragma once
+
+#include <curl/curl.h>
+#include <tgbot/tgbot.h>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "HttpTransport.h"
+#include "Metrics.h"
+
+/**
+ * HTTP-клиент tgbot-cpp поверх общего HttpTransport. Клиенты библиотеки
+ * открывают соединение на каждый вызов (CurlHttpClient шлёт "Connection:
+ * close"), и мелкие запросы вроде answerCallbackQuery платят TCP+TLS
+ * рукопожатие. Здесь соединение с api.telegram.org одно на весь бот и
+ * переиспользуется. Аргументы без файлов уходят form-urlencoded, с файлами —
+ * multipart, как в CurlHttpClient.
+ */
+
+class TelegramHttpClient : public TgBot::HttpClient {
+public:
+    explicit TelegramHttpClient(HttpTransport& transport_)
+            : transport(transport_) {}
+
+    std::string makeRequest(const TgBot::Url& url, const std::vector<TgBot::HttpReqArg>& args) const override {
+        Metrics::Timer timer(Metrics::instance().histogram(Metrics::Family::Telegram,
+                                                           url.path.substr(url.path.rfind('/') + 1)));
+        CURL* curl = threadHandle();
+        curl_easy_reset(curl);
+        std::string address = url.protocol + "://" + url.host + url.path;
+        if (!url.query.empty())
+            address += "?" + url.query;
+
+        std::string form;
+        curl_mime* mime = nullptr;
+        bool hasFiles = false;
+        for (const auto& arg : args)
+            hasFiles = hasFiles || arg.isFile;
+        if (hasFiles) {
+            mime = curl_mime_init(curl);
+            for (const auto& arg : args) {
+                curl_mimepart* part = curl_mime_addpart(mime);
+                curl_mime_name(part, arg.name.c_str());
+                curl_mime_data(part, arg.value.data(), arg.value.size());
+                if (arg.isFile) {
+                    curl_mime_filename(part, arg.fileName.c_str());
+                    curl_mime_type(part, arg.mimeType.c_str());
+                }
+            }
+            curl_easy_setopt(curl, CURLOPT_MIMEPOST, mime);
+        } else if (!args.empty()) {
+            form = parser.generateWwwFormUrlencoded(args);
+            curl_easy_setopt(curl, CURLOPT_POSTFIELDS, form.c_str());
+        }
+
+        std::string body;
+        curl_easy_setopt(curl, CURLOPT_URL, address.c_str());
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, &TelegramHttpClient::write);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &body);
+        curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 20L);
+        curl_easy_setopt(curl, CURLOPT_TIMEOUT, static_cast<long>(_timeout));
+
+        CURLcode rc = transport.perform(curl);
+        curl_easy_setopt(curl, CURLOPT_MIMEPOST, nullptr);
+        curl_mime_free(mime);
+        if (rc != CURLE_OK)
+            throw std::runtime_error(std::string("Telegram request failed: ") + curl_easy_strerror(rc));
+        if (body.compare(0, 11, "{\"ok\":false") == 0)
+            timer.fail();
+        return body;
+    }
+
+private:
+    static size_t write(char* data, size_t size, size_t count, void* out) {
+        static_cast<std::string*>(out)->append(data, size * count);
+        return size * count;
+    }
+
+    struct Handle {
+        CURL* curl = curl_easy_init();
+        ~Handle() { curl_easy_cleanup(curl); }
+    };
+
+    static CURL* threadHandle() {
+        thread_local Handle handle;
+        return handle.curl;
+    }
+
+    HttpTransport& transport;
+    TgBot::HttpParser parser;
+};
+
+#endif // TG_BOT_TELEGRAMHTTPCLIENT_H
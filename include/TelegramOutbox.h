@@ -0,0 +1,508 @@
+#ifndef TG_BOT_TELEGRAMOUTBOX_H
+#define TG_BOT_TELEGRAMOUTBOX_H
+
+#pragma once
+
+#include <curl/curl.h>
+#include <tgbot/tgbot.h>
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "HttpTransport.h"
+#include "Metrics.h"
+#include "Tracing.h"
+
+// Ограничения Bot API: ~30 сообщений в секунду на бота и ~1 в секунду в один чат
+struct OutboxLimits {
+    double globalRate = 30;     // запросов в секунду на всего бота
+    double globalBurst = 30;
+    double chatRate = 1;        // в секунду на чат
+    double chatBurst = 3;
+    int maxRetries = 3;         // повторов после 429
+    std::chrono::milliseconds deleteDelay{50};  // ожидание соседних удалений для одного запроса
+};
+
+/**
+ * Все исходящие запросы к Bot API идут через общий планировщик с двумя
+ * ведрами токенов: общим (Telegram пускает ~30 сообщений в секунду) и
+ * отдельным на каждый чат (~1 в секунду с небольшим запасом). Вызывающий
+ * поток ждёт своей очереди и сам выполняет запрос, поэтому долгая загрузка
+ * документа не задерживает остальных. Из ждущих первыми пропускаются
+ * ответы пользователю, затем выдача книг, затем уборка сообщений.
+ *
+ * На 429 чат (для запросов без чата — всё ведро) замирает на retry_after
+ * секунд из ответа, и запрос повторяется. Удаления не ждут: они копятся по
+ * чатам и уходят одним deleteMessages, когда чату достанется токен.
+ */
+
+class TelegramOutbox {
+public:
+    enum class Priority {
+        Reply = 0,      // ответы на команды и колбэки
+        Delivery = 1,   // документы
+        Cleanup = 2     // удаление старых сообщений, статус загрузки
+    };
+
+    struct Stats {
+        uint64_t calls = 0;
+        uint64_t retries = 0;
+        uint64_t deleteRequests = 0;
+        uint64_t deletedMessages = 0;
+    };
+
+    TelegramOutbox(TgBot::Bot& bot_, HttpTransport& transport_, const OutboxLimits& limits_ = OutboxLimits(),
+                   const std::string& apiUrl = "https://api.telegram.org")
+            : bot(bot_), http(transport_), limits(limits_), deleteUrl(apiUrl + "/bot" + bot_.getToken() + "/deleteMessages"),
+              global{limits_.globalBurst, Clock::now(), {}},
+              scheduler(&TelegramOutbox::schedule, this), sender(&TelegramOutbox::send, this) {}
+
+    ~TelegramOutbox() {
+        stop();
+    }
+
+    TelegramOutbox(const TelegramOutbox&) = delete;
+    TelegramOutbox& operator=(const TelegramOutbox&) = delete;
+
+    const TgBot::Api& api() const {
+        return bot.getApi();
+    }
+
+    const std::string& token() const {
+        return bot.getToken();
+    }
+
+    HttpTransport& transport() const {
+        return http;
+    }
+
+    // Запрос в очереди чата с повтором на 429; chatId = 0 — только общее ведро
+    template<typename Request>
+    auto call(int64_t chatId, Priority priority, Request request) -> decltype(request()) {
+        decltype(request()) result{};
+        run(chatId, priority, [&] { result = request(); });
+        return result;
+    }
+
+    TgBot::Message::Ptr sendMessage(int64_t chatId, const std::string& text, const std::string& parseMode = "",
+                                    TgBot::GenericReply::Ptr markup = nullptr) {
+        return call(chatId, Priority::Reply, [&] {
+            return bot.getApi().sendMessage(chatId, text, false, 0, markup, parseMode);
+        });
+    }
+
+    TgBot::Message::Ptr editMessageText(int64_t chatId, int32_t messageId, const std::string& text,
+                                        const std::string& parseMode = "", TgBot::GenericReply::Ptr markup = nullptr) {
+        return call(chatId, Priority::Reply, [&] {
+            return bot.getApi().editMessageText(text, chatId, messageId, "", parseMode, false, markup);
+        });
+    }
+
+    // Ответ на колбэк не пишет в чат, поэтому идёт только через общее ведро
+    bool answerCallbackQuery(const std::string& callbackId, const std::string& text = "") {
+        return call(0, Priority::Reply, [&] { return bot.getApi().answerCallbackQuery(callbackId, text); });
+    }
+
+    // Не ждёт; ошибки удаления (сообщение уже удалено, слишком старое) не важны
+    void deleteMessage(int64_t chatId, int32_t messageId) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (stopping) {
+            lock.unlock();
+            try { bot.getApi().deleteMessage(chatId, messageId); } catch (...) {}
+            return;
+        }
+        auto& ids = deletes[chatId];
+        ids.push_back(messageId);
+        if (ids.size() == 1)
+            enqueue(Item{chatId, nullptr, true, nullptr, 0, Clock::now() + limits.deleteDelay}, Priority::Cleanup);
+    }
+
+    // Запрос без ожидания результата; выполняется потоком отправки
+    void post(int64_t chatId, Priority priority, std::function<void()> job) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (stopping) {
+            lock.unlock();
+            try { job(); } catch (const std::exception& e) { std::cerr << "Telegram request failed: " << e.what() << std::endl; }
+            return;
+        }
+        enqueue(Item{chatId, nullptr, false, std::move(job), 0, {}}, priority);
+    }
+
+    Stats stats() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return counters;
+    }
+
+    // Ждущие пропускаются без ограничений, накопленные удаления отправляются
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        if (scheduler.joinable())
+            scheduler.join();
+        if (sender.joinable())
+            sender.join();
+    }
+
+    // "Too Many Requests: retry after 5" -> 5; -1 — не 429
+    static int64_t retryAfter(const TgBot::TgException& e) {
+        std::string text = e.what();
+        if (e.errorCode != TgBot::TgException::ErrorCode::TooManyRequests &&
+            text.find("Too Many Requests") == std::string::npos)
+            return -1;
+        size_t pos = text.find("retry after ");
+        if (pos == std::string::npos)
+            return 1;
+        try {
+            return std::max<int64_t>(1, std::stoll(text.substr(pos + 12)));
+        } catch (const std::exception&) {
+            return 1;
+        }
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    // Telegram удаляет не больше 100 сообщений за запрос
+    static constexpr size_t maxDeleteBatch = 100;
+    // Столько ведер чатов копится, прежде чем полные (давно молчащие) выбрасываются
+    static constexpr size_t pruneBuckets = 4096;
+
+    struct Bucket {
+        double tokens;
+        Clock::time_point updated;
+        Clock::time_point pausedUntil;
+
+        void refill(double rate, double burst, Clock::time_point now) {
+            tokens = std::min(burst, tokens + rate * std::chrono::duration<double>(now - updated).count());
+            updated = now;
+        }
+
+        Clock::time_point readyAt(double rate) const {
+            auto refilled = updated + std::chrono::duration_cast<Clock::duration>(
+                    std::chrono::duration<double>(std::max(0.0, 1 - tokens) / rate));
+            return std::max(refilled, pausedUntil);
+        }
+    };
+
+    // Поток, ждущий разрешения на запрос
+    struct Waiter {
+        std::condition_variable ready;
+        bool granted = false;
+    };
+
+    struct Item {
+        int64_t chatId;
+        Waiter* waiter;             // синхронный вызов
+        bool deletes;               // накопленные удаления чата
+        std::function<void()> job;  // post()
+        int attempts;
+        Clock::time_point notBefore;
+    };
+
+    struct Task {
+        int64_t chatId;
+        Priority priority;
+        std::vector<int32_t> ids;
+        std::function<void()> job;
+        int attempts;
+    };
+
+    void run(int64_t chatId, Priority priority, const std::function<void()>& request) {
+        for (int attempt = 0;; ++attempt) {
+            {
+                // Ожидание лимитов видно в трассе апдейта отдельным спаном
+                static const char* const waits[] = {"wait reply", "wait delivery", "wait cleanup"};
+                Tracer::Scope span("outbox", waits[static_cast<int>(priority)]);
+                acquire(chatId, priority);
+            }
+            try {
+                request();
+                std::lock_guard<std::mutex> lock(mutex);
+                ++counters.calls;
+                return;
+            } catch (const TgBot::TgException& e) {
+                int64_t delay = retryAfter(e);
+                if (delay < 0 || attempt >= limits.maxRetries)
+                    throw;
+                std::cerr << "Telegram flood limit for chat " << chatId << ", retry in " << delay << " s" << std::endl;
+                pause(chatId, delay);
+            }
+        }
+    }
+
+    void acquire(int64_t chatId, Priority priority) {
+        Waiter waiter;
+        std::unique_lock<std::mutex> lock(mutex);
+        if (stopping)
+            return;
+        enqueue(Item{chatId, &waiter, false, nullptr, 0, {}}, priority);
+        waiter.ready.wait(lock, [&waiter] { return waiter.granted; });
+    }
+
+    // Вызывается под mutex
+    void enqueue(Item item, Priority priority) {
+        queue.emplace(std::make_pair(static_cast<int>(priority), ++sequence), std::move(item));
+        wake.notify_all();
+    }
+
+    void pause(int64_t chatId, int64_t seconds) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto until = Clock::now() + std::chrono::seconds(seconds);
+        Bucket& bucket = chatId == 0 ? global : chatBucket(chatId, Clock::now());
+        bucket.pausedUntil = std::max(bucket.pausedUntil, until);
+        ++counters.retries;
+        wake.notify_all();
+    }
+
+    // Вызывается под mutex
+    Bucket& chatBucket(int64_t chatId, Clock::time_point now) {
+        auto it = chats.find(chatId);
+        if (it == chats.end())
+            it = chats.emplace(chatId, Bucket{limits.chatBurst, now, {}}).first;
+        it->second.refill(limits.chatRate, limits.chatBurst, now);
+        return it->second;
+    }
+
+    // Раздаёт токены: первый по приоритету запрос, чьё ведро чата не пусто
+    void schedule() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!stopping) {
+            auto now = Clock::now();
+            global.refill(limits.globalRate, limits.globalBurst, now);
+            auto next = Clock::time_point::max();
+            auto chosen = queue.end();
+
+            if (global.readyAt(limits.globalRate) <= now) {
+                for (auto it = queue.begin(); it != queue.end(); ++it) {
+                    const Item& item = it->second;
+                    if (item.notBefore > now) {
+                        next = std::min(next, item.notBefore);
+                        continue;
+                    }
+                    if (item.chatId == 0) {
+                        chosen = it;
+                        break;
+                    }
+                    auto ready = chatBucket(item.chatId, now).readyAt(limits.chatRate);
+                    if (ready <= now) {
+                        chosen = it;
+                        break;
+                    }
+                    next = std::min(next, ready);
+                }
+            } else if (!queue.empty()) {
+                next = global.readyAt(limits.globalRate);
+            }
+
+            if (chosen == queue.end()) {
+                if (next == Clock::time_point::max())
+                    wake.wait(lock);
+                else
+                    wake.wait_until(lock, next);
+                continue;
+            }
+
+            global.tokens -= 1;
+            if (chosen->second.chatId != 0)
+                chats[chosen->second.chatId].tokens -= 1;
+            dispatch(chosen);
+            prune(now);
+        }
+
+        // Остановка: оставшиеся идут без ограничений
+        while (!queue.empty())
+            dispatch(queue.begin());
+        flushed = true;
+        ready.notify_all();
+    }
+
+    // Вызывается под mutex
+    void dispatch(std::map<std::pair<int, uint64_t>, Item>::iterator it) {
+        Priority priority = static_cast<Priority>(it->first.first);
+        Item item = std::move(it->second);
+        queue.erase(it);
+
+        if (item.waiter) {
+            item.waiter->granted = true;
+            item.waiter->ready.notify_one();
+            return;
+        }
+
+        Task task{item.chatId, priority, {}, std::move(item.job), item.attempts};
+        if (item.deletes) {
+            auto pending = deletes.find(item.chatId);
+            if (pending == deletes.end())
+                return;
+            auto& ids = pending->second;
+            size_t count = std::min(ids.size(), maxDeleteBatch);
+            task.ids.assign(ids.begin(), ids.begin() + count);
+            ids.erase(ids.begin(), ids.begin() + count);
+            if (ids.empty())
+                deletes.erase(pending);
+            else
+                enqueue(Item{item.chatId, nullptr, true, nullptr, 0, {}}, Priority::Cleanup);
+        }
+        tasks.push_back(std::move(task));
+        ready.notify_one();
+    }
+
+    // Вызывается под mutex
+    void prune(Clock::time_point now) {
+        if (chats.size() < pruneAt)
+            return;
+        for (auto it = chats.begin(); it != chats.end();) {
+            it->second.refill(limits.chatRate, limits.chatBurst, now);
+            if (it->second.tokens >= limits.chatBurst && it->second.pausedUntil <= now)
+                it = chats.erase(it);
+            else
+                ++it;
+        }
+        pruneAt = std::max(pruneBuckets, chats.size() * 2);
+    }
+
+    // Выполняет post() и удаления вне потока планировщика
+    void send() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            ready.wait(lock, [this] { return !tasks.empty() || flushed; });
+            if (tasks.empty())
+                break;
+            Task task = std::move(tasks.front());
+            tasks.pop_front();
+            lock.unlock();
+
+            int64_t delay = -1;
+            try {
+                if (task.job)
+                    task.job();
+                else
+                    deleteBatch(task.chatId, task.ids);
+            } catch (const TgBot::TgException& e) {
+                delay = retryAfter(e);
+                if (delay < 0 && e.errorCode != TgBot::TgException::ErrorCode::BadRequest)
+                    std::cerr << "Telegram request failed: " << e.what() << std::endl;
+            } catch (const std::exception& e) {
+                std::cerr << "Telegram request failed: " << e.what() << std::endl;
+            }
+
+            if (delay >= 0 && task.attempts < limits.maxRetries)
+                pause(task.chatId, delay);
+            lock.lock();
+            if (delay < 0 || task.attempts >= limits.maxRetries || flushed)
+                continue;
+            if (task.job) {
+                enqueue(Item{task.chatId, nullptr, false, std::move(task.job), task.attempts + 1, {}}, task.priority);
+            } else {
+                auto& ids = deletes[task.chatId];
+                bool queued = !ids.empty();
+                ids.insert(ids.begin(), task.ids.begin(), task.ids.end());
+                if (!queued)
+                    enqueue(Item{task.chatId, nullptr, true, nullptr, task.attempts + 1, {}}, Priority::Cleanup);
+            }
+        }
+    }
+
+    // Одно сообщение — обычный deleteMessage; несколько — deleteMessages, которого нет в tgbot-cpp
+    void deleteBatch(int64_t chatId, const std::vector<int32_t>& ids) {
+        if (ids.empty())
+            return;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++counters.deleteRequests;
+            counters.deletedMessages += ids.size();
+        }
+        if (ids.size() == 1) {
+            bot.getApi().deleteMessage(chatId, ids.front());
+            return;
+        }
+
+        std::string list = "[";
+        for (size_t i = 0; i < ids.size(); ++i)
+            list += (i ? "," : "") + std::to_string(ids[i]);
+        list += "]";
+
+        static LatencyHistogram& timing = Metrics::instance().histogram(Metrics::Family::Telegram, "deleteMessages");
+        Metrics::Timer timer(timing);
+        CURL* curl = threadHandle();
+        char* escaped = curl_easy_escape(curl, list.c_str(), static_cast<int>(list.size()));
+        std::string form = "chat_id=" + std::to_string(chatId) + "&message_ids=" + escaped;
+        curl_free(escaped);
+
+        std::string body;
+        curl_easy_setopt(curl, CURLOPT_URL, deleteUrl.c_str());
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, form.c_str());
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, &TelegramOutbox::write);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &body);
+        curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 20L);
+        curl_easy_setopt(curl, CURLOPT_TIMEOUT, 30L);
+        CURLcode rc = http.perform(curl);
+        if (rc != CURLE_OK)
+            throw std::runtime_error(std::string("deleteMessages failed: ") + curl_easy_strerror(rc));
+
+        boost::property_tree::ptree json;
+        try {
+            std::istringstream in(body);
+            boost::property_tree::read_json(in, json);
+        } catch (const std::exception&) {
+            throw TgBot::TgException("Bad deleteMessages response: " + body.substr(0, 200),
+                                     TgBot::TgException::ErrorCode::InvalidJson);
+        }
+        if (!json.get<bool>("ok", false))
+            throw TgBot::TgException(json.get<std::string>("description", "deleteMessages failed"),
+                                     static_cast<TgBot::TgException::ErrorCode>(json.get<size_t>("error_code", 0)));
+    }
+
+    static size_t write(char* data, size_t size, size_t count, void* out) {
+        static_cast<std::string*>(out)->append(data, size * count);
+        return size * count;
+    }
+
+    struct Handle {
+        CURL* curl = curl_easy_init();
+        ~Handle() { curl_easy_cleanup(curl); }
+    };
+
+    static CURL* threadHandle() {
+        thread_local Handle handle;
+        return handle.curl;
+    }
+
+    TgBot::Bot& bot;
+    HttpTransport& http;
+    const OutboxLimits limits;
+    const std::string deleteUrl;
+
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable ready;
+    Bucket global;
+    std::unordered_map<int64_t, Bucket> chats;
+    size_t pruneAt = pruneBuckets;
+    std::map<std::pair<int, uint64_t>, Item> queue;     // (приоритет, порядок поступления)
+    std::unordered_map<int64_t, std::vector<int32_t>> deletes;
+    std::deque<Task> tasks;
+    uint64_t sequence = 0;
+    Stats counters;
+    bool stopping = false;
+    bool flushed = false;
+    std::thread scheduler;
+    std::thread sender;
+};
+
+#endif // TG_BOT_TELEGRAMOUTBOX_H
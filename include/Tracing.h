@@ -0,0 +1,310 @@
+#ifndef TG_BOT_TRACING_H
+#define TG_BOT_TRACING_H
+
+#pragma once
+
+#include <fmt/format.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <set>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+/**
+ * Трассировка апдейтов: у каждого апдейта свой trace id, внутри — вложенные
+ * спаны обработчика команды, SQL-выражений, вызовов Диска и Bot API, ожидания
+ * в очередях. Спаны пишутся в кольцевой буфер фиксированного размера (старые
+ * затираются) и по запросу выгружаются в JSON формата Chrome trace_event —
+ * его открывают chrome://tracing и ui.perfetto.dev.
+ *
+ * Текущий контекст живёт в thread_local; при передаче работы в другой поток
+ * его забирают через current() и восстанавливают через Adopt. Решение о
+ * записи принимается один раз на апдейт (доля sampleRate), вне выборки спан
+ * стоит одного чтения thread_local. Имена спанов не копируются до записи:
+ * это литералы или метки гистограмм, живущие до конца процесса.
+ */
+
+// Пустой traceId — апдейт не попал в выборку
+struct TraceContext {
+    uint64_t traceId = 0;
+    uint64_t spanId = 0;
+
+    explicit operator bool() const {
+        return traceId != 0;
+    }
+};
+
+// Фильтр выгрузки трасс: 0 — без ограничения
+struct TraceFilter {
+    uint64_t traceId = 0;
+    int64_t chatId = 0;
+};
+
+class Tracer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Делает ctx текущим в этом потоке до конца области видимости
+    class Adopt {
+    public:
+        explicit Adopt(const TraceContext& ctx)
+                : previous(context()) {
+            context() = ctx;
+        }
+
+        ~Adopt() {
+            context() = previous;
+        }
+
+        Adopt(const Adopt&) = delete;
+        Adopt& operator=(const Adopt&) = delete;
+
+    private:
+        TraceContext previous;
+    };
+
+    // Спан от создания до finish() или разрушения; вложенные спаны потока становятся его детьми
+    class Scope {
+    public:
+        Scope(const char* category_, std::string_view name_)
+                : parent(context()) {
+            if (parent)
+                open(category_, name_, Clock::now());
+        }
+
+        Scope(const char* category_, std::string_view name_, Clock::time_point start_)
+                : parent(context()) {
+            if (parent)
+                open(category_, name_, start_);
+        }
+
+        ~Scope() {
+            finish(Clock::now());
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+        void finish(Clock::time_point end) {
+            if (!category)
+                return;
+            instance().record(parent.traceId, spanId, parent.spanId, category, name, start, end);
+            context().spanId = parent.spanId;
+            category = nullptr;
+        }
+
+    private:
+        void open(const char* category_, std::string_view name_, Clock::time_point start_) {
+            category = category_;
+            name = name_;
+            start = start_;
+            spanId = instance().nextId();
+            context().spanId = spanId;
+        }
+
+        TraceContext parent;
+        const char* category = nullptr;
+        std::string_view name;
+        Clock::time_point start;
+        uint64_t spanId = 0;
+    };
+
+    // Корневой спан апдейта: от получения до конца обработки в воркере.
+    // Время в очереди диспетчера записывается отдельным дочерним спаном.
+    class Root {
+    public:
+        Root(const TraceContext& ctx_, const char* category_, std::string_view name_, int64_t chatId_,
+             Clock::time_point received_)
+                : ctx(ctx_), adopt(ctx_), category(category_), name(name_), chatId(chatId_), received(received_) {
+            if (ctx)
+                instance().record(ctx.traceId, instance().nextId(), ctx.spanId, "queue", "dispatcher",
+                                  received, Clock::now());
+        }
+
+        ~Root() {
+            if (ctx)
+                instance().record(ctx.traceId, ctx.spanId, 0, category, name, received, Clock::now(), chatId);
+        }
+
+        Root(const Root&) = delete;
+        Root& operator=(const Root&) = delete;
+
+    private:
+        const TraceContext ctx;
+        Adopt adopt;
+        const char* category;
+        const std::string_view name;
+        const int64_t chatId;
+        const Clock::time_point received;
+    };
+
+    static Tracer& instance() {
+        static Tracer tracer;
+        return tracer;
+    }
+
+    // Вызывается до начала обработки апдейтов
+    void configure(double sampleRate_, size_t capacity_) {
+        sampleRate = std::clamp(sampleRate_, 0.0, 1.0);
+        capacity = std::max<size_t>(capacity_, 1);
+        slots = std::make_unique<Slot[]>(capacity);
+        next = 0;
+    }
+
+    static TraceContext& context() {
+        thread_local TraceContext ctx;
+        return ctx;
+    }
+
+    static TraceContext current() {
+        return context();
+    }
+
+    // Новый апдейт: контекст с корневым спаном или пустой, если апдейт не попал в выборку
+    TraceContext startTrace() {
+        if (sampleRate <= 0 || (sampleRate < 1 && uniform() >= sampleRate))
+            return {};
+        return {nextId(), nextId()};
+    }
+
+    void record(uint64_t traceId, uint64_t spanId, uint64_t parentId, const char* category, std::string_view name,
+                Clock::time_point start, Clock::time_point end, int64_t chatId = 0) {
+        Slot& slot = slots[next.fetch_add(1, std::memory_order_relaxed) % capacity];
+        while (slot.busy.test_and_set(std::memory_order_acquire)) {}
+        slot.span.traceId = traceId;
+        slot.span.spanId = spanId;
+        slot.span.parentId = parentId;
+        slot.span.chatId = chatId;
+        slot.span.start = std::chrono::duration_cast<std::chrono::nanoseconds>(start - epoch).count();
+        slot.span.duration = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+        slot.span.thread = threadIndex();
+        slot.span.category = category;
+        size_t length = std::min(name.size(), sizeof(slot.span.name) - 1);
+        while (length < name.size() && length > 0 && (static_cast<unsigned char>(name[length]) & 0xC0) == 0x80)
+            --length;   // не резать UTF-8 посреди символа
+        std::memcpy(slot.span.name, name.data(), length);
+        slot.span.name[length] = '\0';
+        slot.busy.clear(std::memory_order_release);
+    }
+
+    // Спаны из буфера в формате Chrome trace_event, по порядку начала
+    std::string chromeJson(const TraceFilter& filter = TraceFilter()) const {
+        std::vector<SpanRecord> spans;
+        spans.reserve(std::min<uint64_t>(next.load(), capacity));
+        for (size_t i = 0; i < capacity; ++i) {
+            Slot& slot = slots[i];
+            while (slot.busy.test_and_set(std::memory_order_acquire)) {}
+            if (slot.span.traceId)
+                spans.push_back(slot.span);
+            slot.busy.clear(std::memory_order_release);
+        }
+
+        // Чат известен только корневому спану — по нему отбираются трассы целиком
+        std::set<uint64_t> traces;
+        if (filter.chatId) {
+            for (const auto& span : spans) {
+                if (span.parentId == 0 && span.chatId == filter.chatId)
+                    traces.insert(span.traceId);
+            }
+        }
+        std::sort(spans.begin(), spans.end(), [](const SpanRecord& a, const SpanRecord& b) { return a.start < b.start; });
+
+        std::string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        bool first = true;
+        for (const auto& span : spans) {
+            if ((filter.traceId && span.traceId != filter.traceId) || (filter.chatId && !traces.count(span.traceId)))
+                continue;
+            out += first ? "\n" : ",\n";
+            first = false;
+            out += fmt::format("{{\"name\":\"{}\",\"cat\":\"{}\",\"ph\":\"X\",\"ts\":{:.3f},\"dur\":{:.3f},\"pid\":1,\"tid\":{},"
+                               "\"args\":{{\"trace\":\"{:016x}\",\"span\":\"{:x}\",\"parent\":\"{:x}\"",
+                               escape(span.name), span.category, span.start / 1e3, span.duration / 1e3, span.thread,
+                               span.traceId, span.spanId, span.parentId);
+            if (span.chatId)
+                out += fmt::format(",\"chat\":{}", span.chatId);
+            out += "}}";
+        }
+        out += "\n]}\n";
+        return out;
+    }
+
+    uint64_t nextId() {
+        uint64_t id;
+        do {
+            id = random();
+        } while (id == 0);
+        return id;
+    }
+
+private:
+    struct SpanRecord {
+        uint64_t traceId = 0;
+        uint64_t spanId = 0;
+        uint64_t parentId = 0;
+        int64_t chatId = 0;
+        int64_t start = 0;          // нс от запуска
+        int64_t duration = 0;       // нс
+        uint32_t thread = 0;
+        const char* category = "";  // строковый литерал
+        char name[64] = {};         // длинные имена (текст SQL) обрезаются
+    };
+
+    // Писатели почти не встречаются на одном слоте; флаг нужен, чтобы выгрузка не читала полузаписанный спан
+    struct Slot {
+        std::atomic_flag busy = ATOMIC_FLAG_INIT;
+        SpanRecord span;
+    };
+
+    Tracer() {
+        configure(1.0, 65536);
+    }
+
+    static uint64_t random() {
+        thread_local uint64_t state = std::random_device()() ^
+                                      (static_cast<uint64_t>(std::hash<std::thread::id>()(std::this_thread::get_id())) << 1);
+        // xorshift64*
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return state * 0x2545F4914F6CDD1DULL;
+    }
+
+    static double uniform() {
+        return static_cast<double>(random() >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+    static uint32_t threadIndex() {
+        static std::atomic<uint32_t> counter{0};
+        thread_local uint32_t index = ++counter;
+        return index;
+    }
+
+    static std::string escape(const char* value) {
+        std::string out;
+        for (; *value; ++value) {
+            unsigned char c = static_cast<unsigned char>(*value);
+            if (c == '"' || c == '\\')
+                out += '\\';
+            if (c < 0x20)
+                out += fmt::format("\\u{:04x}", c);
+            else
+                out += static_cast<char>(c);
+        }
+        return out;
+    }
+
+    const Clock::time_point epoch = Clock::now();
+    double sampleRate = 1.0;
+    size_t capacity = 0;
+    std::unique_ptr<Slot[]> slots;
+    std::atomic<uint64_t> next{0};
+};
+
+#endif // TG_BOT_TRACING_H
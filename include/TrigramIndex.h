@@ -0,0 +1,171 @@
+#ifndef TG_BOT_TRIGRAMINDEX_H
+#define TG_BOT_TRIGRAMINDEX_H
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Триграммный индекс для нечёткого поиска по словарю строк (авторы, темы, названия).
+ * Строка приводится к нижнему регистру (латиница и кириллица, ё -> е), режется
+ * на слова, каждое слово дополняется пробелами и раскладывается на триграммы.
+ * Кандидаты ранжируются по доле триграмм запроса, найденных в строке,
+ * при равенстве — по коэффициенту Дайса.
+ */
+
+class TrigramIndex {
+public:
+    struct Match {
+        std::string value;
+        double score;
+    };
+
+    // Повторное добавление той же строки игнорируется
+    void add(const std::string& value) {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        if (ids.count(value))
+            return;
+
+        auto grams = trigrams(value);
+        if (grams.empty())
+            return;
+
+        auto id = static_cast<uint32_t>(values.size());
+        ids.emplace(value, id);
+        values.push_back(value);
+        gramCounts.push_back(static_cast<uint32_t>(grams.size()));
+        for (uint64_t gram : grams)
+            postings[gram].push_back(id);
+    }
+
+    std::vector<Match> similar(const std::string& query, size_t limit = 5, double threshold = 0.4) const {
+        auto grams = trigrams(query);
+        if (grams.empty())
+            return {};
+
+        std::shared_lock<std::shared_mutex> lock(mutex);
+
+        // Плотный счётчик совпадений на поток — без аллокаций на каждый запрос
+        thread_local std::vector<uint16_t> hits;
+        thread_local std::vector<uint32_t> touched;
+        if (hits.size() < values.size())
+            hits.resize(values.size(), 0);
+        touched.clear();
+
+        for (uint64_t gram : grams) {
+            auto it = postings.find(gram);
+            if (it == postings.end())
+                continue;
+            for (uint32_t id : it->second) {
+                if (hits[id]++ == 0)
+                    touched.push_back(id);
+            }
+        }
+
+        struct Candidate { uint32_t id; double coverage; double dice; };
+        std::vector<Candidate> candidates;
+        for (uint32_t id : touched) {
+            double common = hits[id];
+            hits[id] = 0;
+            double coverage = common / grams.size();
+            if (coverage < threshold)
+                continue;
+            candidates.push_back({id, coverage, 2.0 * common / (grams.size() + gramCounts[id])});
+        }
+
+        auto better = [](const Candidate& a, const Candidate& b) {
+            return a.coverage != b.coverage ? a.coverage > b.coverage : a.dice > b.dice;
+        };
+        size_t count = std::min(limit, candidates.size());
+        std::partial_sort(candidates.begin(), candidates.begin() + count, candidates.end(), better);
+
+        std::vector<Match> result;
+        for (size_t i = 0; i < count; ++i)
+            result.push_back({values[candidates[i].id], candidates[i].coverage});
+        return result;
+    }
+
+    size_t size() const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        return values.size();
+    }
+
+private:
+    // Отсортированные уникальные триграммы строки
+    static std::vector<uint64_t> trigrams(const std::string& text) {
+        std::vector<uint64_t> grams;
+        for (const auto& word : words(text)) {
+            std::u32string padded = U"  " + word + U" ";
+            for (size_t i = 0; i + 2 < padded.size(); ++i)
+                grams.push_back((uint64_t(padded[i]) << 42) | (uint64_t(padded[i + 1]) << 21) | uint64_t(padded[i + 2]));
+        }
+        std::sort(grams.begin(), grams.end());
+        grams.erase(std::unique(grams.begin(), grams.end()), grams.end());
+        return grams;
+    }
+
+    static std::vector<std::u32string> words(const std::string& text) {
+        std::vector<std::u32string> result;
+        std::u32string word;
+        for (char32_t c : decodeUtf8(text)) {
+            c = fold(c);
+            if (isWordChar(c)) {
+                word += c;
+            } else if (!word.empty()) {
+                result.push_back(word);
+                word.clear();
+            }
+        }
+        if (!word.empty())
+            result.push_back(word);
+        return result;
+    }
+
+    static char32_t fold(char32_t c) {
+        if (c >= U'A' && c <= U'Z') return c + 0x20;
+        if (c >= 0x0410 && c <= 0x042F) return c + 0x20;   // А-Я
+        if (c >= 0x0400 && c <= 0x040F) c += 0x50;         // Ѐ-Џ -> ѐ-џ
+        if (c == 0x0451) return 0x0435;                    // ё -> е
+        return c;
+    }
+
+    static bool isWordChar(char32_t c) {
+        if (c < 0x80)
+            return (c >= U'a' && c <= U'z') || (c >= U'0' && c <= U'9');
+        if (c == 0xAB || c == 0xBB || (c >= 0x2000 && c <= 0x206F))
+            return false; // «», тире, кавычки и прочая пунктуация
+        return c >= 0xC0;
+    }
+
+    static std::u32string decodeUtf8(const std::string& text) {
+        std::u32string result;
+        for (size_t i = 0; i < text.size();) {
+            auto byte = static_cast<unsigned char>(text[i]);
+            int extra = byte < 0x80 ? 0 : (byte >> 5) == 0x6 ? 1 : (byte >> 4) == 0xE ? 2 : (byte >> 3) == 0x1E ? 3 : -1;
+            if (extra < 0 || i + extra > text.size() - 1) {
+                ++i; // битая последовательность — пропускаем байт
+                continue;
+            }
+            char32_t c = extra == 0 ? byte : byte & (0x3F >> extra);
+            for (int k = 1; k <= extra; ++k)
+                c = (c << 6) | (static_cast<unsigned char>(text[i + k]) & 0x3F);
+            result += c;
+            i += extra + 1;
+        }
+        return result;
+    }
+
+    mutable std::shared_mutex mutex;
+    std::vector<std::string> values;
+    std::vector<uint32_t> gramCounts;
+    std::unordered_map<std::string, uint32_t> ids;
+    std::unordered_map<uint64_t, std::vector<uint32_t>> postings;
+};
+
+#endif // TG_BOT_TRIGRAMINDEX_H
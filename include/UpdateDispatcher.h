@@ -0,0 +1,186 @@
+#ifndef TG_BOT_UPDATEDISPATCHER_H
+#define TG_BOT_UPDATEDISPATCHER_H
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Диспетчер входящих апдейтов.
+ * Снимает обработку с потока long poll и раздаёт её пулу воркеров.
+ * У каждого чата своя FIFO-очередь: апдейты одного чата выполняются строго
+ * по порядку и никогда параллельно, разные чаты обрабатываются одновременно.
+ * Готовые к обработке чаты лежат в деке "своего" воркера, простаивающий
+ * воркер забирает работу с хвоста чужого дека (work stealing).
+ */
+
+class UpdateDispatcher {
+public:
+    using Task = std::function<void()>;
+
+    explicit UpdateDispatcher(size_t threadCount = std::thread::hardware_concurrency()) {
+        if (threadCount == 0)
+            threadCount = 1;
+        for (size_t i = 0; i < threadCount; ++i)
+            workers.push_back(std::make_unique<Worker>());
+        for (size_t i = 0; i < threadCount; ++i)
+            workers[i]->thread = std::thread(&UpdateDispatcher::run, this, i);
+    }
+
+    ~UpdateDispatcher() {
+        stop();
+    }
+
+    UpdateDispatcher(const UpdateDispatcher&) = delete;
+    UpdateDispatcher& operator=(const UpdateDispatcher&) = delete;
+
+    // Ставит задачу в очередь чата chatId
+    void post(int64_t chatId, Task task) {
+        {
+            std::lock_guard<std::mutex> lock(chatsMutex);
+            if (stopping)
+                return;
+            auto& queue = chats[chatId];
+            queue.tasks.push_back(std::move(task));
+            if (queue.scheduled)
+                return; // чат уже в работе — задача выполнится следом за текущими
+            queue.scheduled = true;
+        }
+        schedule(homeWorker(chatId), chatId);
+    }
+
+    // Дорабатывает уже принятые задачи и останавливает воркеры
+    void stop() {
+        {
+            std::lock_guard<std::mutex> chatsLock(chatsMutex);
+            std::lock_guard<std::mutex> idleLock(idleMutex);
+            stopping = true;
+        }
+        idle.notify_all();
+        for (auto& worker : workers) {
+            if (worker->thread.joinable())
+                worker->thread.join();
+        }
+    }
+
+    size_t threadCount() const {
+        return workers.size();
+    }
+
+private:
+    struct ChatQueue {
+        std::deque<Task> tasks;
+        bool scheduled = false;
+    };
+
+    struct Worker {
+        std::mutex mutex;
+        std::deque<int64_t> ready;
+        std::thread thread;
+    };
+
+    size_t homeWorker(int64_t chatId) const {
+        return std::hash<int64_t>{}(chatId) % workers.size();
+    }
+
+    void schedule(size_t workerIndex, int64_t chatId) {
+        {
+            std::lock_guard<std::mutex> lock(workers[workerIndex]->mutex);
+            workers[workerIndex]->ready.push_back(chatId);
+        }
+        {
+            std::lock_guard<std::mutex> lock(idleMutex);
+            ++readyCount;
+        }
+        idle.notify_one();
+    }
+
+    // Своя очередь берётся с головы, чужие — с хвоста
+    bool takeReady(size_t self, int64_t& chatId) {
+        for (size_t i = 0; i < workers.size(); ++i) {
+            auto& worker = *workers[(self + i) % workers.size()];
+            std::lock_guard<std::mutex> lock(worker.mutex);
+            if (worker.ready.empty())
+                continue;
+            if (i == 0) {
+                chatId = worker.ready.front();
+                worker.ready.pop_front();
+            } else {
+                chatId = worker.ready.back();
+                worker.ready.pop_back();
+            }
+            return true;
+        }
+        return false;
+    }
+
+    void run(size_t self) {
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(idleMutex);
+                idle.wait(lock, [this] { return stopping || readyCount > 0; });
+                if (readyCount == 0)
+                    return;
+                --readyCount; // резервируем одну запись из деков
+            }
+
+            int64_t chatId = 0;
+            while (!takeReady(self, chatId))
+                std::this_thread::yield();
+
+            runChat(self, chatId);
+        }
+    }
+
+    void runChat(size_t self, int64_t chatId) {
+        Task task;
+        {
+            std::lock_guard<std::mutex> lock(chatsMutex);
+            auto& queue = chats[chatId];
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+
+        try {
+            task();
+        } catch (const std::exception& e) {
+            std::cerr << "Update handler error (chat " << chatId << "): " << e.what() << std::endl;
+        } catch (...) {
+            std::cerr << "Update handler error (chat " << chatId << "): unknown exception" << std::endl;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(chatsMutex);
+            auto it = chats.find(chatId);
+            if (it->second.tasks.empty()) {
+                chats.erase(it);
+                return;
+            }
+        }
+        // В чате остались апдейты — в конец своей очереди, чтобы один
+        // активный чат не занимал воркер целиком
+        schedule(self, chatId);
+    }
+
+    std::vector<std::unique_ptr<Worker>> workers;
+
+    std::mutex chatsMutex;
+    std::unordered_map<int64_t, ChatQueue> chats;
+
+    std::mutex idleMutex;
+    std::condition_variable idle;
+    size_t readyCount = 0;
+    bool stopping = false;
+};
+
+#endif // TG_BOT_UPDATEDISPATCHER_H
@@ -0,0 +1,162 @@
+#ifndef TG_BOT_WEBHOOKSERVER_H
+#define TG_BOT_WEBHOOKSERVER_H
+
+#pragma once
+
+#include <tgbot/tgbot.h>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <string>
+#include "HttpServer.h"
+#include "PipelineStage.h"
+
+/**
+ * Приём апдейтов вебхуком вместо long poll. Telegram сам присылает апдейты
+ * POST-запросами на несколько keep-alive соединений — нет круга getUpdates
+ * на каждую пачку и единственного потока приёма.
+ *
+ * Соединение проверяет путь и X-Telegram-Bot-Api-Secret-Token, кладёт тело
+ * в очередь разбора и сразу отвечает 200, не дожидаясь обработчиков. JSON
+ * разбирает один поток — в порядке прихода, иначе два апдейта одного чата
+ * могли бы попасть к диспетчеру в обратном порядке; апдейт уходит в
+ * обработчики событий бота так же, как из TgLongPoll. Если очередь полна,
+ * ответ 503 — Telegram повторит.
+ */
+
+class WebhookServer {
+public:
+    struct Stats {
+        uint64_t accepted = 0;
+        uint64_t rejected = 0;      // чужой путь или неверный секрет
+        uint64_t overloaded = 0;    // очередь разбора заполнена
+        uint64_t parseErrors = 0;
+    };
+
+    // secret обязателен: с пустым сервер отклоняет все апдейты
+    WebhookServer(TgBot::Bot& bot_, std::string path_, std::string secret_,
+                  size_t maxConnections = 40, size_t queueCapacity = 1024)
+            : bot(bot_), path(std::move(path_)), secret(std::move(secret_)),
+              parseStage("webhook", 1, queueCapacity, [this](std::string& body) { dispatch(body); }),
+              http([this](const HttpRequest& request) { return accept(request); }, maxConnections) {}
+
+    ~WebhookServer() {
+        stop();
+    }
+
+    WebhookServer(const WebhookServer&) = delete;
+    WebhookServer& operator=(const WebhookServer&) = delete;
+
+    bool listen(const std::string& host, uint16_t port) {
+        return http.listen(host, port);
+    }
+
+    uint16_t port() const {
+        return http.port();
+    }
+
+    // Принимает апдейты в вызывающем потоке до stop()
+    void run() {
+        http.run();
+    }
+
+    void start() {
+        http.start();
+    }
+
+    // Разбирает уже принятые апдейты и останавливает потоки
+    void stop() {
+        http.stop();
+        parseStage.stop();
+    }
+
+    Stats stats() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return counters;
+    }
+
+    HttpServer::Stats connectionStats() const {
+        return http.stats();
+    }
+
+    // Секрет для setWebhook, если он не задан: 32 символа из допустимых Telegram [A-Za-z0-9_-]
+    static std::string randomSecret() {
+        static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789_-";
+        std::random_device random;
+        std::uniform_int_distribution<size_t> pick(0, sizeof(alphabet) - 2);
+        std::string secret(32, ' ');
+        for (char& c : secret)
+            c = alphabet[pick(random)];
+        return secret;
+    }
+
+    // "https://host:8443/bot/hook?x" -> "/bot/hook"
+    static std::string pathOf(const std::string& url) {
+        size_t scheme = url.find("://");
+        size_t start = url.find('/', scheme == std::string::npos ? 0 : scheme + 3);
+        if (start == std::string::npos)
+            return "/";
+        return url.substr(start, url.find_first_of("?#", start) - start);
+    }
+
+private:
+    HttpResponse accept(const HttpRequest& request) {
+        if (request.path != path || !secretMatches(request.header("x-telegram-bot-api-secret-token"))) {
+            count(&Stats::rejected);
+            return {request.path != path ? 404 : 403, ""};
+        }
+        if (request.method != "POST")
+            return {405, ""};
+        if (!parseStage.tryPush(request.body)) {
+            count(&Stats::overloaded);
+            return {503, ""};
+        }
+        count(&Stats::accepted);
+        return {200, ""};
+    }
+
+    void dispatch(const std::string& body) {
+        TgBot::Update::Ptr update;
+        try {
+            update = parser.parseJsonAndGetUpdate(parser.parseJson(body));
+        } catch (const std::exception& e) {
+            count(&Stats::parseErrors);
+            std::cerr << "Bad webhook update: " << e.what() << std::endl;
+            return;
+        }
+        bot.getEventHandler().handleUpdate(update);
+    }
+
+    // Сравнение без раннего выхода: время ответа не подсказывает совпавший префикс.
+    // Пустой секрет не пропускает ничего
+    bool secretMatches(const std::string& value) const {
+        if (secret.empty())
+            return false;
+        if (value.size() != secret.size())
+            return false;
+        unsigned char diff = 0;
+        for (size_t i = 0; i < secret.size(); ++i)
+            diff |= static_cast<unsigned char>(value[i] ^ secret[i]);
+        return diff == 0;
+    }
+
+    void count(uint64_t Stats::* counter) {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++(counters.*counter);
+    }
+
+    TgBot::Bot& bot;
+    const std::string path;
+    const std::string secret;
+    TgBot::TgTypeParser parser;
+
+    mutable std::mutex mutex;
+    Stats counters;
+
+    PipelineStage<std::string> parseStage;
+    HttpServer http;
+};
+
+#endif // TG_BOT_WEBHOOKSERVER_H
@@ -1,4 +1,7 @@
 #include <tgbot/tgbot.h>
+#include <atomic>
+#include <chrono>
+#include <csignal>
 #include <cstdlib>
 #include <iostream>
 #include <string>
@@ -6,8 +9,13 @@
 #include <sqlite3.h>
 #include <vector>
 #include <map>
+#include <filesystem>
+#include <fstream>
 #include <memory>
-#include "YandexDiskClient.h"
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <thread>
 #include "../include/ICommand.h"
 #include "../include/StartCommand.h"
 #include "../include/CatalogCommand.h"
@@ -16,94 +24,137 @@
 #include "../include/FindByAuthorCommand.h"
 #include "../include/FindByTopicCommand.h"
 #include "../include/BookListPaginator.h"
+#include "../include/UpdateDispatcher.h"
+#include "../include/Database.h"
+#include "../include/FullTextSearch.h"
+#include "../include/CatalogImporter.h"
+#include "../include/CatalogSchema.h"
+#include "../include/ActiveDialogs.h"
+#include "../include/BookMetadata.h"
+#include "../include/DiskSync.h"
+#include "../include/PublicLinks.h"
+#include "../include/SyncCommand.h"
+#include "../include/TelegramOutbox.h"
+#include "../include/HttpServer.h"
+#include "../include/WebhookServer.h"
+#include "../include/HttpTransport.h"
+#include "../include/TelegramHttpClient.h"
+#include "../include/Metrics.h"
+#include "../include/StatsCommand.h"
+#include "../include/Tracing.h"
 
+// Заполняется до запуска диспетчера и дальше только читается воркерами
 std::map<std::string, std::unique_ptr<ICommand>> commandRegistry;
-sqlite3 *db;
-
-struct BookInfo {
-    std::string title;
-    std::string author;
-    std::string topic;
-    std::string file_path;
-};
-
-bool add_books(sqlite3* db, const std::vector<BookInfo>& books) {
-    const char* insert_sql =
-            "INSERT OR IGNORE INTO books (title, author, topic, file_path, request_count) VALUES (?, ?, ?, ?, 0);";
-    sqlite3_stmt* stmt;
-
-    if (sqlite3_prepare_v2(db, insert_sql, -1, &stmt, nullptr) != SQLITE_OK) {
-        std::cerr << "Request preparation error: " << sqlite3_errmsg(db) << std::endl;
+Database db;
+
+using BookInfo = CatalogImporter::Row;
+
+// Небольшой встроенный набор: одна транзакция, индекс обновляется триггерами
+bool add_books(Database& db, const std::vector<BookInfo>& books) {
+    CatalogImporter importer(db);
+    if (!importer.begin(false))
         return false;
+    for (const auto& book : books)
+        importer.add(book);
+    auto stats = importer.finish();
+    std::cout << fmt::format("Built-in books: {} added, {} already in catalog", stats.inserted, stats.duplicates) << std::endl;
+    return stats.skipped == 0;
+}
+
+// SIGINT/SIGTERM: обработчик только ставит флаг, остановку приёма апдейтов делает main
+volatile std::sig_atomic_t shutdownSignal = 0;
+
+void onShutdownSignal(int) {
+    shutdownSignal = 1;
+}
+
+// "123,456" -> {123, 456}
+std::set<int64_t> parseIds(const char* list) {
+    std::set<int64_t> ids;
+    std::istringstream in(list ? list : "");
+    std::string id;
+    while (std::getline(in, id, ',')) {
+        try { ids.insert(std::stoll(id)); } catch (...) {}
     }
+    return ids;
+}
 
-    bool all_success = true;
-    for (const auto& book : books) {
-        sqlite3_bind_text(stmt, 1, book.title.c_str(), -1, SQLITE_TRANSIENT);
-        sqlite3_bind_text(stmt, 2, book.author.c_str(), -1, SQLITE_TRANSIENT);
-        sqlite3_bind_text(stmt, 3, book.topic.c_str(), -1, SQLITE_TRANSIENT);
-        sqlite3_bind_text(stmt, 4, book.file_path.c_str(), -1, SQLITE_TRANSIENT);
-
-        if (sqlite3_step(stmt) != SQLITE_DONE) {
-            std::cerr << "Insertion error: " << sqlite3_errmsg(db) << std::endl;
-            all_success = false;
-        } else {
-            std::cout << "The book \"" << book.title << "\" has been added!" << std::endl;
-        }
-        sqlite3_reset(stmt);
+int envInt(const char* name, int fallback) {
+    const char* value = std::getenv(name);
+    try { return value ? std::stoi(value) : fallback; } catch (...) { return fallback; }
+}
+
+double envDouble(const char* name, double fallback) {
+    const char* value = std::getenv(name);
+    try { return value ? std::stod(value) : fallback; } catch (...) { return fallback; }
+}
+
+// "/trace?trace=1f2e...&chat=123" -> фильтр выгрузки; неизвестные параметры игнорируются
+TraceFilter traceFilter(const std::string& path) {
+    TraceFilter filter;
+    size_t query = path.find('?');
+    std::istringstream in(query == std::string::npos ? "" : path.substr(query + 1));
+    std::string param;
+    while (std::getline(in, param, '&')) {
+        size_t eq = param.find('=');
+        std::string key = param.substr(0, eq);
+        std::string value = eq == std::string::npos ? "" : param.substr(eq + 1);
+        try {
+            if (key == "trace")
+                filter.traceId = std::stoull(value, nullptr, 16);
+            else if (key == "chat")
+                filter.chatId = std::stoll(value);
+        } catch (...) {}
     }
-    sqlite3_finalize(stmt);
-    return all_success;
+    return filter;
 }
 
-void registerCommands(TgBot::Bot& bot, YandexDiskClient& yandex) {
-    commandRegistry["start"] = std::make_unique<StartCommand>();
-    commandRegistry["catalog"] = std::make_unique<CatalogCommand>(db, bot, yandex);
-    commandRegistry["find"] = std::make_unique<FindCommand>(db, bot, yandex);
-    commandRegistry["find_by_title"] = std::make_unique<FindByTitleCommand>(db, bot, yandex);
-    commandRegistry["find_by_author"] = std::make_unique<FindByAuthorCommand>(db, bot, yandex);
-    commandRegistry["find_by_topic"] = std::make_unique<FindByTopicCommand>(db, bot, yandex);
+void registerCommands(BookListPaginator& paginator, TelegramOutbox& outbox, DiskSync* diskSync,
+                      const std::set<int64_t>& admins, ActiveDialogs& dialogs) {
+    commandRegistry["start"] = std::make_unique<StartCommand>(outbox);
+    commandRegistry["catalog"] = std::make_unique<CatalogCommand>(paginator);
+    commandRegistry["find"] = std::make_unique<FindCommand>(paginator, outbox, dialogs);
+    commandRegistry["find_by_title"] = std::make_unique<FindByTitleCommand>(paginator, outbox, dialogs);
+    commandRegistry["find_by_author"] = std::make_unique<FindByAuthorCommand>(paginator, outbox, dialogs);
+    commandRegistry["find_by_topic"] = std::make_unique<FindByTopicCommand>(paginator, outbox, dialogs);
+    if (diskSync)
+        commandRegistry["sync"] = std::make_unique<SyncCommand>(*diskSync, outbox, admins);
+    commandRegistry["stats"] = std::make_unique<StatsCommand>(outbox, admins);
 }
 
-void bindCommandHandlers(TgBot::Bot& bot) {
+void bindCommandHandlers(TgBot::Bot& bot, UpdateDispatcher& dispatcher, ActiveDialogs& dialogs) {
     for (auto& [name, cmd] : commandRegistry) {
+        LatencyHistogram* timing = &Metrics::instance().histogram(Metrics::Family::Command, name);
         bot.getEvents().onCommand(
                 name,
-                [&bot, handler = cmd.get()](TgBot::Message::Ptr message) {
-                    handler->execute(bot, message);
+                [&bot, &dispatcher, &dialogs, handler = cmd.get(), timing](TgBot::Message::Ptr message) {
+                    auto trace = Tracer::instance().startTrace();
+                    auto received = Tracer::Clock::now();
+                    dispatcher.post(message->chat->id, [&bot, &dialogs, handler, timing, message, trace, received] {
+                        Tracer::Root root(trace, "update", timing->name(), message->chat->id, received);
+                        Metrics::Timer timer(*timing);
+                        // Новая команда закрывает незаконченный диалог, какой бы команде он ни принадлежал
+                        dialogs.cancel(message->from->id);
+                        handler->execute(bot, message);
+                    });
                 });
     }
 }
 
-int main() {
-    int rc = sqlite3_open("e_library_bot.db", &db);
-    if(rc) {
-        std::cerr << fmt::format("Can't open database: {}", sqlite3_errmsg(db));
+int main(int argc, char** argv) {
+    // TRACE_SAMPLE — доля трассируемых апдейтов: по умолчанию 1%, чтобы запись спанов не нагружала
+    // каждый апдейт; 1 — все, 0 — выключено. TRACE_BUFFER — спанов в кольцевом буфере
+    Tracer::instance().configure(envDouble("TRACE_SAMPLE", 0.01), static_cast<size_t>(envInt("TRACE_BUFFER", 65536)));
+
+    // WAL, пул соединений на чтение (DB_READERS) и отдельный поток записи
+    if(!db.open("e_library_bot.db", static_cast<size_t>(envInt("DB_READERS", 4)))) {
+        std::cerr << fmt::format("Can't open database: {}", db.errmsg());
         return 1;
     }
 
-    // Создание всех нужных таблиц, включая для рейтинга
-    const char* create_users_table_sql = "CREATE TABLE IF NOT EXISTS users(tg_id INTEGER PRIMARY KEY, username TEXT);";
-    const char* create_books_table_sql = "CREATE TABLE IF NOT EXISTS books(id INTEGER PRIMARY KEY AUTOINCREMENT,"
-                                         " title TEXT NOT NULL, author TEXT NOT NULL,"
-                                         " topic TEXT NOT NULL,"
-                                         " file_path TEXT UNIQUE,"
-                                         " request_count INTEGER DEFAULT 0);";
-    const char* create_author_requests_table_sql = "CREATE TABLE IF NOT EXISTS author_requests(author TEXT PRIMARY KEY,"
-                                                   " request_count INTEGER DEFAULT 0);";
-    const char* create_topic_requests_table_sql = "CREATE TABLE IF NOT EXISTS topic_requests(topic TEXT PRIMARY KEY,"
-                                                  " request_count INTEGER DEFAULT 0);";
-
-    std::vector<const char*> sql_scripts = {
-            create_users_table_sql, create_books_table_sql,
-            create_author_requests_table_sql, create_topic_requests_table_sql
-    };
+    CatalogSchema::create(db.handle());
 
-    for(const auto &script:sql_scripts) {
-        if(sqlite3_exec(db, script, nullptr, nullptr,nullptr) != SQLITE_OK) {
-            std::cerr << fmt::format("SQL error: {}", sqlite3_errmsg(db));
-        }
-    }
+    FullTextSearch::ensureIndex(db.handle());
 
     std::vector<BookInfo> books = {
             { "Гарри Поттер и философский камень", "Дж. К. Роулинг", "Фэнтези", "/files/harry_potter_1.pdf" },
@@ -111,6 +162,17 @@ int main() {
     };
     add_books(db, books);
 
+    // bot --import catalog.csv|catalog.jsonl — загрузить каталог перед запуском
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::string(argv[i]) != "--import")
+            continue;
+        CatalogImporter importer(db);
+        auto stats = importer.importFile(argv[i + 1]);
+        std::cout << fmt::format("Imported {} rows: {} inserted, {} skipped in {:.2f} s ({:.0f} rows/s)",
+                                 stats.rows, stats.inserted, stats.skipped, stats.seconds, stats.rowsPerSecond())
+                  << std::endl;
+    }
+
     const char* bot_token_cstr = std::getenv("BOT_TOKEN");
     const char* disk_token_cstr = std::getenv("YADISK_TOKEN");
     if (!bot_token_cstr || !disk_token_cstr) {
@@ -118,49 +180,292 @@ int main() {
         return 1;
     }
 
-    TgBot::Bot bot(bot_token_cstr);
-    YandexDiskClient yandex(disk_token_cstr);
+    // Одни соединения (HTTP/2, где есть) на все запросы к Telegram и Disk API
+    HttpTransport transport(envInt("HTTP_MAX_CONNECTIONS", 16));
+    TelegramHttpClient telegramClient(transport);
+    TgBot::Bot bot(bot_token_cstr, telegramClient);
+
+    // Исходящие запросы к Telegram: TG_GLOBAL_RATE в секунду на бота, TG_CHAT_BURST подряд в один чат
+    OutboxLimits outboxLimits;
+    outboxLimits.globalRate = outboxLimits.globalBurst = envInt("TG_GLOBAL_RATE", 30);
+    outboxLimits.chatBurst = envInt("TG_CHAT_BURST", 3);
+    TelegramOutbox outbox(bot, transport, outboxLimits);
+    // Запросы, соединения и ошибки по хостам: Bot API, Disk API, загрузки с Диска
+    Metrics::instance().addCollector("HTTP", [&transport] {
+        std::vector<Metrics::Value> values;
+        for (const auto& [host, stats] : transport.stats()) {
+            std::string labels = Metrics::label("host", host);
+            values.push_back({"http_requests_total", "counter", "Outgoing HTTP requests.", host + " запросы",
+                              double(stats.requests), 1, labels});
+            values.push_back({"http_connections_total", "counter", "New outgoing HTTP connections.", "соединения",
+                              double(stats.connections), 1, labels});
+            values.push_back({"http2_requests_total", "counter", "Outgoing requests sent over HTTP/2.", "HTTP/2",
+                              double(stats.http2), 1, labels});
+            values.push_back({"http_failures_total", "counter", "Failed outgoing HTTP requests.", "ошибки",
+                              double(stats.failures), 1, labels});
+            values.push_back({"http_request_seconds_total", "counter", "Total time of outgoing HTTP requests.", "мс",
+                              stats.seconds, 1000, labels});
+        }
+        return values;
+    });
+
+    UpdateDispatcher dispatcher;
+    std::cout << "Update workers: " << dispatcher.threadCount() << std::endl;
+
+    // Кэш скачанных книг: BOOK_CACHE_DIR, бюджет BOOK_CACHE_MB мегабайт
+    const char* cache_dir = std::getenv("BOOK_CACHE_DIR");
+    DownloadCache downloads(db, cache_dir ? std::filesystem::path(cache_dir)
+                                          : std::filesystem::temp_directory_path() / "e_library_cache",
+                            static_cast<uint64_t>(envInt("BOOK_CACHE_MB", 2048)) * 1024 * 1024);
+    downloads.load();
+    // Попадания, промахи и вытеснения — чтобы подобрать BOOK_CACHE_MB
+    Metrics::instance().addCollector("Кэш загрузок", [&downloads] {
+        auto stats = downloads.stats();
+        return std::vector<Metrics::Value>{
+                {"download_cache_hits_total", "counter", "Download cache hits.", "попадания", double(stats.hits)},
+                {"download_cache_misses_total", "counter", "Download cache misses.", "промахи", double(stats.misses)},
+                {"download_cache_evictions_total", "counter", "Files evicted from the download cache.", "вытеснения",
+                 double(stats.evictions)},
+                {"download_cache_files", "gauge", "Files in the download cache.", "файлы", double(stats.files)},
+                {"download_cache_bytes", "gauge", "Bytes in the download cache.", "МБ", double(stats.bytes),
+                 1.0 / (1024 * 1024)},
+                {"download_cache_pinned_files", "gauge", "Cached files being uploaded right now.", "в работе",
+                 double(stats.pinned)},
+        };
+    });
+
+    // Размер, md5 и MIME книг из Disk API; сверка не чаще раза в BOOK_META_TTL_HOURS часов
+    DiskApi diskApi(transport, disk_token_cstr);
+    BookMetadata metadata(db, diskApi, std::chrono::hours(envInt("BOOK_META_TTL_HOURS", 24)));
+    // Ссылки на книги больше 50 МБ публикуются один раз; BOOK_PREPUBLISH_TOP самых популярных — заранее
+    PublicLinks links(db, diskApi, BookDelivery::maxUploadBytes,
+                      std::chrono::hours(envInt("BOOK_LINK_MAX_AGE_HOURS", 0)));
+    links.start(std::chrono::minutes(envInt("BOOK_PREPUBLISH_INTERVAL", 30)), envInt("BOOK_PREPUBLISH_TOP", 20));
 
-    registerCommands(bot, yandex);
-    bindCommandHandlers(bot);
+    metadata.onChanged([&downloads, &links](int bookId, const std::string& path) {
+        downloads.invalidate(path);
+        links.invalidate(bookId);
+    });
+
+    // Скачивание и отправка книг идут конвейером вне потоков диспетчера
+    BookDelivery delivery(db, outbox, diskApi, downloads, metadata, links);
+
+    // Диалоги и позиции страниц истекают через SESSION_TTL_MINUTES, не больше SESSION_MAX на хранилище
+    SessionOptions sessions;
+    sessions.ttl = std::chrono::minutes(envInt("SESSION_TTL_MINUTES", 30));
+    sessions.maxEntries = static_cast<size_t>(envInt("SESSION_MAX", 100000));
+    bool snapshotSessions = envInt("SESSION_SNAPSHOT", 1) != 0;
+
+    // Один пагинатор на все команды: общие индексы и позиции страниц
+    BookListPaginator paginator(db, outbox, delivery, sessions);
+    paginator.loadSuggestions();
+    paginator.loadLeaderboards();
 
-    BookListPaginator paginator(db, bot, yandex);
+    // Синхронизация каталога с папкой на Яндекс Диске, если она задана
+    std::set<int64_t> admins = parseIds(std::getenv("ADMIN_IDS"));
+    std::unique_ptr<DiskSync> diskSync;
+    if (const char* sync_root = std::getenv("YADISK_SYNC_ROOT")) {
+        diskSync = std::make_unique<DiskSync>(db, diskApi, sync_root, envInt("YADISK_SYNC_THREADS", 4));
+        diskSync->onBookAdded([&paginator](const std::string& title, const std::string& author, const std::string& topic) {
+            paginator.indexBook(title, author, topic);
+        });
+        // Файл на диске заменён: скачанная копия и публичная ссылка указывают на старую версию
+        diskSync->onContentChanged([&downloads, &links](int bookId, const std::string& path) {
+            downloads.invalidate(path);
+            links.invalidate(bookId);
+        });
+        diskSync->start(std::chrono::minutes(envInt("YADISK_SYNC_INTERVAL", 60)));
+    }
+
+    ActiveDialogs dialogs(sessions);
+    registerCommands(paginator, outbox, diskSync.get(), admins, dialogs);
+    if (snapshotSessions) {
+        size_t restored = paginator.restoreSessions();
+        for (auto& [name, cmd] : commandRegistry)
+            restored += cmd->restoreSessions(db);
+        std::cout << "Restored sessions: " << restored << std::endl;
+    }
+    bindCommandHandlers(bot, dispatcher, dialogs);
 
-    bot.getEvents().onAnyMessage([&bot](TgBot::Message::Ptr message) {
+    // Гистограммы сообщений по команде-владельцу диалога; после запуска только читаются
+    std::map<const ICommand*, LatencyHistogram*> messageTimings;
+    for (auto& [name, cmd] : commandRegistry)
+        messageTimings[cmd.get()] = &Metrics::instance().histogram(Metrics::Family::Message, name);
+    LatencyHistogram& unownedTiming = Metrics::instance().histogram(Metrics::Family::Message, "none");
+
+    bot.getEvents().onAnyMessage([&bot, &dispatcher, &dialogs, &outbox, &messageTimings, &unownedTiming](TgBot::Message::Ptr message) {
         if (!message->text.empty() && message->text[0] == '/')
             return;
 
-        bool handled = false;
-        for (auto& [name, cmd] : commandRegistry) {
-            if (cmd->handleMessage(bot, message)) {
-                handled = true;
-                break;
+        auto trace = Tracer::instance().startTrace();
+        auto received = Tracer::Clock::now();
+        dispatcher.post(message->chat->id, [&bot, &dialogs, &outbox, &messageTimings, &unownedTiming, message, trace, received] {
+            Tracer::Root root(trace, "update", "message", message->chat->id, received);
+            // Сообщение получает только команда, чей диалог открыт у пользователя
+            ICommand* owner = dialogs.owner(message->from->id);
+            auto timing = owner ? messageTimings.find(owner) : messageTimings.end();
+            Metrics::Timer timer(timing != messageTimings.end() ? *timing->second : unownedTiming);
+            if (!owner || !owner->handleMessage(bot, message)) {
+                outbox.sendMessage(
+                        message->chat->id,
+                        u8"Кажется, я так ещё не умею. Воспользуйтесь *меню* 😉",
+                        "Markdown"
+                );
             }
-        }
-
-        if (!handled) {
-            bot.getApi().sendMessage(
-                    message->chat->id,
-                    u8"Кажется, я так ещё не умею. Воспользуйтесь *меню* 😉",
-                    false, 0, nullptr, "Markdown"
-            );
-        }
+        });
     });
 
     bot.getEvents().onCallbackQuery([&](TgBot::CallbackQuery::Ptr query) {
-        paginator.handleCallback(query);
+        int64_t chatId = query->message ? query->message->chat->id : query->from->id;
+        auto trace = Tracer::instance().startTrace();
+        auto received = Tracer::Clock::now();
+        dispatcher.post(chatId, [&paginator, query, chatId, trace, received] {
+            Tracer::Root root(trace, "update", "callback", chatId, received);
+            paginator.handleCallback(query);
+        });
+    });
+
+    // METRICS_PORT — гистограммы в формате Prometheus на /metrics и трассы Chrome trace_event
+    // на /trace (?trace=<id>, ?chat=<id>); METRICS_HOST по умолчанию только локальный
+    HttpServer metricsServer([](const HttpRequest& request) {
+        std::string path = request.path.substr(0, request.path.find('?'));
+        if (path == "/metrics")
+            return HttpResponse{200, Metrics::instance().prometheus(), "text/plain; version=0.0.4"};
+        if (path == "/trace")
+            return HttpResponse{200, Tracer::instance().chromeJson(traceFilter(request.path)), "application/json"};
+        return HttpResponse{404, ""};
+    }, 8);
+    if (int metricsPort = envInt("METRICS_PORT", 0); metricsPort > 0) {
+        const char* metrics_host = std::getenv("METRICS_HOST");
+        if (metricsServer.listen(metrics_host ? metrics_host : "127.0.0.1", static_cast<uint16_t>(metricsPort))) {
+            metricsServer.start();
+            std::cout << "Metrics on port " << metricsServer.port() << std::endl;
+        }
+    }
+
+    // По сигналу приём апдейтов останавливается и main проходит штатную остановку ниже:
+    // снимок сессий, остаток счётчиков, TRACE_FILE. Вебхук останавливается сразу,
+    // long poll — после текущего getUpdates (до 10 с)
+    std::signal(SIGINT, onShutdownSignal);
+    std::signal(SIGTERM, onShutdownSignal);
+    std::atomic<bool> stopRequested{false};
+    std::mutex webhookMutex;
+    WebhookServer* activeWebhook = nullptr;
+    std::thread shutdownWatcher([&] {
+        while (!shutdownSignal && !stopRequested)
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        std::lock_guard<std::mutex> lock(webhookMutex);
+        if (shutdownSignal)
+            std::cout << "Shutting down..." << std::endl;
+        stopRequested = true;
+        if (activeWebhook)
+            activeWebhook->stop();
     });
 
     try {
         std::cout << "Bot name: " << bot.getApi().getMe()->username << std::endl;
-        TgBot::TgLongPoll longPoll(bot);
-        while (true) {
-            longPoll.start();
+
+        // WEBHOOK_PORT — апдейты принимает встроенный сервер; WEBHOOK_URL (https, за прокси)
+        // регистрируется в Telegram с секретом WEBHOOK_SECRET. Не вышло — остаётся long poll.
+        // Без секрета апдейт мог бы подсунуть любой, кто достучится до порта, — тогда он случайный.
+        // Без WEBHOOK_URL вебхук нужен только для локального воспроизведения и слушает 127.0.0.1
+        if (int webhookPort = envInt("WEBHOOK_PORT", 0); webhookPort > 0) {
+            const char* webhook_url = std::getenv("WEBHOOK_URL");
+            const char* webhook_secret = std::getenv("WEBHOOK_SECRET");
+            std::string url = webhook_url ? webhook_url : "";
+            std::string secret = webhook_secret ? webhook_secret : "";
+            if (secret.empty()) {
+                secret = WebhookServer::randomSecret();
+                if (url.empty())
+                    std::cout << "WEBHOOK_SECRET is not set, using " << secret << std::endl;
+                else
+                    std::cout << "WEBHOOK_SECRET is not set, registering the webhook with a random secret" << std::endl;
+            }
+            int maxConnections = envInt("WEBHOOK_CONNECTIONS", 40);
+
+            WebhookServer webhook(bot, url.empty() ? "/" : WebhookServer::pathOf(url), secret, maxConnections);
+            if (webhook.listen(url.empty() ? "127.0.0.1" : "0.0.0.0", static_cast<uint16_t>(webhookPort))) {
+                bool registered = url.empty();
+                try {
+                    if (!url.empty())
+                        registered = bot.getApi().setWebhook(url, nullptr, maxConnections, {}, "", false, secret);
+                } catch (TgBot::TgException& e) {
+                    std::cerr << "setWebhook failed: " << e.what() << std::endl;
+                }
+                if (registered) {
+                    {
+                        std::lock_guard<std::mutex> lock(webhookMutex);
+                        if (!stopRequested)
+                            activeWebhook = &webhook;
+                    }
+                    if (activeWebhook) {
+                        std::cout << "Webhook listening on port " << webhook.port() << std::endl;
+                        webhook.run();
+                    }
+                    // Ждём, пока поток остановки закончит webhook.stop()
+                    std::lock_guard<std::mutex> lock(webhookMutex);
+                    activeWebhook = nullptr;
+                }
+            }
+            if (!stopRequested)
+                std::cerr << "Webhook unavailable, falling back to long polling" << std::endl;
+        }
+
+        if (!stopRequested) {
+            // getUpdates не работает, пока у бота зарегистрирован вебхук
+            bot.getApi().deleteWebhook();
+            TgBot::TgLongPoll longPoll(bot);
+            while (!stopRequested) {
+                longPoll.start();
+            }
         }
     } catch (TgBot::TgException& e) {
         std::cerr << "error: " << e.what() << std::endl;
     }
+    stopRequested = true;
+    shutdownWatcher.join();
 
-    sqlite3_close(db);
+    dispatcher.stop();
+    if (diskSync)
+        diskSync->stop();
+    delivery.stop();
+    metadata.stop();
+    links.stop();
+    paginator.shutdown();
+    // Обработчики остановлены — отправляем накопленные удаления
+    outbox.stop();
+    // Диспетчер остановлен — сессии больше никто не меняет
+    if (snapshotSessions) {
+        paginator.saveSessions();
+        for (auto& [name, cmd] : commandRegistry)
+            cmd->saveSessions(db);
+    }
+    commandRegistry.clear();
+    auto [statementHits, statementMisses] = db.statementStats();
+    std::cout << fmt::format("Statement cache: {} hits, {} misses; writer: {} jobs in {} transactions",
+                             statementHits, statementMisses, db.writeJobs(), db.writeBatches()) << std::endl;
+    auto cacheStats = downloads.stats();
+    std::cout << fmt::format("Download cache: {} hits, {} misses, {} evictions, {} files / {} MB",
+                             cacheStats.hits, cacheStats.misses, cacheStats.evictions,
+                             cacheStats.files, cacheStats.bytes / (1024 * 1024)) << std::endl;
+    auto linkStats = links.stats();
+    std::cout << fmt::format("Public links: {} reused, {} published on demand, {} prepublished",
+                             linkStats.hits, linkStats.published, linkStats.prepublished) << std::endl;
+    auto outboxStats = outbox.stats();
+    std::cout << fmt::format("Telegram: {} calls, {} flood retries, {} messages deleted in {} requests",
+                             outboxStats.calls, outboxStats.retries,
+                             outboxStats.deletedMessages, outboxStats.deleteRequests) << std::endl;
+    for (const auto& [host, hostStats] : transport.stats()) {
+        std::cout << fmt::format("HTTP {}: {} requests over {} connections, {} via HTTP/2, {} failed, {:.1f} ms average",
+                                 host, hostStats.requests, hostStats.connections, hostStats.http2, hostStats.failures,
+                                 hostStats.requests ? hostStats.seconds * 1000 / hostStats.requests : 0.0) << std::endl;
+    }
+    // TRACE_FILE — последние спаны на диск для chrome://tracing или ui.perfetto.dev
+    if (const char* trace_file = std::getenv("TRACE_FILE")) {
+        std::ofstream out(trace_file, std::ios::binary);
+        out << Tracer::instance().chromeJson();
+        std::cout << "Trace written to " << trace_file << std::endl;
+    }
+    db.close();
     return 0;
 }
@@ -0,0 +1,117 @@
+#!/usr/bin/env python3
+"""Local fake of the Yandex Disk REST API (resources, download and publish).
+
+Serves a local directory as the disk root: folders and files map to resources,
+`modified` comes from mtime and `md5` from file contents. Prints the number of
+requests served so sync runs can be compared.
+
+    python3 tools/fake_disk_api.py ./disk 8081
+    YADISK_API_URL=http://127.0.0.1:8081/v1/disk YADISK_SYNC_ROOT=/Books tg_bot_electronic_library
+"""
+
+import hashlib
+import json
+import mimetypes
+import os
+import sys
+import threading
+from datetime import datetime, timezone
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from urllib.parse import parse_qs, urlencode, urlparse
+
+ROOT = os.path.abspath(sys.argv[1] if len(sys.argv) > 1 else ".")
+PORT = int(sys.argv[2]) if len(sys.argv) > 2 else 8081
+requests = 0
+published = set()
+lock = threading.Lock()
+
+
+def resource(disk_path):
+    local = os.path.join(ROOT, disk_path.lstrip("/"))
+    stat = os.stat(local)
+    item = {
+        "name": os.path.basename(disk_path.rstrip("/")) or "disk",
+        "path": "disk:" + disk_path,
+        "type": "dir" if os.path.isdir(local) else "file",
+        "modified": datetime.fromtimestamp(stat.st_mtime, timezone.utc).isoformat(timespec="microseconds"),
+    }
+    if item["type"] == "file":
+        with open(local, "rb") as f:
+            item["md5"] = hashlib.md5(f.read()).hexdigest()
+        item["size"] = stat.st_size
+        item["mime_type"] = mimetypes.guess_type(local)[0] or "application/octet-stream"
+    if disk_path in published:
+        item["public_url"] = "https://yadi.sk/d/" + hashlib.md5(disk_path.encode()).hexdigest()[:14]
+    return item
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+
+    def do_GET(self):
+        global requests
+        with lock:
+            requests += 1
+            served = requests
+        url = urlparse(self.path)
+        query = parse_qs(url.query)
+        endpoint = url.path.rstrip("/")
+        if endpoint not in ("/v1/disk/resources", "/v1/disk/resources/download", "/download") or "path" not in query:
+            return self.reply(404, {"error": "NotFound"})
+
+        path = query["path"][0].replace("disk:", "", 1) or "/"
+        local = os.path.join(ROOT, path.lstrip("/"))
+        if not os.path.exists(local):
+            return self.reply(404, {"error": "DiskNotFoundError"})
+        if endpoint == "/v1/disk/resources/download":
+            href = f"http://127.0.0.1:{PORT}/download?{urlencode({'path': path})}"
+            return self.reply(200, {"href": href, "method": "GET", "templated": False})
+        if endpoint == "/download":
+            with open(local, "rb") as f:
+                data = f.read()
+            self.send_response(200)
+            self.send_header("Content-Type", "application/octet-stream")
+            self.send_header("Content-Length", str(len(data)))
+            self.end_headers()
+            return self.wfile.write(data)
+
+        body = resource(path)
+        if os.path.isdir(local):
+            limit = int(query.get("limit", ["20"])[0])
+            offset = int(query.get("offset", ["0"])[0])
+            names = sorted(os.listdir(local))
+            body["_embedded"] = {
+                "path": body["path"], "limit": limit, "offset": offset, "total": len(names),
+                "items": [resource(path.rstrip("/") + "/" + name) for name in names[offset:offset + limit]],
+            }
+        if served % 100 == 0:
+            print(f"{served} requests served", flush=True)
+        self.reply(200, body)
+
+    def do_PUT(self):
+        url = urlparse(self.path)
+        query = parse_qs(url.query)
+        if url.path.rstrip("/") != "/v1/disk/resources/publish" or "path" not in query:
+            return self.reply(404, {"error": "NotFound"})
+        path = query["path"][0].replace("disk:", "", 1)
+        if not os.path.isfile(os.path.join(ROOT, path.lstrip("/"))):
+            return self.reply(404, {"error": "DiskNotFoundError"})
+        with lock:
+            published.add(path)
+        self.reply(200, {"href": f"http://127.0.0.1:{PORT}/v1/disk/resources?path={path}", "method": "GET"})
+
+    def reply(self, status, body):
+        data = json.dumps(body, ensure_ascii=False).encode()
+        self.send_response(status)
+        self.send_header("Content-Type", "application/json; charset=utf-8")
+        self.send_header("Content-Length", str(len(data)))
+        self.end_headers()
+        self.wfile.write(data)
+
+    def log_message(self, *args):
+        pass
+
+
+if __name__ == "__main__":
+    print(f"Fake Disk API for {ROOT} on http://127.0.0.1:{PORT}/v1/disk", flush=True)
+    ThreadingHTTPServer(("127.0.0.1", PORT), Handler).serve_forever()
@@ -0,0 +1,36 @@
+// Импорт каталога книг из CSV или JSONL в базу бота.
+// Запуск: import_catalog <catalog.csv|catalog.jsonl> [db=e_library_bot.db] [batch=50000]
+
+#include <sqlite3.h>
+#include <fmt/format.h>
+#include <iostream>
+#include <string>
+#include "../include/CatalogImporter.h"
+#include "../include/CatalogSchema.h"
+#include "../include/Database.h"
+#include "../include/FullTextSearch.h"
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: import_catalog <catalog.csv|catalog.jsonl> [db=e_library_bot.db] [batch=50000]" << std::endl;
+        return 1;
+    }
+    std::string path = argv[1];
+    std::string dbPath = argc > 2 ? argv[2] : "e_library_bot.db";
+    size_t batch = argc > 3 ? std::stoul(argv[3]) : 50000;
+
+    Database db;
+    if (!db.open(dbPath, 0)) {
+        std::cerr << fmt::format("Can't open database: {}", db.errmsg()) << std::endl;
+        return 1;
+    }
+    CatalogSchema::create(db.handle());
+    FullTextSearch::ensureIndex(db.handle());
+
+    CatalogImporter importer(db, batch);
+    auto stats = importer.importFile(path);
+    std::cout << fmt::format("Read {} rows: {} inserted, {} already in catalog, {} skipped in {:.2f} s ({:.0f} rows/s)",
+                             stats.rows, stats.inserted, stats.duplicates, stats.skipped,
+                             stats.seconds, stats.rowsPerSecond()) << std::endl;
+    return stats.rows > 0 && stats.skipped == stats.rows ? 1 : 0;
+}